@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/analyses/deptree.h"
+
+using namespace thorin;
+
+/// The recursive construction DepTree used before it became iterative.
+/// Other than back then, a @em nom that references itself doesn't recurse forever but depends on nothing via this reference.
+class Reference {
+public:
+    Reference(const World& world) {
+        for (const auto& [_, nom] : world.externals()) run(nom);
+    }
+
+    /// Maps each @em nom to its parent; @c nullptr denotes the root.
+    const NomMap<Def*>& parents() const { return parent_; }
+
+private:
+    VarSet run(Def* nom) {
+        if (auto [_, ins] = depth_.emplace(nom, stack_.size() + 1); !ins) {
+            if (auto vars = def2vars_.lookup(nom)) return *vars;
+            return {}; // in progress
+        }
+
+        stack_.emplace_back(nom);
+        VarSet result;
+        if (!nom->no_dep()) {
+            for (auto op : nom->extended_ops()) merge(result, run(nom, op));
+            if (auto var = nom->has_var()) result.erase(var);
+        }
+        def2vars_[nom] = result;
+
+        Def* parent = nullptr;
+        size_t depth = 0;
+        for (auto var : result) {
+            if (auto d = depth_[var->nom()]; d > depth) {
+                parent = var->nom();
+                depth = d;
+            }
+        }
+        parent_[nom] = parent;
+        depth_[nom] = depth + 1;
+        stack_.pop_back();
+        return result;
+    }
+
+    VarSet run(Def* curr_nom, const Def* def) {
+        if (def->no_dep())                     return {};
+        if (auto vars = def2vars_.lookup(def)) return *vars;
+        if (auto nom  = def->isa_nom())        return run(nom);
+        if (auto var  = def->isa<Var>())       return def2vars_[def] = {var};
+
+        VarSet result;
+        for (auto op : def->extended_ops()) merge(result, run(curr_nom, op));
+        return def2vars_[def] = result;
+    }
+
+    static void merge(VarSet& vars, VarSet&& other) { vars.insert(other.begin(), other.end()); }
+
+    NomMap<size_t> depth_;
+    NomMap<Def*> parent_;
+    DefMap<VarSet> def2vars_;
+    std::vector<Def*> stack_;
+};
+
+static void expect_equal(const World& world) {
+    DepTree tree(world);
+    Reference ref(world);
+
+    for (const auto& [nom, parent] : ref.parents()) {
+        auto node = tree.nom2node(nom);
+        ASSERT_NE(node, nullptr) << nom;
+        EXPECT_EQ(node->parent()->nom(), parent) << nom;
+        EXPECT_EQ(node->depth(), node->parent()->depth() + 1) << nom;
+        if (parent != nullptr) {
+            EXPECT_TRUE(tree.depends(nom, parent)) << nom;
+        }
+    }
+}
+
+TEST(DepTree, Nested) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+
+    // f(x) { g() { h(y) { k() { ret(x + y) } } } }
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto g = w.nom_lam(w.cn({mem}), w.dbg("g"));
+    auto h = w.nom_lam(w.cn({mem, i32}), w.dbg("h"));
+    auto k = w.nom_lam(w.cn({mem}), w.dbg("k"));
+    f->app(g, f->var(0_s));
+    g->app(h, {g->var(), w.lit_int_width(32, 23)});
+    h->app(k, h->var(0_s));
+    k->app(f->ret_var(), {k->var(), w.op(Wrap::add, WMode::none, f->var(1), h->var(1))});
+    f->make_external();
+
+    expect_equal(w);
+    DepTree tree(w);
+    EXPECT_EQ(tree.nom2node(f)->parent(), tree.root());
+    EXPECT_EQ(tree.nom2node(g)->parent()->nom(), f);
+    EXPECT_EQ(tree.nom2node(h)->parent()->nom(), f);
+    EXPECT_EQ(tree.nom2node(k)->parent()->nom(), h);
+    EXPECT_TRUE (tree.depends(k, f));
+    EXPECT_FALSE(tree.depends(f, k));
+}
+
+TEST(DepTree, Recursive) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+
+    // self-recursive: f(x) { f(x + 1) } - this used to recurse forever
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    f->app(f, {f->var(0_s), w.op(Wrap::add, WMode::none, f->var(1), w.lit_int_width(32, 1)), f->ret_var()});
+    f->make_external();
+
+    // mutually recursive blocks nested in e: e(x) { a() { b() }; b() { a() or ret(x) } }
+    auto e = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("e"));
+    auto a = w.nom_lam(w.cn({mem}), w.dbg("a"));
+    auto b = w.nom_lam(w.cn({mem}), w.dbg("b"));
+    auto r = w.nom_lam(w.cn({mem}), w.dbg("r"));
+    e->app(a, e->var(0_s));
+    a->app(b, a->var());
+    b->branch(w.op(ICmp::e, e->var(1), w.lit_int_width(32, 0)), r, a, b->var());
+    r->app(e->ret_var(), {r->var(), e->var(1)});
+    e->make_external();
+
+    // mutually recursive top-level functions
+    auto p = w.nom_lam(w.cn({mem, w.cn({mem})}), w.dbg("p"));
+    auto q = w.nom_lam(w.cn({mem, w.cn({mem})}), w.dbg("q"));
+    p->app(q, {p->var(0_s), p->ret_var()});
+    q->app(p, {q->var(0_s), q->ret_var()});
+    p->make_external();
+
+    expect_equal(w);
+    DepTree tree(w);
+    EXPECT_EQ(tree.nom2node(f)->parent(), tree.root());
+    EXPECT_EQ(tree.nom2node(a)->parent()->nom(), e);
+    EXPECT_EQ(tree.nom2node(b)->parent()->nom(), e);
+    EXPECT_EQ(tree.nom2node(p)->parent(), tree.root());
+    EXPECT_EQ(tree.nom2node(q)->parent(), tree.root());
+}
+
+TEST(DepTree, Deep) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+
+    // a long chain of blocks - each one uses the Var of its predecessor and, hence, is nested in it
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    Lam* prev = f;
+    const Def* x = f->var(1);
+    for (size_t i = 0; i != 10000; ++i) {
+        auto next = w.nom_lam(w.cn({mem, i32}), w.dbg("l"));
+        prev->app(next, {prev->var(0_s), w.op(Wrap::add, WMode::none, x, w.lit_int_width(32, 1))});
+        x = prev == f ? f->var(1) : prev->var(1);
+        prev = next;
+    }
+    prev->app(f->ret_var(), {prev->var(0_s), w.op(Wrap::add, WMode::none, prev->var(1), x)});
+    f->make_external();
+
+    DepTree tree(w);
+    EXPECT_EQ(tree.nom2node(prev)->depth(), 10001);
+}
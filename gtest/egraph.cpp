@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include "thorin/egraph.h"
+#include "thorin/world.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/rw/eq_sat.h"
+
+using namespace thorin;
+
+TEST(EGraph, Factor) {
+    World w;
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({i32, i32, i32}), w.dbg("f"));
+    auto a = f->var(0_s), b = f->var(1), c = f->var(2);
+
+    EGraph egraph(w);
+    auto id = egraph.import(w.op(Wrap::add, WMode::none, w.op(Wrap::mul, WMode::none, a, b), w.op(Wrap::mul, WMode::none, a, c)));
+    egraph.compute_costs();
+    EXPECT_EQ(egraph.cost(id), 9);
+
+    egraph.saturate();
+    egraph.compute_costs();
+    EXPECT_EQ(egraph.cost(id), 5);
+    EXPECT_EQ(egraph.extract(id), w.op(Wrap::mul, WMode::none, a, w.op(Wrap::add, WMode::none, b, c)));
+}
+
+TEST(EGraph, Bit) {
+    World w;
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({i32, i32, i32}), w.dbg("f"));
+    auto x = f->var(0_s), y = f->var(1), z = f->var(2);
+
+    EGraph egraph(w);
+    auto id = egraph.import(w.op(Bit::_or, w.op(Bit::_and, x, y), w.op(Bit::_and, x, z)));
+    egraph.saturate();
+    egraph.compute_costs();
+    EXPECT_EQ(egraph.cost(id), 2);
+    EXPECT_EQ(egraph.extract(id), w.op(Bit::_and, x, w.op(Bit::_or, y, z)));
+}
+
+TEST(EGraph, Fold) {
+    World w;
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({i32}), w.dbg("f"));
+    auto x = f->var();
+
+    // x*3 + x*5 -> x*8 -> x << 3
+    EGraph egraph(w);
+    auto id = egraph.import(w.op(Wrap::add, WMode::none, w.op(Wrap::mul, WMode::none, x, w.lit_int(i32, 3)),
+                                                          w.op(Wrap::mul, WMode::none, x, w.lit_int(i32, 5))));
+    egraph.saturate();
+    egraph.compute_costs();
+    EXPECT_EQ(egraph.cost(id), 1);
+    EXPECT_EQ(egraph.extract(id), w.op(Wrap::shl, WMode::none, x, w.lit_int(i32, 3)));
+}
+
+/// Spells out the arithmetic over the Var%s @c a, @c b, @c c of @p f - cleanup rebuilds the World, so we can't compare Def%s with new ones.
+static std::string show(Lam* f, const Def* def) {
+    for (size_t i = 1; i != 4; ++i) {
+        if (def == f->var(i)) return std::string(1, char('a' + i - 1));
+    }
+    if (auto lit = isa_lit(def)) return std::to_string(*lit);
+    if (auto wrap = isa<Tag::Wrap>(def)) {
+        auto op = wrap.flags() == Wrap::add ? " + " : wrap.flags() == Wrap::mul ? " * " : wrap.flags() == Wrap::shl ? " << " : " ? ";
+        return "(" + show(f, wrap->arg(0)) + op + show(f, wrap->arg(1)) + ")";
+    }
+    return "?";
+}
+
+/// f(mem, a, b, c, ret) { x = a*b + a*c; ret(mem, x, x*3 + x*5, a + b) }
+TEST(EqSat, Roots) {
+    World w;
+    w.set(LogLevel::Error);
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, i32, i32, w.cn({mem, i32, i32, i32})}), w.dbg("f"));
+    auto mul = [&](const Def* x, const Def* y) { return w.op(Wrap::mul, WMode::none, x, y); };
+    auto add = [&](const Def* x, const Def* y) { return w.op(Wrap::add, WMode::none, x, y); };
+    auto a = f->var(1), b = f->var(2), c = f->var(3);
+
+    // a*b and a*c are no roots as only arithmetic uses them; x is a root although y - another root - uses it as well
+    auto x = add(mul(a, b), mul(a, c));
+    auto y = add(mul(x, w.lit_int(i32, 3)), mul(x, w.lit_int(i32, 5)));
+    f->app(f->ret_var(), {f->var(0_s), x, y, add(a, b)});
+    f->make_external();
+
+    PassMan man(w);
+    man.add<EqSat>();
+    man.run();
+
+    f = w.lookup("f")->as_nom<Lam>();
+    auto args = f->body()->as<App>()->args();
+    auto new_x = show(f, args[1]);
+    EXPECT_TRUE(new_x == "(a * (b + c))" || new_x == "((b + c) * a)") << new_x;
+    // the PassMan rewrites x within y before y itself: EqSat must still replace the rebuilt y by its cheaper form
+    EXPECT_EQ(show(f, args[2]), "(" + new_x + " << 3)");
+    // nothing to gain
+    EXPECT_EQ(show(f, args[3]), "(a + b)");
+}
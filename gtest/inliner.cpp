@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/fp/inliner.h"
+
+using namespace thorin;
+
+/// Counts the calls of the @p Lam named @p name reachable from the externals of @p world.
+static size_t num_calls(const World& world, const std::string& name) {
+    size_t result = 0;
+    DefSet done;
+    std::vector<const Def*> stack;
+    for (const auto& [_, nom] : world.externals()) stack.emplace_back(nom);
+
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+        if (!done.emplace(def).second) continue;
+        if (auto app = def->isa<App>()) {
+            if (auto lam = app->callee()->isa_nom<Lam>(); lam && lam->name() == name) ++result;
+        }
+        for (auto op : def->extended_ops()) {
+            if (op != nullptr) stack.emplace_back(op);
+        }
+    }
+
+    return result;
+}
+
+/// g(mem, y, ret) { ret(mem, ((y + 1) * 3) ^ 5) }
+static Lam* helper(World& w, Lam::CC cc) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto g = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), cc, w.dbg("g"));
+    auto y = w.op(Wrap::mul, WMode::none, w.op(Wrap::add, WMode::none, g->var(1), w.lit_int_width(32, 1)), w.lit_int_width(32, 3));
+    g->app(g->ret_var(), {g->var(0_s), w.op(Bit::_xor, y, w.lit_int_width(32, 5))});
+    return g;
+}
+
+/// f(mem, x, ret) { g(mem, a, k) }; k(mem, r) { g(mem, r, ret) } - with @c a = 7 if @p lit and @c x otherwise.
+static void calls(World& w, bool lit, Lam::CC cc) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto ret = w.cn({mem, i32});
+    auto g = helper(w, cc);
+    auto f = w.nom_lam(w.cn({mem, i32, ret}), w.dbg("f"));
+    auto k = w.nom_lam(ret, w.dbg("k"));
+
+    f->app(g, {f->var(0_s), lit ? w.lit_int_width(32, 7) : f->var(1), k});
+    k->app(g, {k->var(0_s), k->var(1), f->ret_var()});
+    f->make_external();
+}
+
+/// f(mem, n, ret) { for (i = 0; i < n; i = g(i)); ret(mem, i) }
+static void loop(World& w) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto g    = helper(w, Lam::CC::C);
+    auto f    = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto head = w.nom_lam(w.cn({mem, i32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(mem), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(mem), w.dbg("exit"));
+    auto k    = w.nom_lam(w.cn({mem, i32}), w.dbg("k"));
+
+    f->app(head, {f->var(0_s), w.lit_int_width(32, 0)});
+    head->branch(w.op(ICmp::ul, head->var(1), f->var(1)), body, exit, head->var(0_s));
+    body->app(g, {body->var(), head->var(1), k});
+    k->app(head, {k->var(0_s), k->var(1)});
+    exit->app(f->ret_var(), {exit->var(), head->var(1)});
+    f->make_external();
+}
+
+/// f(mem, n, ret) { l(mem, n, k) }; k(mem, r) { l(mem, r, ret) } - with @c l containing the loop of @c loop.
+static void loops(World& w) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto ret  = w.cn({mem, i32});
+    auto g    = helper(w, Lam::CC::C);
+    auto l    = w.nom_lam(w.cn({mem, i32, ret}), w.dbg("l"));
+    auto head = w.nom_lam(w.cn({mem, i32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(mem), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(mem), w.dbg("exit"));
+    auto next = w.nom_lam(ret, w.dbg("next"));
+    l->app(head, {l->var(0_s), w.lit_int_width(32, 0)});
+    head->branch(w.op(ICmp::ul, head->var(1), l->var(1)), body, exit, head->var(0_s));
+    body->app(g, {body->var(), head->var(1), next});
+    next->app(head, {next->var(0_s), next->var(1)});
+    exit->app(l->ret_var(), {exit->var(), head->var(1)});
+
+    auto f = w.nom_lam(w.cn({mem, i32, ret}), w.dbg("f"));
+    auto k = w.nom_lam(ret, w.dbg("k"));
+    f->app(l, {f->var(0_s), f->var(1), k});
+    k->app(l, {k->var(0_s), k->var(1), f->ret_var()});
+    f->make_external();
+}
+
+/// Counts the @em noms named @p name reachable from the externals of @p world.
+static size_t num_noms(const World& world, const std::string& name) {
+    size_t result = 0;
+    DefSet done;
+    std::vector<const Def*> stack;
+    for (const auto& [_, nom] : world.externals()) stack.emplace_back(nom);
+
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+        if (!done.emplace(def).second) continue;
+        if (auto nom = def->isa_nom(); nom && nom->name() == name) ++result;
+        for (auto op : def->extended_ops()) {
+            if (op != nullptr) stack.emplace_back(op);
+        }
+    }
+
+    return result;
+}
+
+/// Yields the number of calls of @c g that survive the Inliner configured by @p config.
+template<class B, class C>
+static size_t run(B build, C config) {
+    World w;
+    w.set(LogLevel::Error);
+    build(w);
+    PassMan man(w);
+    config(man.add<Inliner>());
+    man.run();
+    EXPECT_EQ(man.stats().undos, 0); // the Inliner never speculates
+    return num_calls(w, "g");
+}
+
+static auto calls(bool lit, Lam::CC cc = Lam::CC::C) { return [=](World& w) { calls(w, lit, cc); }; }
+static auto threshold(size_t t) { return [=](Inliner* inliner) { inliner->set_threshold(Lam::CC::C, t); }; }
+
+TEST(Inliner, Calls) {
+    EXPECT_EQ(run(calls(false), [](Inliner*) {}), 0);
+    EXPECT_EQ(run(calls(false), threshold(0)), 2);
+    EXPECT_EQ(run(calls(false), [](Inliner* inliner) { inliner->set_growth(0); }), 2);
+}
+
+TEST(Inliner, Device) {
+    auto huge = [](Inliner* inliner) { inliner->set_threshold(Lam::CC::Device, 1000); };
+    EXPECT_EQ(run(calls(false, Lam::CC::Device), huge), 2);
+    EXPECT_EQ(run(calls(true,  Lam::CC::Device), huge), 2);
+}
+
+TEST(Inliner, Bonus) {
+    // the Lit argument lets the first call fold - that pays off below the threshold for the plain calls
+    bool lit = false, in_loop = false;
+    for (size_t t = 0; t != 32; ++t) {
+        auto plain = run(calls(false), threshold(t));
+        auto with_lit = run(calls(true), threshold(t));
+        EXPECT_LE(with_lit, plain) << t;
+        lit |= with_lit < plain;
+
+        // calls within loops get a higher threshold - and the loop itself is never unrolled, or copies of the call would survive
+        auto in = run(loop, threshold(t));
+        EXPECT_TRUE(in == 0 || plain == 2) << t;
+        in_loop |= in == 0 && plain == 2;
+    }
+    EXPECT_TRUE(lit);
+    EXPECT_TRUE(in_loop);
+}
+
+TEST(Inliner, InlinedLoop) {
+    // l is inlined twice - the copies of its loop are loops as well and must not be unrolled
+    World w;
+    w.set(LogLevel::Error);
+    loops(w);
+    PassMan man(w);
+    man.add<Inliner>()->set_threshold(Lam::CC::C, 64);
+    man.run();
+    EXPECT_EQ(num_calls(w, "l"), 0);
+    EXPECT_EQ(num_noms(w, "head"), 2);
+    EXPECT_EQ(num_noms(w, "body"), 2);
+}
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/analyses/loopinfo.h"
+#include "thorin/analyses/scope.h"
+
+using namespace thorin;
+
+/// Describes <tt>for (i = init; test; i += step)</tt> in a function <tt>f(mem, n, ret)</tt>.
+struct Spec {
+    u64 init;
+    u64 step;
+    ICmp cmp;
+    std::optional<u64> bound;   ///< @c std::nullopt for the Var @c n of @c f.
+    bool swap      = false;     ///< <tt>bound cmp i</tt> instead of <tt>i cmp bound</tt>.
+    bool on_next   = false;     ///< Test <tt>i + step</tt> at the end of the body instead of @c i in the header.
+    bool exit_true = false;     ///< Leave the loop if the test holds instead of if it fails.
+    nat_t wmode    = WMode::none;
+};
+
+static Lam* build(World& w, const Spec& s) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f    = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto head = w.nom_lam(w.cn({mem, i32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn({mem}), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn({mem}), w.dbg("exit"));
+
+    auto n = s.bound ? w.lit_int_width(32, *s.bound) : f->var(1);
+    f->app(head, {f->var(0_s), w.lit_int_width(32, s.init)});
+    auto i = head->var(1);
+    auto next = w.op(Wrap::add, s.wmode, i, w.lit_int_width(32, s.step));
+    auto test = s.on_next ? next : i;
+    auto cond = s.swap ? w.op(s.cmp, n, test) : w.op(s.cmp, test, n);
+
+    if (s.on_next) {
+        head->app(body, head->var(0_s));
+        auto latch = w.nom_lam(w.cn({mem}), w.dbg("latch"));
+        if (s.exit_true)
+            body->branch(cond, exit, latch, body->var());
+        else
+            body->branch(cond, latch, exit, body->var());
+        latch->app(head, {latch->var(), next});
+    } else {
+        if (s.exit_true)
+            head->branch(cond, exit, body, head->var(0_s));
+        else
+            head->branch(cond, body, exit, head->var(0_s));
+        body->app(head, {body->var(), next});
+    }
+
+    exit->app(f->ret_var(), {exit->var(), i});
+    f->make_external();
+    return f;
+}
+
+/// Yields the trip count of the only loop - if countable.
+static std::optional<u64> trip_count(const Spec& spec) {
+    World w;
+    auto f = build(w, spec);
+    Scope scope(f);
+    LoopInfo info(scope.f_cfg());
+
+    EXPECT_EQ(info.loops().size(), 1);
+    const auto& loop = info.loops().front();
+    EXPECT_TRUE(loop->is_innermost());
+    EXPECT_EQ(loop->ind_vars().size(), 1);
+    const auto& tc = loop->trip_count();
+    if (!tc || !tc->countable) return {};
+    EXPECT_TRUE(tc->lit);
+    EXPECT_EQ(tc->count(), w.lit_int_width(32, *tc->lit));
+    return tc->lit;
+}
+
+/// Runs the loop described by @p spec with concrete values and yields how often the exit test keeps us in the loop or @c std::nullopt after @p max iterations.
+static std::optional<u64> simulate(const Spec& spec, u64 n, u64 max = 1000) {
+    auto sext = [](u64 x) { return s64(s32(u32(x))); };
+    auto holds = [&](u64 a, u64 b) {
+        a &= 0xffffffff, b &= 0xffffffff;
+        if (spec.swap) std::swap(a, b);
+        switch (spec.cmp) {
+            case ICmp::e:   return a == b;
+            case ICmp::ne:  return a != b;
+            case ICmp::ul:  return a <  b;
+            case ICmp::ule: return a <= b;
+            case ICmp::ug:  return a >  b;
+            case ICmp::uge: return a >= b;
+            case ICmp::sl:  return sext(a) <  sext(b);
+            case ICmp::sle: return sext(a) <= sext(b);
+            case ICmp::sg:  return sext(a) >  sext(b);
+            case ICmp::sge: return sext(a) >= sext(b);
+            default: ADD_FAILURE(); return false;
+        }
+    };
+
+    u64 i = spec.init;
+    for (u64 k = 0; k != max; ++k) {
+        auto test = spec.on_next ? i + spec.step : i;
+        if (holds(test, spec.bound.value_or(n)) == spec.exit_true) return k;
+        i += spec.step;
+    }
+    return {};
+}
+
+/// Replaces @p var in @p def by @p val and, thus, folds as much as possible.
+static const Def* subst(const Def* def, const Def* var, const Def* val) {
+    if (def == var) return val;
+    if (def->isa_nom() || def->num_ops() == 0) return def;
+    DefArray ops(def->num_ops(), [&](size_t i) { return subst(def->op(i), var, val); });
+    return def->rebuild(def->world(), def->type(), ops, def->dbg());
+}
+
+static void expect_count(const Spec& spec, std::optional<u64> expected) {
+    auto lit = trip_count(spec);
+    EXPECT_EQ(lit, expected);
+    // the trip count is the number of times the exit test keeps us in the loop
+    if (lit) {
+        EXPECT_EQ(*lit, simulate(spec, 0).value());
+    }
+}
+
+TEST(LoopInfo, Up) {
+    expect_count({0, 1, ICmp::ul,  10}, 10);
+    expect_count({0, 3, ICmp::ul,  10},  4);
+    expect_count({0, 3, ICmp::ule,  9},  4);
+    expect_count({7, 1, ICmp::ul,   3},  0);
+    expect_count({u64(-5), 1, ICmp::sl, 5}, 10);
+    expect_count({0, 1, ICmp::ule, 0xffffffff}, std::nullopt); // never fails
+}
+
+TEST(LoopInfo, Down) {
+    expect_count({10, u64(-1), ICmp::ug,  0}, 10);
+    expect_count({10, u64(-1), ICmp::uge, 1}, 10);
+    expect_count({10, u64(-3), ICmp::sg, u64(-2)}, 4);
+    expect_count({10, u64(-1), ICmp::ul, 20}, std::nullopt); // runs towards the wrong direction
+}
+
+TEST(LoopInfo, NotEqual) {
+    expect_count({0,  2, ICmp::ne, 10}, 5);
+    expect_count({10, u64(-2), ICmp::ne, 0}, 5);
+    expect_count({0,  3, ICmp::ne, 10}, std::nullopt); // skips the bound
+}
+
+TEST(LoopInfo, SwapNegate) {
+    // 10 ug i <=> i ul 10
+    expect_count({0, 1, ICmp::ug, 10, true}, 10);
+    // leave if i uge 10 <=> stay if i ul 10
+    expect_count({0, 1, ICmp::uge, 10, false, false, true}, 10);
+    // leave if 10 ule i
+    expect_count({0, 1, ICmp::ule, 10, true, false, true}, 10);
+    // do-while that tests the incremented value
+    expect_count({0, 1, ICmp::ul, 10, false, true}, 9);
+    // leave if i + 2 ne 10 - already the first test leaves
+    expect_count({0, 2, ICmp::ne, 10, false, true, true}, 0);
+}
+
+TEST(LoopInfo, Symbolic) {
+    auto symbolic = [](Spec spec, std::initializer_list<u64> ns) {
+        World w;
+        auto f = build(w, spec);
+        Scope scope(f);
+        LoopInfo info(scope.f_cfg());
+        const auto& tc = info.loops().front()->trip_count();
+        if (!tc || !tc->countable) return false;
+
+        EXPECT_FALSE(tc->lit);
+        auto count = tc->count();
+        // substitute n with each of ns to check against the simulation
+        for (auto n : ns) {
+            auto lit = isa_lit(subst(count, f->var(1), w.lit_int_width(32, n)));
+            auto expected = simulate(spec, n);
+            EXPECT_TRUE(lit && expected) << n;
+            if (lit && expected) {
+                EXPECT_EQ(*lit, *expected) << n;
+            }
+        }
+        return true;
+    };
+
+    EXPECT_TRUE(symbolic({0, 1, ICmp::ul, {}}, {0, 1, 10, 100}));
+    EXPECT_TRUE(symbolic({5, 1, ICmp::ul, {}}, {0, 5, 6, 100}));
+    EXPECT_TRUE(symbolic({5, 1, ICmp::ne, {}}, {5, 6, 100}));
+    EXPECT_TRUE(symbolic({100, u64(-1), ICmp::ug, {}}, {0, 50, 100, 200}));
+    EXPECT_TRUE(symbolic({0, 1, ICmp::ug, {}, true}, {0, 3}));
+    EXPECT_TRUE(symbolic({0, 1, ICmp::ule, {}, false, false, false, WMode::nuw}, {0, 3, 10}));
+    EXPECT_FALSE(symbolic({0, 1, ICmp::ule, {}}, {}));     // n might be the largest value
+    EXPECT_FALSE(symbolic({0, 2, ICmp::ul, {}}, {}));      // step != 1
+}
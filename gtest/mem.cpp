@@ -0,0 +1,314 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/fp/alloc2slot.h"
+#include "thorin/pass/fp/dse.h"
+#include "thorin/pass/fp/sroa.h"
+
+using namespace thorin;
+
+/// Counts all Def%s reachable from the externals of @p world for which @p pred holds.
+template<class P>
+static size_t count(const World& world, P pred) {
+    size_t result = 0;
+    DefSet done;
+    std::vector<const Def*> stack;
+    for (const auto& [_, nom] : world.externals()) stack.emplace_back(nom);
+
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+        if (!done.emplace(def).second) continue;
+        result += pred(def);
+        for (auto op : def->extended_ops()) {
+            if (op != nullptr) stack.emplace_back(op);
+        }
+    }
+
+    return result;
+}
+
+static size_t num_stores(const World& world) { return count(world, [](const Def* def) { return bool(isa<Tag::Store>(def)); }); }
+static size_t num_loads (const World& world) { return count(world, [](const Def* def) { return bool(isa<Tag::Load >(def)); }); }
+static size_t num_allocs(const World& world) { return count(world, [](const Def* def) { return bool(isa<Tag::Alloc>(def)); }); }
+static size_t num_slots (const World& world) { return count(world, [](const Def* def) { return bool(isa<Tag::Slot >(def)); }); }
+
+/// Provides a @c mem, two @c i32 values @c x and @c y, and pointers @c q, @c r (to @c i32) and @c s (to a pair) we know nothing about.
+struct Env {
+    Env()
+        : mem(w.type_mem())
+        , i32(w.type_int_width(32))
+        , pair(w.sigma({i32, i32}))
+        , f(w.nom_lam(w.cn({mem, i32, i32, w.type_ptr(i32), w.type_ptr(i32), w.type_ptr(pair)}), w.dbg("f")))
+        , m(f->var(0_s))
+        , x(f->var(1))
+        , y(f->var(2))
+        , q(f->var(3))
+        , r(f->var(4))
+        , s(f->var(5))
+    {}
+
+    /// The value a Load yields if its normalizer forwarded a Store, @c nullptr otherwise.
+    const Def* forwarded(const Def* load) { return isa<Tag::Load>(load) ? nullptr : load->projs<2>()[1]; }
+    const Def* lea(const Def* ptr, u64 i) { return w.op_lea(ptr, w.lit_int_mod(2, i)); }
+
+    World w;
+    const Def* mem;
+    const Def* i32;
+    const Def* pair;
+    Lam* f;
+    const Def* m;
+    const Def* x;
+    const Def* y;
+    const Def* q;
+    const Def* r;
+    const Def* s;
+};
+
+TEST(Mem, Forward) {
+    Env e;
+    auto& w = e.w;
+
+    // load(store(m, p, v), p) -> v
+    EXPECT_EQ(e.forwarded(w.op_load(w.op_store(e.m, e.q, e.x), e.q)), e.x);
+
+    // a fresh Slot/Alloc holds ⊥
+    auto [m1, p] = w.op_slot(e.i32, e.m)->projs<2>();
+    EXPECT_EQ(e.forwarded(w.op_load(m1, p)), w.bot(e.i32));
+    auto [m2, a] = w.op_alloc(e.i32, e.m)->projs<2>();
+    EXPECT_EQ(e.forwarded(w.op_load(m2, a)), w.bot(e.i32));
+
+    // the previous store is dead; so is storing what's already there
+    auto st = w.op_store(w.op_store(m1, p, e.x), p, e.y);
+    EXPECT_EQ(st, w.op_store(m1, p, e.y));
+    EXPECT_EQ(w.op_store(st, p, e.y), st);
+
+    // nothing to forward from
+    EXPECT_EQ(e.forwarded(w.op_load(e.m, e.q)), nullptr);
+}
+
+TEST(Mem, Disjoint) {
+    Env e;
+    auto& w = e.w;
+
+    // different Slots never alias
+    auto [m1, a] = w.op_slot(e.i32, e.m)->projs<2>();
+    auto [m2, b] = w.op_slot(e.i32, m1)->projs<2>();
+    auto m3 = w.op_store(w.op_store(m2, a, e.x), b, e.y);
+    EXPECT_EQ(e.forwarded(w.op_load(m3, a)), e.x);
+    EXPECT_EQ(e.forwarded(w.op_load(m3, b)), e.y);
+    EXPECT_EQ(e.forwarded(w.op_load(w.op_load(m3, e.q)->projs<2>()[0], a)), e.x); // skip Loads
+
+    // LEA paths that diverge at a literal index
+    auto [m4, s] = w.op_slot(e.pair, e.m)->projs<2>();
+    auto m5 = w.op_store(w.op_store(m4, e.lea(s, 0), e.x), e.lea(s, 1), e.y);
+    EXPECT_EQ(e.forwarded(w.op_load(m5, e.lea(s, 0))), e.x);
+    EXPECT_EQ(e.forwarded(w.op_load(m5, e.lea(s, 1))), e.y);
+    m5 = w.op_store(w.op_store(e.m, e.lea(e.s, 0), e.x), e.lea(e.s, 1), e.y);
+    EXPECT_EQ(e.forwarded(w.op_load(m5, e.lea(e.s, 0))), e.x);
+
+    // two arbitrary pointers may alias
+    auto m6 = w.op_store(w.op_store(e.m, e.q, e.x), e.r, e.y);
+    EXPECT_EQ(e.forwarded(w.op_load(m6, e.q)), nullptr);
+    EXPECT_EQ(e.forwarded(w.op_load(m6, e.r)), e.y);
+
+    // a Slot and an arbitrary pointer may alias, too - the pointer may have been obtained from the Slot
+    auto m7 = w.op_store(w.op_store(m2, a, e.x), e.q, e.y);
+    EXPECT_EQ(e.forwarded(w.op_load(m7, a)), nullptr);
+}
+
+TEST(Mem, Prefix) {
+    Env e;
+    auto& w = e.w;
+    auto [m1, s] = w.op_slot(e.pair, e.m)->projs<2>();
+
+    // the whole pair vs. one of its fields: one LEA path is a prefix of the other
+    auto m2 = w.op_store(m1, s, w.tuple({e.x, e.y}));
+    EXPECT_EQ(e.forwarded(w.op_load(m2, e.lea(s, 0))), nullptr);
+    auto m3 = w.op_store(m1, e.lea(s, 0), e.x);
+    EXPECT_EQ(e.forwarded(w.op_load(m3, s)), nullptr);
+
+    // a non-literal index may hit any field
+    auto i = w.op(Conv::u2u, w.type_int(2), e.x);
+    auto m4 = w.op_store(w.op_store(m1, e.lea(s, 0), e.x), w.op_lea(s, i), e.y);
+    EXPECT_EQ(e.forwarded(w.op_load(m4, e.lea(s, 0))), nullptr);
+    EXPECT_EQ(e.forwarded(w.op_load(m4, w.op_lea(s, i))), e.y);
+}
+
+TEST(Mem, LEA) {
+    Env e;
+    auto& w = e.w;
+    auto ptr_i32  = w.type_ptr(e.i32);
+    auto ptr_pair = w.type_ptr(e.pair);
+
+    // ⊥ pointer or ⊥ index yields a ⊥ pointer
+    EXPECT_EQ(e.lea(w.bot(ptr_pair), 1), w.bot(ptr_i32));
+    EXPECT_EQ(w.op_lea(e.s, w.bot(w.type_int(2))), w.bot(ptr_i32));
+
+    // the only element of a pointee with arity 1 is the pointee itself
+    EXPECT_EQ(w.op_lea(e.q, w.lit_int_mod(1, 0)), e.q);
+
+    // anything else stays as is - nested LEAs are not folded
+    auto lea = e.lea(e.s, 1);
+    ASSERT_TRUE(isa<Tag::LEA>(lea));
+    EXPECT_EQ(lea->type(), ptr_i32);
+    auto [_, t] = w.op_slot(w.sigma({e.pair, e.i32}), e.m)->projs<2>();
+    auto inner = e.lea(t, 0);
+    auto outer = isa<Tag::LEA>(e.lea(inner, 1));
+    ASSERT_TRUE(outer);
+    EXPECT_EQ(outer->arg(0), inner);
+    EXPECT_EQ(outer->type(), ptr_i32);
+}
+
+/// f(mem, x, ret) { s = slot [i32, i32]; s.0 = x; s.1 = x; g(mem) }; g(mem) { ret(load s.1) } - or @c ret(mem, x) if not @p read.
+static void dse_program(World& w, bool read) {
+    auto mem  = w.type_mem();
+    auto i32  = w.type_int_width(32);
+    auto pair = w.sigma({i32, i32});
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto g = w.nom_lam(w.cn(mem), w.dbg("g"));
+    auto x = f->var(1);
+
+    auto [m1, s] = w.op_slot(pair, f->var(0_s))->projs<2>();
+    auto m2 = w.op_store(m1, w.op_lea(s, w.lit_int_mod(2, 0)), x);
+    auto m3 = w.op_store(m2, w.op_lea(s, w.lit_int_mod(2, 1)), x);
+    f->app(g, m3);
+
+    if (read) {
+        auto [m4, v] = w.op_load(g->var(), w.op_lea(s, w.lit_int_mod(2, 1)))->projs<2>();
+        g->app(f->ret_var(), {m4, v});
+    } else {
+        g->app(f->ret_var(), {g->var(), x});
+    }
+    f->make_external();
+}
+
+TEST(Mem, DSE) {
+    auto run = [](bool read) {
+        World w;
+        w.set(LogLevel::Error);
+        dse_program(w, read);
+        EXPECT_EQ(num_stores(w), 2);
+        PassMan man(w);
+        man.add<DSE>();
+        man.run();
+        return std::tuple(num_stores(w), num_loads(w), man.stats().undos);
+    };
+
+    // nobody reads the Slot: all stores are dead
+    EXPECT_EQ(run(false), std::tuple(0, 0, 0));
+    // the Load through an LEA in g forces a roll back into f
+    EXPECT_EQ(run(true), std::tuple(2, 1, 1));
+}
+
+/// Runs Alloc2Slot on <tt>f(mem, x, q, ret) { (m, p) = alloc i32; ... }</tt> and yields whether the Alloc survives.
+/// @p body builds the rest of @c f from @c m and @c p.
+template<class B>
+static bool keeps_alloc(B body) {
+    World w;
+    w.set(LogLevel::Error);
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, w.type_ptr(w.type_ptr(i32)), w.cn({mem, i32})}), w.dbg("f"));
+    auto [m, p] = w.op_alloc(i32, f->var(0_s))->projs<2>();
+    body(w, f, m, p);
+    f->make_external();
+    EXPECT_EQ(num_allocs(w), 1);
+
+    PassMan man(w);
+    man.add<Alloc2Slot>();
+    man.run();
+    return num_allocs(w) != 0;
+}
+
+TEST(Alloc2Slot, NoEscape) {
+    auto mem = [](World& w) { return w.type_mem(); };
+
+    // Load/Store within f
+    EXPECT_FALSE(keeps_alloc([](World& w, Lam* f, const Def* m, const Def* p) {
+        auto [m1, v] = w.op_load(w.op_store(m, p, f->var(1)), p)->projs<2>();
+        f->app(f->ret_var(), {m1, v});
+    }));
+
+    // Load within a basic block of f
+    EXPECT_FALSE(keeps_alloc([&](World& w, Lam* f, const Def* m, const Def* p) {
+        auto bb = w.nom_lam(w.cn(mem(w)), w.dbg("bb"));
+        f->app(bb, w.op_store(m, p, f->var(1)));
+        auto [m1, v] = w.op_load(bb->var(), p)->projs<2>();
+        bb->app(f->ret_var(), {m1, v});
+    }));
+
+    // passing on the mem of the Alloc is fine
+    EXPECT_FALSE(keeps_alloc([&](World& w, Lam* f, const Def* m, const Def* p) {
+        auto bb = w.nom_lam(w.cn(mem(w)), w.dbg("bb"));
+        f->app(bb, m);
+        auto [m1, v] = w.op_load(w.op_store(bb->var(), p, f->var(1)), p)->projs<2>();
+        bb->app(f->ret_var(), {m1, v});
+    }));
+}
+
+TEST(Alloc2Slot, Escape) {
+    auto mem = [](World& w) { return w.type_mem(); };
+    auto i32 = [](World& w) { return w.type_int_width(32); };
+
+    // the pointer itself is stored
+    EXPECT_TRUE(keeps_alloc([](World& w, Lam* f, const Def* m, const Def* p) {
+        f->app(f->ret_var(), {w.op_store(m, f->var(2), p), f->var(1)});
+    }));
+
+    // used within another function h
+    EXPECT_TRUE(keeps_alloc([&](World& w, Lam* f, const Def* m, const Def* p) {
+        auto h = w.nom_lam(w.cn({mem(w), w.cn({mem(w), i32(w)})}), w.dbg("h"));
+        f->app(h, {w.op_store(m, p, f->var(1)), f->ret_var()});
+        auto [m1, v] = w.op_load(h->var(0_s), p)->projs<2>();
+        h->app(h->ret_var(), {m1, v});
+    }));
+
+    // used within a basic block of another function h
+    EXPECT_TRUE(keeps_alloc([&](World& w, Lam* f, const Def* m, const Def* p) {
+        auto h  = w.nom_lam(w.cn({mem(w), w.cn({mem(w), i32(w)})}), w.dbg("h"));
+        auto bb = w.nom_lam(w.cn(mem(w)), w.dbg("bb"));
+        f->app(h, {w.op_store(m, p, f->var(1)), f->ret_var()});
+        h->app(bb, h->var(0_s));
+        auto [m1, v] = w.op_load(bb->var(), p)->projs<2>();
+        bb->app(h->ret_var(), {m1, v});
+    }));
+}
+
+/// f(mem, x, ret) { (m, p) = alloc [i32, i32]; p.0 = x; ret(mem, p.0) } - or @c ret(mem, load p.0) if not @p escape.
+static void field_program(World& w, bool escape) {
+    auto mem  = w.type_mem();
+    auto i32  = w.type_int_width(32);
+    auto pair = w.sigma({i32, i32});
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, escape ? w.type_ptr(i32) : i32})}), w.dbg("f"));
+
+    auto [m1, p] = w.op_alloc(pair, f->var(0_s))->projs<2>();
+    auto field = w.op_lea(p, w.lit_int_mod(2, 0));
+    auto m2 = w.op_store(m1, field, f->var(1));
+    if (escape) {
+        f->app(f->ret_var(), {m2, field});
+    } else {
+        auto [m3, v] = w.op_load(m2, field)->projs<2>();
+        f->app(f->ret_var(), {m3, v});
+    }
+    f->make_external();
+}
+
+TEST(Alloc2Slot, SROA) {
+    auto run = [](bool escape) {
+        World w;
+        w.set(LogLevel::Error);
+        field_program(w, escape);
+        PassMan man(w);
+        auto a2s = man.add<Alloc2Slot>();
+        man.add<SROA>(a2s);
+        man.run();
+        return std::pair(num_allocs(w), num_slots(w));
+    };
+
+    // alloc struct, return pointer to a field must keep the Alloc - although SROA has already split the Slot
+    EXPECT_EQ(run(true), std::pair(size_t(1), size_t(0)));
+    // otherwise, we end up with one Slot per field
+    EXPECT_EQ(run(false), std::pair(size_t(0), size_t(2)));
+}
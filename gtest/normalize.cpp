@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <numeric>
+
+#include "thorin/fold.h"
+#include "thorin/world.h"
+
+using namespace thorin;
+
+/// Runs @c Fold<O, o, width> for a @p width only known at runtime.
+template<class O, O o>
+static std::optional<u64> run(nat_t width, u64 a, u64 b, bool nsw = false, bool nuw = false) {
+    Res res;
+    switch (width) {
+#define CODE(i)                                                         \
+        case i:                                                         \
+            if constexpr (std::is_same_v<O, Wrap>)                      \
+                res = Fold<O, o, i>::run(a, b, nsw, nuw);               \
+            else                                                        \
+                res = Fold<O, o, i>::run(a, b);                         \
+            break;
+        THORIN_8_16_32_64(CODE)
+#undef CODE
+        default: ADD_FAILURE() << "unexpected width " << width; return {};
+    }
+    if (!res) return {};
+    return *res & (width == 64 ? u64(-1) : (1_u64 << width) - 1_u64);
+}
+
+static nat_t width(const Def* def) { return *mod2width(as_lit(def->type()->as<App>()->arg())); }
+
+using Eval = std::function<std::optional<u64>(u64)>;
+
+/// Compiles @p def - built from Lit%s, @p x, and the primops strength reduction emits - into a function of @p x.
+/// The function yields @c std::nullopt for ⊥.
+static Eval compile(const Def* def, const Def* x) {
+    if (def == x) return [](u64 val) { return std::optional(val); };
+    if (auto lit = def->isa<Lit>()) return [l = lit->get()](u64) { return std::optional(l); };
+    if (def->isa<Bot>()) return [](u64) { return std::optional<u64>(); };
+
+    auto w = width(def);
+    if (auto conv = isa<Tag::Conv>(def)) {
+        EXPECT_EQ(conv.flags(), Conv::u2u);
+        return [src = compile(conv->arg(), x), mask = w == 64 ? u64(-1) : (1_u64 << w) - 1_u64](u64 val) {
+            auto s = src(val);
+            return s ? std::optional(*s & mask) : s;
+        };
+    }
+
+    auto app = def->as<App>();
+    auto lhs = compile(app->arg(0), x), rhs = compile(app->arg(1), x);
+    auto bin = [&](auto f) -> Eval {
+        return [=](u64 val) -> std::optional<u64> {
+            auto a = lhs(val), b = rhs(val);
+            if (!a || !b) return {};
+            return f(*a, *b);
+        };
+    };
+
+    if (auto wrap = isa<Tag::Wrap>(def)) {
+        auto mode = as_lit(wrap->decurry()->arg(0));
+        bool nsw = mode & WMode::nsw, nuw = mode & WMode::nuw;
+        switch (wrap.flags()) {
+#define CODE(T, o) case T::o: return bin([=](u64 a, u64 b) { return run<T, T::o>(w, a, b, nsw, nuw); });
+            THORIN_WRAP(CODE)
+#undef CODE
+            default: THORIN_UNREACHABLE;
+        }
+    } else if (auto shr = isa<Tag::Shr>(def)) {
+        switch (shr.flags()) {
+#define CODE(T, o) case T::o: return bin([=](u64 a, u64 b) { return run<T, T::o>(w, a, b); });
+            THORIN_SHR(CODE)
+#undef CODE
+            default: THORIN_UNREACHABLE;
+        }
+    } else if (isa<Tag::Bit>(Bit::_and, def)) {
+        return bin([](u64 a, u64 b) { return std::optional(a & b); });
+    }
+
+    ADD_FAILURE() << "unexpected primop";
+    return [](u64) { return std::optional<u64>(); };
+}
+
+/// Sign-extends the @p w-bit pattern @p x.
+static s64 sext(u64 x, nat_t w) { return w == 64 ? s64(x) : s64(x << (64 - w)) >> (64 - w); }
+
+/// Checks strength reduction of <tt>d * x</tt> as well as <tt>x / d</tt> and <tt>x % d</tt> for all @p d and @p xs.
+template<nat_t W>
+static void check(World& w, ArrayRef<u64> ds, ArrayRef<u64> xs) {
+    auto type = w.type_int_width(W);
+    auto f = w.nom_lam(w.cn({w.type_mem(), type}), w.dbg("f"));
+    auto mem = f->var(0_s), x = f->var(1);
+
+    for (auto d : ds) {
+        auto lit = w.lit_int_width(W, d);
+        for (nat_t mode : {nat_t(WMode::none), nat_t(WMode::nsw), nat_t(WMode::nuw), nat_t(WMode::nsw | WMode::nuw)}) {
+            auto mul = w.op(Wrap::mul, mode, lit, x);
+            EXPECT_TRUE(!is_power_of_2(d) || d == 1 || isa<Tag::Wrap>(Wrap::shl, mul)) << d;
+
+            auto eval = compile(mul, x);
+            for (auto a : xs) {
+                auto res = eval(a);
+                auto expected = run<Wrap, Wrap::mul>(W, d, a);
+                if (res) {
+                    if (res != expected) ADD_FAILURE() << d << " * " << a;
+                } else {
+                    // ⊥ is only allowed if the multiplication really overflows
+                    auto u = (unsigned __int128)(d) * a;
+                    auto s = (__int128)(sext(d, W)) * sext(a, W);
+                    bool uov = u >> W, sov = s < -((__int128)(1) << (W - 1)) || s >= ((__int128)(1) << (W - 1));
+                    EXPECT_TRUE(((mode & WMode::nuw) && uov) || ((mode & WMode::nsw) && sov)) << d << " * " << a;
+                }
+            }
+        }
+
+#define CODE(T, o)                                                                                          \
+        {                                                                                                   \
+            auto div = w.op(T::o, mem, x, lit);                                                             \
+            bool reduced = !isa<Tag::Div>(div);                                                             \
+            EXPECT_TRUE(reduced || !is_power_of_2(d)                                                        \
+                        || ((T::o == Div::sdiv || T::o == Div::srem) && d == (1_u64 << (W - 1)))) << d;     \
+            if (reduced) {                                                                                  \
+                auto eval = compile(div->proj(1), x);                                                       \
+                for (auto a : xs) {                                                                         \
+                    if (eval(a) != run<T, T::o>(W, a, d)) ADD_FAILURE() << #o << ' ' << a << ", " << d;       \
+                }                                                                                           \
+            }                                                                                               \
+        }
+        THORIN_DIV(CODE)
+#undef CODE
+    }
+}
+
+static std::vector<u64> all(nat_t w) {
+    std::vector<u64> result(1_u64 << w);
+    std::iota(result.begin(), result.end(), 0);
+    return result;
+}
+
+TEST(StrengthReduction, Exhaustive8) {
+    World w;
+    auto xs = all(8);
+    check<8>(w, xs, xs);
+}
+
+TEST(StrengthReduction, Sampled16) {
+    World w;
+
+    // small, power-of-two-ish, and every 61st other divisor/factor against the interesting dividends
+    std::vector<u64> ds;
+    for (u64 d = 0; d != 1024; ++d) ds.emplace_back(d);
+    for (u64 k = 10; k != 16; ++k) ds.insert(ds.end(), {(1_u64 << k) - 1_u64, 1_u64 << k, (1_u64 << k) + 1_u64});
+    for (u64 d = 1024; d < 65536; d += 61) ds.emplace_back(d);
+    for (u64 d = 65536 - 8; d != 65536; ++d) ds.emplace_back(d);
+    std::vector<u64> edges = {0, 1, 2, 3, 127, 128, 129, 255, 256, 257, 1000, 32766, 32767, 32768, 32769, 65534, 65535};
+    check<16>(w, ds, edges);
+
+    // every dividend against small, large, and power-of-two divisors
+    ds.clear();
+    for (u64 d = 0; d != 16; ++d) ds.emplace_back(d);
+    for (u64 k : {7, 8, 15}) ds.insert(ds.end(), {(1_u64 << k) - 1_u64, 1_u64 << k, (1_u64 << k) + 1_u64});
+    for (u64 d = 65536 - 3; d != 65536; ++d) ds.emplace_back(d);
+    check<16>(w, ds, all(16));
+}
+
+TEST(StrengthReduction, Sampled32) {
+    World w;
+    std::vector<u64> xs = {0, 1, 2, 3, 5, 19, 20, 21, 127, 128, 1000, 65535, 65536, 999999, 0x7fffffff, 0x80000000, 0x80000001, 0xfffffffe, 0xffffffff};
+    std::vector<u64> ds = {2, 3, 5, 6, 7, 10, 20, 25, 100, 641, 1000, 65537, 1u << 31, 0x7fffffff, 0xfffffffe, 0xffffffff};
+    check<32>(w, ds, xs);
+}
+
+/// Shifting by the width or more yields ⊥ - whether the shifted value is a literal or not.
+TEST(Normalize, ShiftWidth) {
+    World w;
+    for (nat_t width : {8, 16, 32, 64}) {
+        auto type = w.type_int_width(width);
+        auto f = w.nom_lam(w.cn({w.type_mem(), type}), w.dbg("f"));
+        auto x = f->var(1);
+        auto a = w.lit_int_width(width, 0x5a);
+
+        for (u64 b : {width - 1, width, width + 1}) {
+            auto lb = w.lit_int_width(width, b);
+            bool bot = b >= width;
+            EXPECT_EQ(w.op(Shr::lshr, x, lb)->isa<Bot>() != nullptr, bot) << width << ' ' << b;
+            EXPECT_EQ(w.op(Shr::ashr, x, lb)->isa<Bot>() != nullptr, bot) << width << ' ' << b;
+            EXPECT_EQ(w.op(Wrap::shl, WMode::none, x, lb)->isa<Bot>() != nullptr, bot) << width << ' ' << b;
+            EXPECT_EQ(w.op(Shr::lshr, a, lb)->isa<Bot>() != nullptr, bot) << width << ' ' << b;
+            EXPECT_EQ(w.op(Shr::ashr, a, lb)->isa<Bot>() != nullptr, bot) << width << ' ' << b;
+            EXPECT_EQ(w.op(Wrap::shl, WMode::none, a, lb)->isa<Bot>() != nullptr, bot) << width << ' ' << b;
+            EXPECT_EQ((run<Shr, Shr::lshr>(width, 0x5a, b).has_value()), !bot) << width << ' ' << b;
+            EXPECT_EQ((run<Shr, Shr::ashr>(width, 0x5a, b).has_value()), !bot) << width << ' ' << b;
+        }
+
+        EXPECT_EQ(w.op(Shr::lshr, a, w.lit_int_width(width, width - 1)), w.lit_int_width(width, 0));
+    }
+}
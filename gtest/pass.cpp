@@ -0,0 +1,355 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <regex>
+#include <sstream>
+
+#include "thorin/world.h"
+#include "thorin/analyses/deptree.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/schedule.h"
+#include "thorin/pass/fp/beta_red.h"
+#include "thorin/pass/fp/copy_prop.h"
+#include "thorin/pass/fp/eta_exp.h"
+#include "thorin/pass/fp/eta_red.h"
+#include "thorin/pass/fp/ssa_constr.h"
+
+using namespace thorin;
+
+/// f(mem, n, ret) { slot s = 0; for i < n: s = load s + i; ret(load s) }
+static Lam* slot_loop(World& w, const std::string& name) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f    = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg(name));
+    auto head = w.nom_lam(w.cn({mem, i32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn({mem}), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn({mem}), w.dbg("exit"));
+
+    auto [m1, ptr] = w.op_slot(i32, f->var(0_s))->projs<2>();
+    f->app(head, {w.op_store(m1, ptr, w.lit_int_width(32, 0)), w.lit_int_width(32, 0)});
+    auto i = head->var(1);
+    head->branch(w.op(ICmp::sl, i, f->var(1)), body, exit, head->var(0_s));
+    auto [m2, v] = w.op_load(body->var(0_s), ptr)->projs<2>();
+    body->app(head, {w.op_store(m2, ptr, w.op(Wrap::add, WMode::none, v, i)), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1))});
+    auto [m3, r] = w.op_load(exit->var(0_s), ptr)->projs<2>();
+    exit->app(f->ret_var(), {m3, r});
+    f->make_external();
+    return f;
+}
+
+static void add_passes(PassMan& man) {
+    auto br = man.add<BetaRed>();
+    auto er = man.add<EtaRed>();
+    auto ee = man.add<EtaExp>(er);
+    man.add<SSAConstr>(ee);
+    man.add<CopyProp>(br, ee);
+}
+
+TEST(PassMan, JsonStats) {
+    auto run = [](std::ostream& os) {
+        World w;
+        w.set(LogLevel::Error);
+        for (int i = 0; i != 3; ++i) slot_loop(w, "f" + std::to_string(i));
+        PassMan man(w);
+        add_passes(man);
+        man.set_json_stats(&os);
+        man.run();
+        return man.stats().undos;
+    };
+
+    std::ostringstream os;
+    auto undos = run(os);
+    auto json = os.str();
+    EXPECT_EQ(json.rfind("{\"time\": ", 0), 0) << json;
+    EXPECT_EQ(json.substr(json.size() - 3), "]}\n") << json;
+    EXPECT_EQ(std::count(json.begin(), json.end(), '\n'), 1) << json;
+    for (auto name : {"beta_red", "eta_red", "eta_exp", "ssa_constr", "copy_prop"})
+        EXPECT_NE(json.find(std::string("{\"name\": \"") + name + "\""), std::string::npos) << name;
+    EXPECT_NE(json.find("\"undos\": " + std::to_string(undos) + ","), std::string::npos) << json;
+}
+
+TEST(PassMan, Reclaim) {
+    // the roll backs of SSAConstr reclaim the Def%s built speculatively
+    World w;
+    w.set(LogLevel::Error);
+    slot_loop(w, "f");
+    PassMan man(w);
+    add_passes(man);
+    man.run();
+    EXPECT_GT(man.stats().undos, 0);
+    EXPECT_GT(man.stats().reclaimed, 0);
+    EXPECT_FALSE(w.is_journaling());
+}
+
+/// Streams @p world without the gids in the names - they depend on the order in which Def%s have been created.
+static std::string strip(const World& world) {
+    std::ostringstream os;
+    Stream s(os);
+    world.stream(s);
+    return std::regex_replace(os.str(), std::regex("_[0-9]+"), "");
+}
+
+/// Independent externals f0, f1, ... plus g0 and g1 which share the helper h.
+static void components(World& w, int n) {
+    for (int i = 0; i != n; ++i) slot_loop(w, "f" + std::to_string(i));
+
+    auto h = slot_loop(w, "h");
+    h->make_internal();
+    for (int i = 0; i != 2; ++i) {
+        auto g = w.nom_lam(h->type(), w.dbg("g" + std::to_string(i)));
+        g->app(h, {g->var(0_s), w.op(Wrap::add, WMode::none, g->var(1), w.lit_int_width(32, i)), g->ret_var()});
+        g->make_external();
+    }
+}
+
+TEST(PassMan, Partition) {
+    // 0: the whole World at once, 1: one component after the other, 2: all components concurrently
+    auto run = [](int mode) {
+        World w;
+        w.set(LogLevel::Error);
+        components(w, 32);
+        EXPECT_EQ(DepTree(w).components().size(), 33);
+        if (mode == 0) {
+            PassMan man(w);
+            add_passes(man);
+            man.run();
+        } else {
+            ThreadPool pool(4);
+            PassMan::run_parallel(w, add_passes, mode == 2 ? &pool : nullptr);
+            EXPECT_FALSE(w.is_concurrent());
+        }
+        return strip(w);
+    };
+
+    auto whole = run(0);
+    EXPECT_EQ(whole.find("slot"), std::string::npos) << whole; // SSAConstr did its job
+    EXPECT_EQ(run(1), whole);
+    for (int i = 0; i != 8; ++i) EXPECT_EQ(run(2), whole) << i;
+}
+
+/// A random call DAG of @p n functions <tt>f_i(mem, x, ret)</tt>; each one calls up to two of its next 8 successors in sequence.
+/// The first @p e functions are external.
+static std::vector<Lam*> call_dag(World& w, unsigned seed, int n, int e) {
+    std::mt19937 rng(seed);
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto ret = w.cn({mem, i32});
+    std::vector<Lam*> fs;
+    for (int i = 0; i != n; ++i) fs.emplace_back(w.nom_lam(w.cn({mem, i32, ret}), w.dbg("f" + std::to_string(i))));
+
+    for (int i = 0; i != n; ++i) {
+        auto f = fs[i];
+        Lam* curr = f;
+        const Def* m = f->var(0_s);
+        const Def* x = f->var(1);
+        for (int c = 0, num = i + 1 < n ? 1 + rng() % 2 : 0; c != num; ++c) {
+            auto callee = fs[i + 1 + rng() % std::min(n - i - 1, 8)];
+            auto k = w.nom_lam(ret, w.dbg("k"));
+            curr->app(callee, {m, w.op(Wrap::add, WMode::none, x, w.lit_int_width(32, c + 1)), k});
+            curr = k;
+            m = k->var(0_s);
+            x = k->var(1);
+        }
+        curr->app(f->ret_var(), {m, x});
+        if (i < e) f->make_external();
+    }
+
+    return fs;
+}
+
+TEST(PassMan, CallGraphSchedule) {
+    World w;
+    auto fs = call_dag(w, 0, 20, 1);
+    PassMan man(w);
+    std::vector<Def*> externals = {fs[0]};
+
+    // each f_i calls some f_j with j > i
+    for (auto order : {CallGraphSchedule::Order::RPO, CallGraphSchedule::Order::Post_Order}) {
+        CallGraphSchedule schedule(order);
+        schedule.init(man, externals);
+        for (size_t i = 0; i != fs.size(); ++i) {
+            for (auto op : fs[i]->body()->as<App>()->args()) {
+                auto callee = op->isa_nom<Lam>();
+                if (callee == nullptr || std::find(fs.begin(), fs.end(), callee) == fs.end()) continue;
+                if (order == CallGraphSchedule::Order::RPO)
+                    EXPECT_LT(schedule.priority(man, fs[i]), schedule.priority(man, callee)) << fs[i] << " -> " << callee;
+                else
+                    EXPECT_GT(schedule.priority(man, fs[i]), schedule.priority(man, callee)) << fs[i] << " -> " << callee;
+            }
+        }
+    }
+}
+
+/// Optimizes some call_dag%s with each schedule: all of them must agree on the result.
+/// RPO visits users before the noms they reference, so each undo discards fewer States than with the default depth-first schedule.
+TEST(PassMan, ScheduleBench) {
+    enum { Default, RPO, Post_Order };
+    size_t states[3] = {}, undos[3] = {};
+    for (unsigned seed = 0; seed != 4; ++seed) {
+        std::string results[3];
+        for (int policy : {Default, RPO, Post_Order}) {
+            World w;
+            w.set(LogLevel::Error);
+            call_dag(w, seed, 100, 5);
+            PassMan man(w);
+            add_passes(man);
+            if (policy == RPO)        man.set_schedule<CallGraphSchedule>(CallGraphSchedule::Order::RPO);
+            if (policy == Post_Order) man.set_schedule<CallGraphSchedule>(CallGraphSchedule::Order::Post_Order);
+            man.run();
+            states[policy] += man.stats().states;
+            undos [policy] += man.stats().undos;
+            results[policy] = strip(w);
+        }
+        EXPECT_EQ(results[RPO],        results[Default]) << seed;
+        EXPECT_EQ(results[Post_Order], results[Default]) << seed;
+    }
+
+    const char* names[3] = {"default", "rpo", "post_order"};
+    for (int policy : {Default, RPO, Post_Order}) {
+        RecordProperty(std::string(names[policy]) + "_states", int(states[policy]));
+        RecordProperty(std::string(names[policy]) + "_undos",  int(undos [policy]));
+    }
+    EXPECT_LT(states[RPO], states[Default]);
+}
+
+/// f(mem, x, ret) { if x == 0 then g(mem, x) else h(mem, g) } - g occurs as callee and as argument, so EtaExp wraps it.
+static void callee_and_arg(World& w) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto ret = w.cn({mem, i32});
+    auto f = w.nom_lam(w.cn({mem, i32, ret}), w.dbg("f"));
+    auto g = w.nom_lam(ret, w.dbg("g"));
+    auto h = w.nom_lam(w.cn({mem, ret}), w.dbg("h"));
+    auto a = w.nom_lam(w.cn(mem), w.dbg("a"));
+    auto b = w.nom_lam(w.cn(mem), w.dbg("b"));
+
+    f->branch(w.op(ICmp::e, f->var(1), w.lit_int_width(32, 0)), a, b, f->var(0_s));
+    a->app(g, {a->var(), f->var(1)});
+    b->app(h, {b->var(), g});
+    g->app(f->ret_var(), g->var());
+    h->app(h->ret_var(), {h->var(0_s), w.lit_int_width(32, 42)});
+    f->make_external();
+}
+
+TEST(PassMan, Budget) {
+    auto run = [](auto set_budget) {
+        World w;
+        w.set(LogLevel::Error);
+        callee_and_arg(w);
+        PassMan man(w);
+        auto er = man.add<EtaRed>();
+        auto ee = man.add<EtaExp>(er);
+        set_budget(man, ee);
+        man.run();
+        EXPECT_EQ(ee->stats().exhausted, ee->budget().rewrites == 0 || man.budget().undos == 0);
+        return std::pair(strip(w).find("eta_g") != std::string::npos, man.stats().undos);
+    };
+
+    // unlimited: g is wrapped after a roll back
+    auto [wrapped, undos] = run([](PassMan&, EtaExp*) {});
+    EXPECT_TRUE(wrapped);
+    EXPECT_GT(undos, 0);
+
+    // an exhausted pass doesn't start to speculate
+    Budget none;
+    none.rewrites = 0;
+    EXPECT_EQ(run([&](PassMan&, EtaExp* ee) { ee->set_budget(none); }), std::pair(false, size_t(0)));
+
+    // same if the PassMan runs out of budget as a whole
+    Budget no_undos;
+    no_undos.undos = 0;
+    EXPECT_EQ(run([&](PassMan& man, EtaExp*) { man.set_budget(no_undos); }), std::pair(false, size_t(0)));
+}
+
+TEST(PassMan, Deep) {
+    // f(mem, x, y, ret) { ret(mem, ((y + x) * x + x) * ...) } - such a chain used to overflow the stack in PassMan::rewrite
+    const size_t n = 50000;
+    World w;
+    w.set(LogLevel::Error);
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto x = f->var(1);
+    auto res = f->var(2);
+    for (size_t i = 0; i != n; ++i) res = w.op(i % 2 ? Wrap::mul : Wrap::add, WMode::none, res, x);
+    f->app(f->ret_var(), {f->var(0_s), res});
+    f->make_external();
+
+    PassMan man(w);
+    add_passes(man);
+    man.run();
+
+    // the chain survives as is - the normalizer commutes the older x to the left
+    f = w.lookup("f")->as_nom<Lam>();
+    x = f->var(1);
+    res = f->body()->as<App>()->arg(1);
+    size_t size = 0;
+    for (auto wrap = isa<Tag::Wrap>(res); wrap && wrap->arg(0) == x; wrap = isa<Tag::Wrap>(res), ++size) res = wrap->arg(1);
+    EXPECT_EQ(res, f->var(2));
+    EXPECT_EQ(size, n);
+}
+
+/// Rewrites each <tt>x + 1</tt> to <tt>x + 2</tt> and rolls back into @c k once.
+class Shadow : public FPPass<Shadow, Lam> {
+public:
+    Shadow(PassMan& man)
+        : FPPass(man, "shadow")
+    {}
+
+    using Data = std::tuple<>;
+
+    std::map<std::string, size_t> rewrites; ///< Number of <tt>x + 1</tt>s seen in each @em nom.
+
+private:
+    const Def* rewrite(const Def* def) override {
+        if (auto wrap = isa<Tag::Wrap>(Wrap::add, def); wrap && wrap->arg(0) == world().lit_int_width(32, 1)) {
+            ++rewrites[curr_nom()->name()];
+            return world().op(Wrap::add, WMode::none, wrap->arg(1), world().lit_int_width(32, 2));
+        }
+        return def;
+    }
+
+    undo_t analyze(const Def*) override {
+        if (done_ || curr_nom()->name() != "k") return No_Undo;
+        done_ = true;
+        return undo_enter(curr_nom());
+    }
+
+    bool done_ = false;
+};
+
+TEST(PassMan, Shadow) {
+    // f(mem, x, ret) { k(mem, x + 1) }; k(mem, y) { ret(mem, y * (x + 1)) }
+    World w;
+    w.set(LogLevel::Error);
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto k = w.nom_lam(w.cn({mem, i32}), w.dbg("k"));
+    auto x1 = w.op(Wrap::add, WMode::none, f->var(1), w.lit_int_width(32, 1));
+    f->app(k, {f->var(0_s), x1});
+    k->app(f->ret_var(), {k->var(0_s), w.op(Wrap::mul, WMode::none, k->var(1), x1)});
+    f->make_external();
+
+    PassMan man(w);
+    auto shadow = man.add<Shadow>();
+    man.run();
+
+    // k's State shadows the mapping x + 1 -> x + 2 of f's State; the roll back into k pops k's State and
+    // reuses its undo level with a new stamp - f's mapping must come back instead of rewriting x + 1 once more
+    EXPECT_EQ(man.stats().undos, 1);
+    EXPECT_EQ(shadow->rewrites["f"], 1);
+    EXPECT_EQ(shadow->rewrites["k"], 0);
+
+    // both uses of x + 1 are x + 2 now
+    auto x2 = [](const Def* def, const Def* x) {
+        auto wrap = isa<Tag::Wrap>(Wrap::add, def);
+        return wrap && wrap->arg(1) == x && isa_lit(wrap->arg(0)) == 2;
+    };
+    f = w.lookup("f")->as_nom<Lam>();
+    k = f->body()->as<App>()->callee()->as_nom<Lam>();
+    EXPECT_TRUE(x2(f->body()->as<App>()->arg(1), f->var(1)));
+    auto mul = isa<Tag::Wrap>(Wrap::mul, k->body()->as<App>()->arg(1));
+    ASSERT_TRUE(mul);
+    EXPECT_TRUE(x2(mul->arg(0), f->var(1)) || x2(mul->arg(1), f->var(1)));
+}
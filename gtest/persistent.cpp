@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <set>
+
+#include "thorin/util/persistent.h"
+
+using namespace thorin;
+
+/// Uses only the lowest @p Bits of the key as hash - lets us provoke collisions on all levels of the trie.
+template<int Bits>
+struct WeakHash {
+    static hash_t hash(u64 k) { return hash_t(k & ((u64(1) << Bits) - 1)); }
+    static bool eq(u64 a, u64 b) { return a == b; }
+    static u64 sentinel() { return u64(-1); }
+};
+
+using FullHash = WeakHash<32>;
+
+template<class M>
+static std::map<u64, int> to_map(const M& map) {
+    std::map<u64, int> result;
+    for (const auto& [k, v] : map) EXPECT_TRUE(result.emplace(k, v).second) << k;
+    EXPECT_EQ(result.size(), map.size());
+    return result;
+}
+
+TEST(PersistentMap, Insert) {
+    PersistentMap<u64, int, FullHash> map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_FALSE(map.lookup(23));
+
+    std::map<u64, int> ref;
+    for (u64 i = 0; i != 1000; ++i) {
+        auto k = i * 7919;
+        auto [entry, ins] = map.emplace(k, int(i));
+        EXPECT_TRUE(ins);
+        EXPECT_EQ(entry->second, int(i));
+        ref[k] = int(i);
+    }
+
+    EXPECT_EQ(map.size(), 1000);
+    EXPECT_EQ(to_map(map), ref);
+    for (const auto& [k, v] : ref) EXPECT_EQ(map.lookup(k), v);
+    EXPECT_FALSE(map.contains(1));
+}
+
+TEST(PersistentMap, Overwrite) {
+    PersistentMap<u64, int, FullHash> map;
+    map[1] = 1;
+    map[2] = 2;
+
+    auto [entry, ins] = map.emplace(1, 42);
+    EXPECT_FALSE(ins);
+    EXPECT_EQ(entry->second, 1); // emplace doesn't overwrite
+    map[1] = 23;
+    EXPECT_EQ(map.lookup(1), 23);
+    EXPECT_EQ(map.lookup(2), 2);
+    EXPECT_EQ(map.size(), 2);
+}
+
+TEST(PersistentMap, Erase) {
+    PersistentMap<u64, int, FullHash> map;
+    std::map<u64, int> ref;
+    for (u64 i = 0; i != 500; ++i) map[i] = ref[i] = int(i);
+
+    EXPECT_FALSE(map.erase(1000));
+    for (u64 i = 0; i < 500; i += 3) {
+        EXPECT_TRUE(map.erase(i));
+        EXPECT_FALSE(map.erase(i));
+        ref.erase(i);
+    }
+    EXPECT_EQ(to_map(map), ref);
+
+    // reinsert into the emptied slots
+    for (u64 i = 0; i < 500; i += 3) map[i] = ref[i] = -int(i);
+    EXPECT_EQ(to_map(map), ref);
+
+    for (u64 i = 0; i != 500; ++i) map.erase(i);
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(PersistentMap, Collisions) {
+    auto test = [](auto map) {
+        std::map<u64, int> ref;
+        for (u64 i = 0; i != 300; ++i) map[i] = ref[i] = int(i);
+        EXPECT_EQ(to_map(map), ref);
+
+        for (u64 i = 0; i != 300; i += 2) {
+            EXPECT_TRUE(map.erase(i));
+            ref.erase(i);
+        }
+        EXPECT_EQ(to_map(map), ref);
+        for (u64 i = 0; i != 300; ++i) EXPECT_EQ(map.contains(i), i % 2 == 1) << i;
+    };
+
+    test(PersistentMap<u64, int, WeakHash<0>>()); // all keys collide
+    test(PersistentMap<u64, int, WeakHash<3>>()); // groups of keys collide
+    test(PersistentMap<u64, int, WeakHash<7>>()); // keys diverge on the second level
+}
+
+TEST(PersistentMap, Persistence) {
+    using Map = PersistentMap<u64, int, WeakHash<6>>;
+    std::vector<Map> versions(1);
+    std::vector<std::map<u64, int>> refs(1);
+
+    // each version modifies a copy of its predecessor
+    for (u64 i = 0; i != 200; ++i) {
+        auto map = versions.back();
+        auto ref = refs.back();
+        map[i] = ref[i] = int(i);
+        if (i % 5 == 0) map[i / 2] = ref[i / 2] = -int(i); // overwrite
+        if (i % 7 == 0) {
+            map.erase(i / 3);
+            ref.erase(i / 3);
+        }
+        versions.emplace_back(std::move(map));
+        refs.emplace_back(std::move(ref));
+    }
+
+    for (size_t v = 0; v != versions.size(); ++v) EXPECT_EQ(to_map(versions[v]), refs[v]) << v;
+
+    // branch off an old version
+    auto old = versions[50];
+    old[1000] = 1000;
+    old.erase(10);
+    EXPECT_EQ(to_map(versions[50]), refs[50]);
+    EXPECT_EQ(to_map(versions.back()), refs.back());
+    EXPECT_TRUE(old.contains(1000));
+    EXPECT_FALSE(old.contains(10));
+}
+
+TEST(PersistentSet, Persistence) {
+    using Set = PersistentSet<u64, WeakHash<4>>;
+    Set a;
+    for (u64 i = 0; i != 100; ++i) EXPECT_TRUE(a.insert(i));
+    EXPECT_FALSE(a.insert(42));
+
+    auto b = a;
+    EXPECT_TRUE(b.erase(42));
+    EXPECT_TRUE(b.insert(100));
+    EXPECT_TRUE(a.contains(42));
+    EXPECT_FALSE(a.contains(100));
+    EXPECT_FALSE(b.contains(42));
+    EXPECT_EQ(a.size(), 100);
+    EXPECT_EQ(b.size(), 100);
+
+    Set c;
+    EXPECT_TRUE(c.insert_range(b)); // shares b's structure
+    EXPECT_TRUE(c.insert(42));
+    EXPECT_FALSE(b.contains(42));
+    EXPECT_FALSE(c.insert_range(a));
+    EXPECT_EQ(std::set<u64>(c.begin(), c.end()).size(), 101);
+}
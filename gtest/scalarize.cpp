@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/rw/scalarize.h"
+
+using namespace thorin;
+
+/// Builds an internal @c g with domain @p dom and an external <tt>f(mem, x, ret)</tt> that calls @c g with @p args made from @c x and @c ret.
+/// Yields the callee and the arguments of this call after Scalerize.
+template<class A>
+static std::pair<Lam*, const App*> run(World& w, const Def* ret_type, const Def* dom, A args) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, ret_type}), w.dbg("f"));
+    auto g = w.nom_lam(w.cn(dom), w.dbg("g"));
+    g->app(g->ret_var(), {g->var(0_s), w.bot(ret_type->as<Pi>()->dom(1))});
+    f->app(g, args(f->var(0_s), f->var(1), f->ret_var()));
+    f->make_external();
+
+    PassMan man(w);
+    man.add<Scalerize>(nullptr);
+    man.run();
+
+    f = w.lookup("f")->as_nom<Lam>();
+    auto app = f->body()->as<App>();
+    return {app->callee()->as_nom<Lam>(), app};
+}
+
+TEST(Scalerize, Nested) {
+    World w;
+    auto mem  = w.type_mem();
+    auto i32  = w.type_int_width(32);
+    auto pair = w.sigma({i32, i32});
+    auto nom  = w.nom_sigma(2, w.dbg("S"))->set({i32, pair});
+    auto ret  = w.cn({mem, pair});
+
+    // g(mem, [i32, [i32, i32]], S, [i32; 2], ret) with S = {i32, [i32, i32]} and ret: cn(mem, [i32, i32])
+    auto [g, app] = run(w, ret, w.sigma({mem, w.sigma({i32, pair}), nom, w.arr(2, i32), ret}), [&](auto m, auto x, auto r) {
+        return w.tuple({m, w.tuple({x, w.tuple({x, x})}), w.tuple(nom, {x, w.tuple({x, x})}), w.pack(2, x), r});
+    });
+
+    // cleanup has rebuilt the World
+    mem = w.type_mem();
+    i32 = w.type_int_width(32);
+
+    // everything flattened recursively - including the return continuation
+    EXPECT_EQ(g->num_doms(), 1 + 3 + 3 + 2 + 1);
+    for (size_t i = 1; i != 9; ++i) EXPECT_EQ(g->dom(i), i32) << i;
+    auto flat_ret = w.cn({mem, i32, i32});
+    EXPECT_EQ(g->dom(9), flat_ret);
+
+    // f's return continuation doesn't know the flat signature: a wrapper rebuilds the pair
+    auto wrap = app->arg(9)->isa_nom<Lam>();
+    ASSERT_TRUE(wrap);
+    EXPECT_EQ(wrap->type(), flat_ret);
+    auto call = wrap->body()->as<App>();
+    EXPECT_EQ(call->callee(), w.lookup("f")->as_nom<Lam>()->ret_var());
+    EXPECT_EQ(call->arg(1), w.tuple({wrap->var(1), wrap->var(2)}));
+}
+
+TEST(Scalerize, MaxParams) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto arr = w.arr(Scalerize::Max_Arity, i32);
+    auto ret = w.cn({mem, i32});
+
+    // g(mem, [i32; 16], [i32; 16], [i32; 16], ret): each array on its own is small enough, but not all of them together
+    auto [g, app] = run(w, ret, w.sigma({mem, arr, arr, arr, ret}), [&](auto m, auto x, auto r) {
+        auto a = w.pack(Scalerize::Max_Arity, x);
+        return w.tuple({m, a, a, a, r});
+    });
+
+    i32 = w.type_int_width(32);
+    arr = w.arr(Scalerize::Max_Arity, i32);
+
+    // 1 + 16 + 1 + 1 + 1 as the second array would exceed Max_Params
+    EXPECT_LE(g->num_doms(), Scalerize::Max_Params);
+    EXPECT_EQ(g->num_doms(), 1 + Scalerize::Max_Arity + 3);
+    EXPECT_EQ(g->dom(Scalerize::Max_Arity + 1), arr);
+    EXPECT_EQ(g->dom(Scalerize::Max_Arity + 2), arr);
+    EXPECT_EQ(app->num_args(), g->num_doms());
+}
+
+TEST(Scalerize, Recursive) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto ret = w.cn({mem, i32});
+
+    // S = [i32, cn[mem, S]] as well as T = [i32, cn[mem, U]] and U = [i32, T]
+    auto s = w.nom_sigma(2, w.dbg("S"));
+    s->set({i32, w.cn({mem, s})});
+    auto t = w.nom_sigma(2, w.dbg("T"));
+    auto u = w.nom_sigma(2, w.dbg("U"))->set({i32, t});
+    t->set({i32, w.cn({mem, u})});
+
+    // g(mem, S, T, [i32, i32], ret): both recursive Sigmas are passed as a whole
+    auto [g, app] = run(w, ret, w.sigma({mem, s, t, w.sigma({i32, i32}), ret}), [&](auto m, auto x, auto r) {
+        auto vs = w.tuple(s, {x, w.bot(w.cn({mem, s}))});
+        auto vt = w.tuple(t, {x, w.bot(w.cn({mem, u}))});
+        return w.tuple({m, vs, vt, w.tuple({x, x}), r});
+    });
+
+    EXPECT_EQ(g->num_doms(), 1 + 1 + 1 + 2 + 1);
+    EXPECT_EQ(g->dom(1)->name(), "S");
+    EXPECT_EQ(g->dom(2)->name(), "T");
+    EXPECT_EQ(app->num_args(), g->num_doms());
+}
@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <queue>
+
+#include "thorin/world.h"
+#include "thorin/analyses/domtree.h"
+#include "thorin/analyses/looptree.h"
+#include "thorin/analyses/schedule.h"
+#include "thorin/analyses/scope.h"
+#include "thorin/util/thread_pool.h"
+
+using namespace thorin;
+
+/// The recursive Scheduler this repo used before switching to dense indices - serves as reference for the placement.
+class Reference {
+public:
+    Reference(const Scope& scope)
+        : scope_(scope)
+        , cfg_(scope.f_cfg())
+        , domtree_(cfg_.domtree())
+        , looptree_(cfg_.looptree())
+    {
+        std::queue<const Def*> queue;
+        DefSet done;
+        auto enqueue = [&](const Def* def) { if (done.emplace(def).second) queue.push(def); };
+
+        for (auto n : cfg_.reverse_post_order()) {
+            if (n->nom()->is_set()) enqueue(n->nom());
+        }
+        while (!queue.empty()) {
+            auto def = queue.front();
+            queue.pop();
+            for (auto op : def->ops()) {
+                if (scope_.bound(op)) {
+                    def2uses_[op].emplace_back(def);
+                    enqueue(op);
+                }
+            }
+        }
+    }
+
+    const CFNode* place(const Def* def, Schedule::Mode mode) {
+        switch (mode) {
+            case Schedule::Early: return early(def);
+            case Schedule::Late:  return late(def);
+            default:              return smart(def);
+        }
+    }
+
+    const CFNode* early(const Def* def) {
+        if (auto i = early_.find(def); i != early_.end()) return i->second;
+
+        const CFNode* result;
+        if (auto nom = def->isa_nom()) {
+            result = cfg_[nom];
+        } else if (auto var = def->isa<Var>()) {
+            result = early(var->nom());
+        } else {
+            result = cfg_.entry();
+            for (auto op : def->ops()) {
+                if (op->isa_nom() || !def2uses_.contains(op)) continue;
+                auto n = early(op);
+                if (domtree_.depth(n) > domtree_.depth(result)) result = n;
+            }
+        }
+
+        return early_[def] = result;
+    }
+
+    const CFNode* late(const Def* def) {
+        if (auto i = late_.find(def); i != late_.end()) return i->second;
+
+        const CFNode* result = nullptr;
+        if (auto nom = def->isa_nom()) {
+            result = cfg_[nom];
+        } else if (auto var = def->isa<Var>()) {
+            result = late(var->nom());
+        } else {
+            for (auto use : def2uses_[def]) {
+                auto n = late(use);
+                result = result ? domtree_.least_common_ancestor(result, n) : n;
+            }
+        }
+
+        return late_[def] = result;
+    }
+
+    const CFNode* smart(const Def* def) {
+        auto early = this->early(def), late = this->late(def);
+        auto result = late;
+        int depth = looptree_[late]->depth();
+        for (auto n = late; n != early;) {
+            n = domtree_.idom(n);
+            int curr_depth = looptree_[n]->depth();
+            if (curr_depth < depth) {
+                result = n;
+                depth = curr_depth;
+            }
+        }
+        return result;
+    }
+
+    const DefMap<DefVec>& def2uses() const { return def2uses_; }
+
+private:
+    const Scope& scope_;
+    const F_CFG& cfg_;
+    const DomTree& domtree_;
+    const LoopTree<true>& looptree_;
+    DefMap<DefVec> def2uses_;
+    DefMap<const CFNode*> early_, late_;
+};
+
+/// f(mem, n, ret) { for i in 0..n: for j in 0..n: acc += i*(n*n) + j*n; ret(mem, acc) }
+static Lam* nested_loop(World& w) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f      = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto head   = w.nom_lam(w.cn({mem, i32, i32}), w.dbg("head"));
+    auto inner  = w.nom_lam(w.cn({mem, i32, i32}), w.dbg("inner"));
+    auto body   = w.nom_lam(w.cn({mem}), w.dbg("body"));
+    auto latch  = w.nom_lam(w.cn({mem}), w.dbg("latch"));
+    auto exit   = w.nom_lam(w.cn({mem}), w.dbg("exit"));
+    auto add = [&](const Def* a, const Def* b) { return w.op(Wrap::add, WMode::none, a, b); };
+    auto mul = [&](const Def* a, const Def* b) { return w.op(Wrap::mul, WMode::none, a, b); };
+    auto one = w.lit_int_width(32, 1);
+
+    auto n = f->var(1);
+    f->app(head, {f->var(0_s), w.lit_int_width(32, 0), w.lit_int_width(32, 0)});
+
+    auto i = head->var(1), acc = head->var(2);
+    head->branch(w.op(ICmp::ul, i, n), latch, exit, head->var(0_s));
+    latch->app(inner, {latch->var(0_s), w.lit_int_width(32, 0), acc});
+
+    auto j = inner->var(1), iacc = inner->var(2);
+    auto next = w.nom_lam(w.cn({mem}), w.dbg("next"));
+    inner->branch(w.op(ICmp::ul, j, n), body, next, inner->var(0_s));
+    body->app(inner, {body->var(0_s), add(j, one), add(iacc, add(mul(i, mul(n, n)), mul(j, n)))});
+    next->app(head, {next->var(0_s), add(i, one), iacc});
+    exit->app(f->ret_var(), {exit->var(0_s), acc});
+    return f;
+}
+
+/// A chain of @p num_blocks blocks; each one computes @p num_defs additions on its own Var.
+static Lam* chain(World& w, size_t num_blocks, size_t num_defs) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+
+    Lam* prev = f;
+    const Def* x = f->var(1);
+    for (size_t b = 0; b != num_blocks; ++b) {
+        auto block = w.nom_lam(w.cn({mem, i32}), w.dbg("block"));
+        prev->app(block, {prev->var(0_s), x});
+        x = block->var(1);
+        for (size_t i = 0; i != num_defs; ++i) x = w.op(Wrap::add, WMode::none, x, w.lit_int_width(32, b * num_defs + i));
+        prev = block;
+    }
+    prev->app(f->ret_var(), {prev->var(0_s), x});
+    return f;
+}
+
+/// Checks that each block lists an operand before all of its users within the same block.
+static void expect_topo_sorted(const Schedule& schedule) {
+    for (auto& block : schedule) {
+        DefSet seen, defs(block.begin(), block.end());
+        for (auto def : block) {
+            for (auto op : def->ops()) EXPECT_TRUE(!defs.contains(op) || seen.contains(op)) << def << " before " << op;
+            seen.emplace(def);
+        }
+    }
+}
+
+TEST(Schedule, Reference) {
+    World w;
+    auto f = nested_loop(w);
+    Scope scope(f);
+    Reference ref(scope);
+
+    for (auto mode : {Schedule::Early, Schedule::Late, Schedule::Smart}) {
+        auto schedule = Schedule(scope, mode);
+        DefSet placed;
+        for (auto& block : schedule) {
+            for (auto def : block) {
+                EXPECT_EQ(ref.place(def, mode), block.node()) << def;
+                placed.emplace(def);
+            }
+        }
+
+        for (const auto& [def, _] : ref.def2uses()) EXPECT_TRUE(def->isa_nom() || placed.contains(def)) << def;
+        expect_topo_sorted(schedule);
+    }
+}
+
+TEST(Schedule, Hoist) {
+    World w;
+    auto f = nested_loop(w);
+    Scope scope(f);
+    const auto schedule = Schedule(scope, Schedule::Smart);
+
+    // n*n is loop-invariant and goes to the entry
+    auto nn = w.op(Wrap::mul, WMode::none, f->var(1), f->var(1));
+    auto& entry = schedule[scope.f_cfg().entry()];
+    EXPECT_NE(std::find(entry.begin(), entry.end(), nn), entry.end());
+}
+
+TEST(Schedule, Parallel) {
+    World w;
+    auto f = chain(w, 64, 100);
+    Scope scope(f);
+
+    auto blocks = [&] {
+        std::vector<DefVec> result;
+        auto schedule = Schedule(scope, Schedule::Smart);
+        for (auto& block : schedule) result.emplace_back(block.begin(), block.end());
+        expect_topo_sorted(schedule);
+        return result;
+    };
+
+    ASSERT_EQ(ThreadPool::global(), nullptr);
+    auto sequential = blocks();
+    ThreadPool::enable_global(4);
+    auto parallel = blocks();
+    ThreadPool::disable_global();
+    EXPECT_EQ(sequential, parallel);
+}
+
+/// f(mem, n, ret) { for i in 0..n: acc += (n*3 + n+4) + (n*5 + n+6) + ...; ret(mem, acc) } with @p k invariant products and sums each.
+static Lam* invariants(World& w, size_t k) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f    = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto head = w.nom_lam(w.cn({mem, i32, i32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn({mem}), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn({mem}), w.dbg("exit"));
+
+    auto n = f->var(1);
+    f->app(head, {f->var(0_s), w.lit_int_width(32, 0), w.lit_int_width(32, 0)});
+    auto i = head->var(1), acc = head->var(2);
+    head->branch(w.op(ICmp::ul, i, n), body, exit, head->var(0_s));
+
+    const Def* sum = acc;
+    for (size_t j = 0; j != k; ++j) {
+        auto mul = w.op(Wrap::mul, WMode::none, n, w.lit_int_width(32, 2*j + 3));
+        auto add = w.op(Wrap::add, WMode::none, n, w.lit_int_width(32, 2*j + 4));
+        sum = w.op(Wrap::add, WMode::none, sum, w.op(Wrap::add, WMode::none, mul, add));
+    }
+    body->app(head, {body->var(0_s), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1)), sum});
+    exit->app(f->ret_var(), {exit->var(0_s), acc});
+    return f;
+}
+
+TEST(Schedule, Pressure) {
+    World w;
+    auto f = invariants(w, 8);
+    Scope scope(f);
+    auto entry = scope.f_cfg().entry();
+
+    auto place = [&](const Schedule& schedule) {
+        std::vector<std::pair<const Def*, const CFNode*>> result;
+        for (auto& block : schedule)
+            for (auto def : block) result.emplace_back(def, block.node());
+        std::sort(result.begin(), result.end(), [](auto a, auto b) { return a.first->gid() < b.first->gid(); });
+        return result;
+    };
+
+    // counts the invariant products and sums in the entry
+    auto hoisted = [&](size_t budget) {
+        auto def2node = place(Schedule(scope, Schedule::Pressure, budget));
+        size_t muls = 0, adds = 0;
+        for (const auto& [def, node] : def2node) {
+            if (node != entry) continue;
+            muls += bool(isa<Tag::Wrap>(Wrap::mul, def));
+            adds += bool(isa<Tag::Wrap>(Wrap::add, def));
+        }
+        return std::pair(muls, adds);
+    };
+
+    // enough room: everything is hoisted like in Smart
+    EXPECT_EQ(hoisted(1000), std::pair(size_t(8), size_t(8)));
+
+    // no room at all: same as Late
+    EXPECT_EQ(place(Schedule(scope, Schedule::Pressure, 0)), place(Schedule(scope, Schedule::Late)));
+
+    // the expensive products are hoisted before the cheap sums - one more for each additional register
+    size_t prev = 0;
+    for (size_t budget = 0; budget != 32; ++budget) {
+        auto [muls, adds] = hoisted(budget);
+        EXPECT_TRUE(adds == 0 || muls == 8) << budget;
+        EXPECT_LE(muls + adds, prev + 1) << budget;
+        prev = muls + adds;
+    }
+    EXPECT_EQ(prev, 16);
+}
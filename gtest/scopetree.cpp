@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/analyses/scope.h"
+#include "thorin/analyses/scopetree.h"
+
+using namespace thorin;
+
+/// All @em noms reachable from the externals of @p world.
+static std::vector<Def*> noms(const World& world) {
+    std::vector<Def*> result;
+    DefSet done;
+    std::vector<const Def*> stack;
+    for (const auto& [_, nom] : world.externals()) stack.emplace_back(nom);
+
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+        if (def->no_dep() || !done.emplace(def).second) continue;
+        if (auto nom = def->isa_nom()) result.emplace_back(nom);
+        for (auto op : def->extended_ops()) stack.emplace_back(op);
+    }
+
+    return result;
+}
+
+template<class S>
+static void expect_equal(const S& a, const S& b, Def* nom, const char* what) {
+    EXPECT_EQ(a.size(), b.size()) << what << " of " << nom;
+    for (auto def : a) EXPECT_TRUE(b.contains(def)) << def << " missing in " << what << " of " << nom;
+}
+
+/// The view Scope(tree, nom) must agree with Scope(nom) for all reachable @em noms.
+static void expect_equal(World& world) {
+    ScopeTree tree(world);
+    auto all = noms(world);
+    ASSERT_FALSE(all.empty());
+
+    for (auto nom : all) {
+        ASSERT_NE(tree[nom], nullptr) << nom;
+        Scope scope(nom), view(tree, nom);
+
+        expect_equal(scope.bound(),     view.bound(),     nom, "bound");
+        expect_equal(scope.free_defs(), view.free_defs(), nom, "free_defs");
+        expect_equal(scope.free_vars(), view.free_vars(), nom, "free_vars");
+        expect_equal(scope.free_noms(), view.free_noms(), nom, "free_noms");
+
+        for (auto other : all) EXPECT_EQ(scope.bound(other), view.bound(other)) << other << " in " << nom;
+        for (auto def : scope.bound()) EXPECT_TRUE(view.bound(def)) << def << " in " << nom;
+        for (auto def : scope.free_defs()) EXPECT_FALSE(view.bound(def)) << def << " in " << nom;
+    }
+}
+
+TEST(ScopeTree, Nested) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto add = [&](const Def* a, const Def* b) { return w.op(Wrap::add, WMode::none, a, b); };
+
+    // f(x) { g(y) { h() { k(z) { l(r) }; r(v) { ret(x + y + z + v) } } } } - l doesn't use any Var
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto g = w.nom_lam(w.cn({mem, i32}), w.dbg("g"));
+    auto h = w.nom_lam(w.cn({mem}), w.dbg("h"));
+    auto k = w.nom_lam(w.cn({mem, i32}), w.dbg("k"));
+    auto l = w.nom_lam(w.cn({mem, w.cn({mem, i32})}), w.dbg("l"));
+    auto r = w.nom_lam(w.cn({mem, i32}), w.dbg("r"));
+    f->app(g, {f->var(0_s), add(f->var(1), w.lit_int_width(32, 1))});
+    g->app(h, g->var(0_s));
+    h->app(k, {h->var(), add(g->var(1), f->var(1))});
+    k->app(l, {k->var(0_s), r});
+    r->app(f->ret_var(), {r->var(0_s), add(add(f->var(1), g->var(1)), add(k->var(1), r->var(1)))});
+    l->app(l->ret_var(), {l->var(0_s), w.lit_int_width(32, 42)});
+    f->make_external();
+
+    expect_equal(w);
+
+    ScopeTree tree(w);
+    EXPECT_EQ(tree[g]->parent(), tree[f]);
+    EXPECT_EQ(tree[h]->parent(), tree[g]);
+    EXPECT_EQ(tree[k]->parent(), tree[g]);
+    EXPECT_EQ(tree[r]->parent(), tree[k]);
+    EXPECT_EQ(tree[l]->parent(), tree.root());
+    EXPECT_TRUE (tree[f]->contains(tree[r]));
+    EXPECT_FALSE(tree[f]->contains(tree[l]));
+}
+
+TEST(ScopeTree, Recursive) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+
+    // e(x) { a() { b() }; b() { a() or r() }; r() { ret(x) } } - a and b are mutually recursive
+    auto e = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("e"));
+    auto a = w.nom_lam(w.cn({mem}), w.dbg("a"));
+    auto b = w.nom_lam(w.cn({mem}), w.dbg("b"));
+    auto r = w.nom_lam(w.cn({mem}), w.dbg("r"));
+    e->app(a, e->var(0_s));
+    a->app(b, a->var());
+    b->branch(w.op(ICmp::e, e->var(1), w.lit_int_width(32, 0)), r, a, b->var());
+    r->app(e->ret_var(), {r->var(), e->var(1)});
+    e->make_external();
+
+    // self-recursive f and mutually recursive top-level functions p and q
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    f->app(f, {f->var(0_s), w.op(Wrap::add, WMode::none, f->var(1), w.lit_int_width(32, 1)), f->ret_var()});
+    f->make_external();
+    auto p = w.nom_lam(w.cn({mem, w.cn({mem})}), w.dbg("p"));
+    auto q = w.nom_lam(w.cn({mem, w.cn({mem})}), w.dbg("q"));
+    p->app(q, {p->var(0_s), p->ret_var()});
+    q->app(p, {q->var(0_s), q->ret_var()});
+    p->make_external();
+
+    expect_equal(w);
+
+    ScopeTree tree(w);
+    EXPECT_EQ(tree[a]->parent(), tree[e]);
+    EXPECT_EQ(tree[b]->parent(), tree[e]);
+    EXPECT_EQ(tree[f]->parent(), tree.root());
+    EXPECT_EQ(tree[q]->parent(), tree.root());
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/rw/tail_rec_elim.h"
+
+using namespace thorin;
+
+/// Collects the @p Lam%s reachable from the externals of @p world by name.
+static std::map<std::string, Lam*> lams(const World& world) {
+    std::map<std::string, Lam*> result;
+    DefSet done;
+    std::vector<const Def*> stack;
+    for (const auto& [_, nom] : world.externals()) stack.emplace_back(nom);
+
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+        if (!done.emplace(def).second) continue;
+        if (auto lam = def->isa_nom<Lam>()) {
+            EXPECT_TRUE(result.emplace(lam->name(), lam).second) << lam;
+        }
+        for (auto op : def->extended_ops()) {
+            if (op != nullptr) stack.emplace_back(op);
+        }
+    }
+
+    return result;
+}
+
+/// f(mem, n, ret) { if n == 0 then ret(mem, 0) else f(mem, n - 1, k) }; k(mem, r) { f(mem, r, ret) }
+static void program(World& w) {
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto ret = w.cn({mem, i32});
+    auto f = w.nom_lam(w.cn({mem, i32, ret}), w.dbg("f"));
+    auto a = w.nom_lam(w.cn(mem), w.dbg("a"));
+    auto b = w.nom_lam(w.cn(mem), w.dbg("b"));
+    auto k = w.nom_lam(ret, w.dbg("k"));
+
+    f->branch(w.op(ICmp::e, f->var(1), w.lit_int_width(32, 0)), a, b, f->var(0_s));
+    a->app(f->ret_var(), {a->var(), w.lit_int_width(32, 0)});
+    b->app(f, {b->var(), w.op(Wrap::sub, WMode::none, f->var(1), w.lit_int_width(32, 1)), k});
+    k->app(f, {k->var(0_s), k->var(1), f->ret_var()});
+    f->make_external();
+}
+
+static void check(const World& w) {
+    auto ls = lams(w);
+    ASSERT_TRUE(ls.count("f") && ls.count("f_loop") && ls.count("b") && ls.count("k"));
+    auto f = ls["f"], loop = ls["f_loop"];
+
+    // the entry just jumps to the loop header
+    auto entry = f->body()->as<App>();
+    EXPECT_EQ(entry->callee(), loop);
+    EXPECT_EQ(entry->num_args(), 2);
+    EXPECT_EQ(entry->arg(0), f->var(0_s));
+    EXPECT_EQ(entry->arg(1), f->var(1));
+
+    // the tail call goes to the loop header ...
+    auto tail = ls["k"]->body()->as<App>();
+    EXPECT_EQ(tail->callee(), loop);
+    EXPECT_EQ(tail->num_args(), 2);
+
+    // ... the other call still goes to f as it passes its own return continuation
+    auto other = ls["b"]->body()->as<App>();
+    EXPECT_EQ(other->callee(), f);
+    EXPECT_EQ(other->arg(2), ls["k"]);
+}
+
+TEST(TailRecElim, Loop) {
+    World w;
+    w.set(LogLevel::Error);
+    program(w);
+    PassMan man(w);
+    man.add<TailRecElim>();
+    man.run();
+    check(w);
+}
+
+/// Rolls back into @c f once - as soon as it sees the tail call in @c k.
+class RollBack : public FPPass<RollBack, Lam> {
+public:
+    RollBack(PassMan& man)
+        : FPPass(man, "roll_back")
+    {}
+
+    using Data = std::tuple<>;
+
+private:
+    undo_t analyze(const Def* def) override {
+        if (done_ || curr_nom()->name() != "k") return No_Undo;
+        if (auto app = def->isa<App>(); app && app->callee()->isa_nom<Lam>()) {
+            done_ = true;
+            return undo_enter(world().lookup("f"));
+        }
+        return No_Undo;
+    }
+
+    bool done_ = false;
+};
+
+TEST(TailRecElim, RollBack) {
+    // the roll back restores the original body of f - TailRecElim has to redo its jump to f_loop
+    World w;
+    w.set(LogLevel::Error);
+    program(w);
+    PassMan man(w);
+    man.add<RollBack>();
+    man.add<TailRecElim>();
+    man.run();
+    EXPECT_EQ(man.stats().undos, 1);
+    check(w);
+}
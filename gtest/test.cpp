@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include "thorin/rewrite.h"
 #include "thorin/world.h"
 
 using namespace thorin;
@@ -12,3 +13,219 @@ TEST(HelloTest, BasicAssertions) {
     // Expect equality.
     EXPECT_EQ(7 * 6, 42);
 }
+
+// Each Def::proj of a nom Arr with literal shape substitutes its Var with a literal index.
+TEST(Apply, ProjArr) {
+    World w;
+    const nat_t n = 10000;
+    DefArray types(n, [&](size_t i) { return w.type_int_width(i % 64 + 1); });
+    auto tup = w.tuple(types);
+
+    auto dep = w.nom_arr(w.lit_nat(n));
+    dep->set(w.extract(tup, dep->var()));
+    auto plain = w.nom_arr(w.lit_nat(n));
+    plain->set(w.type_int_width(32));
+
+    for (nat_t i = 0; i != n; ++i) EXPECT_EQ(dep->proj(n, i), types[i]);
+    for (nat_t i = 0; i != n; ++i) EXPECT_EQ(plain->proj(n, i), w.type_int_width(32));
+    EXPECT_EQ(plain->has_var(), nullptr); // nothing to substitute - so, no need to create it
+
+    // Arr::restructure instantiates all indices at once
+    auto sigma = dep->restructure();
+    ASSERT_TRUE(sigma->isa<Sigma>());
+    ASSERT_EQ(sigma->num_ops(), n);
+    for (nat_t i = 0; i != n; ++i) EXPECT_EQ(sigma->op(i), types[i]);
+    EXPECT_EQ(plain->restructure(), w.arr(n, w.type_int_width(32)));
+}
+
+// rewrite_each must agree with rewrite - with and without the Scope-free fast path.
+TEST(Apply, RewriteEach) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto add = [&](const Def* a, const Def* b) { return w.op(Wrap::add, WMode::none, a, b); };
+
+    // no op depends on a nom
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    f->app(f->ret_var(), {f->var(0_s), add(f->var(1), w.lit_int_width(32, 1))});
+
+    // g's body references the nom k which in turn uses g's Var
+    auto g = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("g"));
+    auto k = w.nom_lam(w.cn(mem), w.dbg("k"));
+    k->app(g->ret_var(), {k->var(), add(g->var(1), g->var(1))});
+    g->app(k, g->var(0_s));
+
+    for (auto nom : {f, g}) {
+        auto ret = w.nom_lam(w.cn({mem, i32}), w.dbg("ret"));
+        DefArray args(4, [&](size_t i) { return w.tuple({w.bot(mem), w.lit_int_width(32, i), ret}); });
+        auto each = rewrite_each(nom, args);
+        ASSERT_EQ(each.size(), args.size());
+        for (size_t i = 0; i != args.size(); ++i) {
+            auto single = rewrite(nom, args[i]);
+            EXPECT_EQ(each[i].size(), single.size());
+            if (nom == f) { // structural results are hash-consed
+                EXPECT_TRUE(std::equal(each[i].begin(), each[i].end(), single.begin())) << i;
+            } else {        // k is copied for each argument
+                auto new_k = each[i].back()->as<App>()->callee()->as_nom<Lam>();
+                EXPECT_NE(new_k, k);
+                EXPECT_EQ(new_k->body()->as<App>()->callee(), ret);
+                EXPECT_EQ(new_k->body()->as<App>()->arg(1), w.lit_int_width(32, 2*i)) << i;
+            }
+        }
+    }
+
+    // f's body after substitution
+    auto ret = w.nom_lam(w.cn({mem, i32}), w.dbg("ret"));
+    auto body = rewrite(f, w.tuple({w.bot(mem), w.lit_int_width(32, 41), ret})).back()->as<App>();
+    EXPECT_EQ(body->callee(), ret);
+    EXPECT_EQ(body->arg(1), w.lit_int_width(32, 42));
+}
+
+TEST(Apply, Cache) {
+    World w;
+    auto& cache = w.apply_cache();
+    cache.set_capacity(4);
+
+    auto tup = w.tuple({w.type_int_width(8), w.type_int_width(16), w.type_int_width(32)});
+    auto arr = w.nom_arr(w.lit_nat(3));
+    arr->set(w.extract(tup, arr->var()));
+
+    EXPECT_EQ(arr->proj(3, 1), w.type_int_width(16));
+    EXPECT_EQ(arr->proj(3, 1), w.type_int_width(16));
+    EXPECT_EQ(cache.stats().hits, 1);
+
+    // modifying the nom drops its stale instances
+    arr->set(w.type_int_width(64));
+    EXPECT_EQ(cache.stats().invalidations, 1);
+    EXPECT_EQ(arr->proj(3, 1), w.type_int_width(64));
+
+    // the cache never exceeds its capacity
+    for (nat_t i = 0; i != 8; ++i) arr->apply(w.lit_nat(i));
+    EXPECT_EQ(cache.size(), 4);
+    EXPECT_GT(cache.stats().evictions, 0);
+    EXPECT_GT(cache.stats().bytes, 0);
+
+    // g(mem, x, ret) { k(mem) }; k(mem) { ret(mem, x) } - each instance of g depends on k as well
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto g = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("g"));
+    auto k = w.nom_lam(w.cn(mem), w.dbg("k"));
+    k->app(g->ret_var(), {k->var(), g->var(1)});
+    g->app(k, g->var(0_s));
+
+    auto ret = w.nom_lam(w.cn({mem, i32}), w.dbg("ret"));
+    DefArray args(2, [&](size_t i) { return w.tuple({w.bot(mem), w.lit_int_width(32, i), ret}); });
+    g->apply_each(args);
+    auto hits = cache.stats().hits;
+    g->apply(args[1]);
+    EXPECT_EQ(cache.stats().hits, hits + 1);
+
+    auto invalidations = cache.stats().invalidations;
+    k->set_filter(true);
+    EXPECT_EQ(cache.stats().invalidations, invalidations + 2);
+}
+
+TEST(World, Reclaim) {
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto v = f->var(1);
+    auto one = w.lit_int_width(32, 1);
+
+    w.set_journal();
+    auto mark = w.journal_size();
+    auto x = w.op(Wrap::add, WMode::none, v, one);
+    auto y = w.op(Wrap::mul, WMode::none, x, w.lit_int_width(32, 2));
+
+    // y and x are gone along with all their operands that depend on v - the Lit%s stay as they don't depend on anything
+    EXPECT_GE(w.reclaim(mark), 2);
+    EXPECT_TRUE(v->uses().empty());
+    EXPECT_TRUE(w.defs().contains(one));
+    EXPECT_FALSE(w.defs().contains(x));
+
+    // building x again brings back the very same Def
+    EXPECT_EQ(w.op(Wrap::add, WMode::none, v, one), x);
+    EXPECT_FALSE(v->uses().empty());
+
+    // using y brings back y - and x as well
+    w.reclaim(mark);
+    EXPECT_TRUE(v->uses().empty());
+    f->app(f->ret_var(), {f->var(0_s), y});
+    EXPECT_TRUE(w.defs().contains(x));
+    EXPECT_TRUE(w.defs().contains(y));
+    EXPECT_EQ(x->uses().size(), 1);
+    EXPECT_EQ(w.op(Wrap::mul, WMode::none, x, w.lit_int_width(32, 2)), y);
+
+    // used Def%s stay
+    w.reclaim(mark);
+    EXPECT_TRUE(w.defs().contains(y));
+}
+
+/// Yields <tt>((y + x) * x + x) * ...</tt> with @p n operations - each one nests the previous ones.
+static const Def* chain(World& w, const Def* x, const Def* y, size_t n) {
+    for (size_t i = 0; i != n; ++i) y = w.op(i % 2 ? Wrap::mul : Wrap::add, WMode::none, y, x);
+    return y;
+}
+
+/// Yields the number of operations if @p def is a chain of @p x and @p y - or @c 0 otherwise.
+static size_t chain_size(const Def* def, const Def* x, const Def* y) {
+    size_t n = 0;
+    for (; def != y; ++n) {
+        auto wrap = isa<Tag::Wrap>(def);
+        // the normalizer commutes the older x to the left
+        if (!wrap || wrap.flags() != (n % 2 ? Wrap::add : Wrap::mul) || wrap->arg(0) != x) return 0;
+        def = wrap->arg(1);
+    }
+    return n;
+}
+
+TEST(Rewriter, Deep) {
+    // such a chain used to overflow the stack of the recursive Rewriter
+    const size_t n = 50000;
+    World w;
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto x = f->var(1);
+    f->app(f->ret_var(), {f->var(0_s), chain(w, x, f->var(2), n)});
+    f->make_external();
+    cleanup(w);
+
+    f = w.lookup("f")->as_nom<Lam>();
+    EXPECT_EQ(chain_size(f->body()->as<App>()->arg(1), f->var(1), f->var(2)), n);
+}
+
+TEST(Rewriter, Noms) {
+    // g(mem, n, ret) { k(mem, ⊥:A) }; k(mem, a: A) { k(mem, a) } with A = «2; int n» as a nom Arr
+    World w;
+    auto mem = w.type_mem();
+    auto nat = w.type_nat();
+    auto g = w.nom_lam(w.cn({mem, nat, w.cn(mem)}), w.dbg("g"));
+    auto a = w.nom_arr(w.kind(), w.lit_nat(2), w.dbg("A"));
+    a->set(w.type_int(g->var(1)));
+    auto k = w.nom_lam(w.cn({mem, static_cast<const Def*>(a)}), w.dbg("k"));
+    k->app(k, {k->var(0_s), k->var(1)});
+    g->app(k, {g->var(0_s), w.bot(a)});
+
+    Scope scope(g);
+    Rewriter rewriter(w, &scope);
+    rewriter.old2new[g->var()] = w.tuple({w.bot(mem), w.lit_nat(16), w.bot(w.cn(mem))});
+    auto app = rewriter.rewrite(g->body())->as<App>();
+
+    // A restructures to a plain Sigma - k is stubbed and its recursion refers to the stub
+    auto i16 = w.type_int(16);
+    auto new_a = w.sigma({i16, i16});
+    auto new_k = app->callee()->as_nom<Lam>();
+    EXPECT_NE(new_k, k);
+    EXPECT_EQ(rewriter.old2new[a], new_a);
+    EXPECT_EQ(rewriter.old2new[k], new_k);
+    EXPECT_EQ(new_k->type(), w.cn({mem, new_a}));
+    EXPECT_EQ(app->arg(1), w.bot(new_a));
+    EXPECT_EQ(new_k->body()->as<App>()->callee(), new_k);
+    EXPECT_EQ(new_k->body()->as<App>()->arg(1), new_k->var(1));
+
+    // Def%s that are not bound by the Scope stay as they are
+    EXPECT_EQ(rewriter.rewrite(mem), mem);
+    EXPECT_EQ(rewriter.rewrite(w.lit_nat(16)), w.lit_nat(16));
+}
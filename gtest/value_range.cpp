@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <random>
+
+#include "thorin/fold.h"
+#include "thorin/world.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/fp/value_range.h"
+
+using namespace thorin;
+using Val = ValueRange::Val;
+
+static constexpr nat_t W = 8;
+
+static bool contains(const Val& v, u64 x) { return (x & v.zeros) == 0 && (x & v.ones) == v.ones && v.lo <= x && x <= v.hi; }
+
+/// All values of width W that @p v describes.
+static std::vector<u64> gamma(const Val& v) {
+    std::vector<u64> result;
+    for (u64 x = 0; x != 1_u64 << W; ++x) {
+        if (contains(v, x)) result.emplace_back(x);
+    }
+    return result;
+}
+
+/// Random Val%s: joins of a few literals close to each other or patterns of known bits.
+static std::vector<Val> vals(unsigned seed, size_t n) {
+    std::mt19937 rng(seed);
+    std::vector<Val> result;
+    while (result.size() != n) {
+        Val v;
+        if (rng() % 2) {
+            auto base = rng() % (1 << W);
+            auto span = 1 << (rng() % (W + 1));
+            v = Val::lit(W, base);
+            for (size_t i = 0, e = rng() % 3; i != e; ++i) v = v.join(Val::lit(W, (base + rng() % span) % (1 << W)));
+        } else {
+            auto known = rng() & rng() & ((1 << W) - 1);
+            auto bits  = rng() & known;
+            v = {~bits & known, bits, 0, (1 << W) - 1};
+        }
+        if (auto t = v.tighten(W)) result.emplace_back(*t);
+    }
+    return result;
+}
+
+using Concrete = std::function<Res(u64, u64)>;
+using Abstract = std::function<Val(const Val&, const Val&)>;
+
+/// The abstract result must contain each concrete result; if @p exact, it must be a literal for literal operands.
+/// As ValueRange does, we tighten each abstract result - this must not yield ⊥ if a concrete result exists.
+static void check(const char* name, Abstract abstract, Concrete concrete, bool exact = true) {
+    auto vs = vals(0, 48);
+    for (u64 a = 0; a < 1_u64 << W; a += 7) vs.emplace_back(Val::lit(W, a));
+
+    for (const auto& a : vs) {
+        for (const auto& b : vs) {
+            auto res = abstract(a, b).tighten(W);
+            for (auto x : gamma(a)) {
+                for (auto y : gamma(b)) {
+                    if (auto r = concrete(x, y); r && !(res && contains(*res, *r))) {
+                        ADD_FAILURE() << name << ' ' << x << ", " << y << " = " << *r;
+                        return;
+                    }
+                }
+            }
+
+            if (exact && a.is_lit() && b.is_lit()) {
+                if (auto r = concrete(a.lo, b.lo)) {
+                    EXPECT_TRUE(res && res->is_lit() && res->lo == *r) << name << ' ' << a.lo << ", " << b.lo;
+                }
+            }
+        }
+    }
+}
+
+TEST(ValueRange, Wrap) {
+    // a product that may wrap around is ⊤ - even for literals
+#define CODE(T, o) check(#o, [](const Val& a, const Val& b) { return ValueRange::transfer(T::o, a, b, W); }, \
+                             [](u64 x, u64 y) { return Fold<T, T::o, W>::run(x, y, false, false); }, T::o != T::mul);
+    THORIN_WRAP(CODE)
+#undef CODE
+}
+
+TEST(ValueRange, Shr) {
+    // ashr only knows what to do with non-negative values
+#define CODE(T, o) check(#o, [](const Val& a, const Val& b) { return ValueRange::transfer(T::o, a, b, W); }, \
+                             [](u64 x, u64 y) { return Fold<T, T::o, W>::run(x, y); }, T::o == T::lshr);
+    THORIN_SHR(CODE)
+#undef CODE
+}
+
+TEST(ValueRange, Bit) {
+    auto abstract = [](Bit bit) { return [bit](const Val& a, const Val& b) { return ValueRange::transfer(bit, a, b, W); }; };
+    check("and", abstract(Bit::_and), [](u64 x, u64 y) { return Res(x & y); });
+    check( "or", abstract(Bit:: _or), [](u64 x, u64 y) { return Res(x | y); });
+    check("xor", abstract(Bit::_xor), [](u64 x, u64 y) { return Res(x ^ y); });
+}
+
+TEST(ValueRange, Div) {
+    // the transfer function only deals with the unsigned ones - and only bounds the remainder
+    check("udiv", [](const Val& a, const Val& b) { return ValueRange::transfer(Div::udiv, a, b, W); },
+                  [](u64 x, u64 y) { return Fold<Div, Div::udiv, W>::run(x, y); });
+    check("urem", [](const Val& a, const Val& b) { return ValueRange::transfer(Div::urem, a, b, W); },
+                  [](u64 x, u64 y) { return Fold<Div, Div::urem, W>::run(x, y); }, false);
+}
+
+TEST(ValueRange, ICmp) {
+    auto vs = vals(1, 48);
+    for (u64 a = 0; a < 1_u64 << W; a += 5) vs.emplace_back(Val::lit(W, a));
+
+    size_t folded = 0;
+#define CODE(T, o)                                                                                      \
+    for (const auto& a : vs) {                                                                          \
+        for (const auto& b : vs) {                                                                      \
+            auto res = ValueRange::transfer(T::o, a, b, W);                                             \
+            if (a.is_lit() && b.is_lit()) {                                                             \
+                EXPECT_EQ(res, bool(*Fold<T, T::o, W>::run(a.lo, b.lo))) << #o << ' ' << a.lo << ", " << b.lo; \
+            }                                                                                           \
+            if (!res) continue;                                                                         \
+            ++folded;                                                                                   \
+            for (auto x : gamma(a)) {                                                                   \
+                for (auto y : gamma(b)) {                                                               \
+                    if (bool(*Fold<T, T::o, W>::run(x, y)) != *res) ADD_FAILURE() << #o << ' ' << x << ", " << y; \
+                }                                                                                       \
+            }                                                                                           \
+        }                                                                                               \
+    }
+    THORIN_I_CMP(CODE)
+#undef CODE
+    EXPECT_GT(folded, 0);
+}
+
+/// Counts the ICmp%s reachable from the externals of @p world.
+static size_t num_icmps(const World& world) {
+    size_t result = 0;
+    DefSet done;
+    std::vector<const Def*> stack;
+    for (const auto& [_, nom] : world.externals()) stack.emplace_back(nom);
+
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+        if (!done.emplace(def).second) continue;
+        result += bool(isa<Tag::ICmp>(def));
+        for (auto op : def->extended_ops()) {
+            if (op != nullptr) stack.emplace_back(op);
+        }
+    }
+
+    return result;
+}
+
+/// f(mem, c, ret) { if c == 0 then g(mem, 3) else g(mem, 5) }; g(mem, x) { if x < 8 then ret(mem, x) else ret(mem, 0) }
+TEST(ValueRange, Join) {
+    World w;
+    w.set(LogLevel::Error);
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({mem, i32, w.cn({mem, i32})}), w.dbg("f"));
+    auto g = w.nom_lam(w.cn({mem, i32}), w.dbg("g"));
+    auto a = w.nom_lam(w.cn(mem), w.dbg("a"));
+    auto b = w.nom_lam(w.cn(mem), w.dbg("b"));
+    auto t = w.nom_lam(w.cn(mem), w.dbg("t"));
+    auto e = w.nom_lam(w.cn(mem), w.dbg("e"));
+
+    f->branch(w.op(ICmp::e, f->var(1), w.lit_int_width(32, 0)), a, b, f->var(0_s));
+    a->app(g, {a->var(), w.lit_int_width(32, 3)});
+    b->app(g, {b->var(), w.lit_int_width(32, 5)});
+    g->branch(w.op(ICmp::ul, g->var(1), w.lit_int_width(32, 8)), t, e, g->var(0_s));
+    t->app(f->ret_var(), {t->var(), g->var(1)});
+    e->app(f->ret_var(), {e->var(), w.lit_int_width(32, 0)});
+    f->make_external();
+
+    PassMan man(w);
+    man.add<ValueRange>();
+    man.run();
+
+    // x is in [3, 5] - so x < 8 holds; only c == 0 is left
+    EXPECT_EQ(num_icmps(w), 1);
+}
+
+/// f(mem, ret) { for (i = 0; i < 10; ++i); ret(mem, i) }
+TEST(ValueRange, Loop) {
+    World w;
+    w.set(LogLevel::Error);
+    auto mem = w.type_mem();
+    auto i32 = w.type_int_width(32);
+    auto f    = w.nom_lam(w.cn({mem, w.cn({mem, i32})}), w.dbg("f"));
+    auto head = w.nom_lam(w.cn({mem, i32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(mem), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(mem), w.dbg("exit"));
+
+    f->app(head, {f->var(0_s), w.lit_int_width(32, 0)});
+    auto i = head->var(1);
+    head->branch(w.op(ICmp::ul, i, w.lit_int_width(32, 10)), body, exit, head->var(0_s));
+    body->app(head, {body->var(), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1))});
+    exit->app(f->ret_var(), {exit->var(), i});
+    f->make_external();
+
+    PassMan man(w);
+    man.add<ValueRange>();
+    man.run();
+
+    // i starts at 0 but grows in each iteration - each growth rolls back to head;
+    // widening only drops the interval, so i may still lose each of its 32 known bits one after another
+    EXPECT_GT(man.stats().undos, 0);
+    EXPECT_LE(man.stats().undos, ValueRange::Max_Grow + 1 + 32);
+    // i < 10 must survive - with i = 0 only, it would fold to true
+    EXPECT_EQ(num_icmps(w), 1);
+}
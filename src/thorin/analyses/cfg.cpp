@@ -15,7 +15,7 @@ namespace thorin {
 
 //------------------------------------------------------------------------------
 
-uint64_t CFNode::gid_counter_ = 0;
+std::atomic<uint64_t> CFNode::gid_counter_ = 0;
 
 void CFNode::link(const CFNode* other) const {
     this ->succs_.emplace(other);
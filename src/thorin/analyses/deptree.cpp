@@ -1,61 +1,130 @@
 #include "thorin/analyses/deptree.h"
 
+#include <numeric>
+
 #include "thorin/world.h"
 
 namespace thorin {
 
-static void merge(VarSet& vars, VarSet&& other) {
-    vars.insert(other.begin(), other.end());
-}
-
 void DepTree::run() {
-    for (const auto& [_, nom] : world().externals()) run(nom);
+    std::vector<Def*> externals;
+    for (const auto& [_, nom] : world().externals()) externals.emplace_back(nom);
+
+    parents_.resize(externals.size());
+    std::iota(parents_.begin(), parents_.end(), 0);
+    for (curr_external_ = 0; curr_external_ != externals.size(); ++curr_external_) run(externals[curr_external_]);
     adjust_depth(root_.get(), 0);
+
+    std::vector<size_t> root2component(externals.size(), size_t(-1));
+    for (size_t i = 0, e = externals.size(); i != e; ++i) {
+        auto& c = root2component[find(i)];
+        if (c == size_t(-1)) {
+            c = components_.size();
+            components_.emplace_back();
+        }
+        components_[c].emplace_back(externals[i]);
+    }
+
+    release();
+}
+
+void DepTree::release() {
+    def2vars_ = DefMap<Vars>();
+    vars_.clear();
+    def2external_ = DefMap<size_t>();
+    parents_ = std::vector<size_t>();
 }
 
-VarSet DepTree::run(Def* nom) {
+void DepTree::visit(const Def* def) {
+    auto [i, inserted] = def2external_.emplace(def, curr_external_);
+    if (inserted) return;
+
+    if (auto a = find(i->second), b = find(curr_external_); a != b) parents_[std::max(a, b)] = std::min(a, b);
+}
+
+size_t DepTree::find(size_t i) {
+    while (parents_[i] != i) i = parents_[i] = parents_[parents_[i]];
+    return i;
+}
+
+/// Starts the dependency computation of @p nom unless it has already been visited.
+DepTree::Vars DepTree::enter(Def* nom) {
+    visit(nom);
     auto [i, inserted] = nom2node_.emplace(nom, std::unique_ptr<DepNode>());
     if (!inserted) {
         if (auto vars = def2vars_.lookup(nom))
             return *vars;
         else
-            return {};
+            return vars_.empty(); // nom is still in progress
     }
 
     i->second = std::make_unique<DepNode>(nom, stack_.size() + 1);
     auto node = i->second.get();
     stack_.push_back(node);
+    frames_.emplace_back(Frame{nom, nom, node, 0, vars_.empty()});
+    return nullptr;
+}
 
-    auto result = run(nom, nom);
-    auto parent = root_.get();
-    for (auto var : result) {
-        auto n = nom2node_[var->nom()].get();
-        parent = n->depth() > parent->depth() ? n : parent;
-    }
-    node->set_parent(parent);
+/// Either yields the Var%s @p def depends on right away or pushes a new Frame and yields @c nullptr.
+DepTree::Vars DepTree::enter(Def* curr_nom, const Def* def) {
+    if (def->no_dep())                     return vars_.empty();
+    if (auto nom  = def->isa_nom())        return enter(nom);
+    visit(def);
+    if (auto vars = def2vars_.lookup(def)) return *vars;
+    if (auto var  = def->isa<Var>())       return def2vars_[def] = vars_.intern({var});
 
-    stack_.pop_back();
-    return result;
+    frames_.emplace_back(Frame{curr_nom, def, nullptr, 0, vars_.empty()});
+    return nullptr;
 }
 
-VarSet DepTree::run(Def* curr_nom, const Def* def) {
-    if (def->no_dep())                                      return {};
-    if (auto vars = def2vars_.lookup(def))                  return *vars;
-    if (auto nom  = def->isa_nom(); nom && curr_nom != nom) return run(nom);
+void DepTree::run(Def* root) {
+    if (enter(root) != nullptr) return;
+
+    while (!frames_.empty()) {
+        auto& frame = frames_.back();
+
+        if (auto node = frame.node) {
+            if (frame.i++ == 0) {
+                // the nominal itself - as opposed to the one in enter(Def*, const Def*) - is not subject to the cache
+                auto nom = node->nom();
+                if (nom->no_dep()) {
+                    frame.result = vars_.empty();
+                } else {
+                    frames_.emplace_back(Frame{nom, nom, nullptr, 0, vars_.empty()});
+                }
+                continue;
+            }
+
+            auto parent = root_.get();
+            for (auto var : *frame.result) {
+                auto n = nom2node_[var->nom()].get();
+                parent = n->depth() > parent->depth() ? n : parent;
+            }
+            node->set_parent(parent);
+            stack_.pop_back();
+        } else {
+            auto ops = frame.def->extended_ops();
+            if (frame.i != ops.size()) {
+                if (auto vars = enter(frame.curr_nom, ops[frame.i++]))
+                    frame.result = vars_.merge(frame.result, vars);
+                continue;
+            }
+
+            if (auto var = frame.curr_nom->has_var()) {
+                if (frame.curr_nom == frame.def) frame.result = vars_.erase(frame.result, var);
+            }
+
+            def2vars_[frame.def] = frame.result;
+        }
 
-    VarSet result;
-    if (auto var = def->isa<Var>()) {
-        result.emplace(var);
-    } else {
-        for (auto op : def->extended_ops())
-            merge(result, run(curr_nom, op));
+        // return to caller
+        auto result = frame.result;
+        frames_.pop_back();
+        if (frames_.empty()) break;
 
-        if (auto var = curr_nom->has_var()) {
-            if (curr_nom == def) result.erase(var);
-        }
+        auto& caller = frames_.back();
+        caller.result = caller.node ? result : vars_.merge(caller.result, result);
     }
-
-    return def2vars_[def] = result;
 }
 
 void DepTree::adjust_depth(DepNode* node, size_t depth) {
@@ -4,6 +4,7 @@
 #include <deque>
 
 #include "thorin/def.h"
+#include "thorin/util/interned_set.h"
 
 namespace thorin {
 
@@ -48,18 +49,51 @@ public:
     const DepNode* root() const { return root_.get(); }
     const DepNode* nom2node(Def* nom) const { return nom2node_.find(nom)->second.get(); }
     bool depends(Def* a, Def* b) const; ///< Does @p a depend on @p b?
+    /**
+     * Partitions the World's externals such that two externals end up in the same component iff they share a @em nom.
+     * No rewrite or undo can cross such a component, so each one can be optimized on its own - see PassMan::run_parallel.
+     * Components are sorted by their first external; externals within a component keep their order.
+     */
+    const std::vector<std::vector<Def*>>& components() const { return components_; }
 
 private:
+    /// All Def%s with the same dependencies share these Var%s; only valid during construction - see release.
+    using Vars = InternedSet<const Var*>::Set;
+
+    /// Emulates one activation of the former recursive @c run on @p frames_.
+    struct Frame {
+        Def* curr_nom;
+        const Def* def;
+        DepNode* node;  ///< If set, this Frame computes the dependencies of @c node->nom() and then sets its parent.
+        size_t i;       ///< Next operand of @p def.
+        Vars result;
+    };
+
     void run();
-    VarSet run(Def*);
-    VarSet run(Def*, const Def*);
+    void run(Def*);
+    Vars enter(Def*, const Def*);
+    Vars enter(Def*);
+    /// Records that the current external reaches @p def; if another external has been there first, both end up in the same component.
+    void visit(const Def* def);
+    size_t find(size_t);
+    /// Frees all Vars as well as def2vars_ - we only need nom2node_ once the DepTree is built.
+    void release();
     static void adjust_depth(DepNode* node, size_t depth);
 
     const World& world_;
     std::unique_ptr<DepNode> root_;
     NomMap<std::unique_ptr<DepNode>> nom2node_;
-    DefMap<VarSet> def2vars_;
+    DefMap<Vars> def2vars_;
     std::deque<DepNode*> stack_;
+    std::vector<Frame> frames_;
+    InternedSet<const Var*> vars_;
+    /// @name union-find over the indices of the externals
+    //@{
+    size_t curr_external_ = 0;
+    DefMap<size_t> def2external_; ///< The external on whose behalf a Def has been visited first.
+    std::vector<size_t> parents_;
+    std::vector<std::vector<Def*>> components_;
+    //@}
 };
 
 }
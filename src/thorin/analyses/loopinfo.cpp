@@ -0,0 +1,308 @@
+#include "thorin/analyses/loopinfo.h"
+
+#include "thorin/world.h"
+#include "thorin/util/container.h"
+#include "thorin/analyses/domtree.h"
+
+namespace thorin {
+
+/*
+ * helpers
+ */
+
+/// <tt>a cmp b</tt> iff <tt>b swap(cmp) a</tt>; the bits of an ICmp are <tt>x y g l e</tt> - see tables.h.
+static ICmp swap(ICmp cmp) {
+    auto f = flags_t(cmp);
+    auto bit = [&](int i) { return (f >> i) & 1; };
+    return ICmp(bit(3) << 4 | bit(4) << 3 | bit(1) << 2 | bit(2) << 1 | bit(0));
+}
+
+static ICmp negate(ICmp cmp) { return ICmp(~flags_t(cmp) & 0x1f); }
+static bool is_signed(ICmp cmp) { return cmp == ICmp::sl || cmp == ICmp::sle || cmp == ICmp::sg || cmp == ICmp::sge; }
+static bool is_less(ICmp cmp) { return cmp == ICmp::ul || cmp == ICmp::ule || cmp == ICmp::sl || cmp == ICmp::sle; }
+static bool is_greater(ICmp cmp) { return cmp == ICmp::ug || cmp == ICmp::uge || cmp == ICmp::sg || cmp == ICmp::sge; }
+static bool is_strict(ICmp cmp) { return cmp == ICmp::ul || cmp == ICmp::sl || cmp == ICmp::ug || cmp == ICmp::sg; }
+
+static std::optional<nat_t> isa_width(const Def* type) {
+    if (auto int_ = isa<Tag::Int>(type)) {
+        if (auto mod = isa_lit<nat_t>(int_->arg())) return mod2width(*mod);
+    }
+    return {};
+}
+
+/// How often does <tt>start + k * iv.step cmp bound</tt> hold for <tt>k = 0, 1, ...</tt> before it fails for the first time?
+static std::optional<u64> count(const LoopInfo::IndVar& iv, ICmp cmp, u64 start, u64 bound) {
+    auto mask = iv.mask();
+    auto step = iv.abs_step();
+    start &= mask;
+    bound &= mask;
+
+    if (cmp == ICmp::e) return start == bound ? 1 : 0;
+
+    if (cmp == ICmp::ne) {
+        auto dist = mask & (iv.is_increasing() ? bound - start : start - bound);
+        if (dist % step != 0) return {}; // we'll skip bound and wrap around
+        return dist / step;
+    }
+
+    if (is_signed(cmp)) { // move to unsigned domain
+        auto sign = 1_u64 << (iv.width - 1);
+        start ^= sign;
+        bound ^= sign;
+    }
+
+    if (is_greater(cmp)) { // mirror to increasing domain
+        if (iv.is_increasing()) return {};
+        start = mask & ~start;
+        bound = mask & ~bound;
+    } else if (!is_less(cmp) || !iv.is_increasing()) {
+        return {};
+    }
+
+    // continue while start + k*step < bound or <= bound, respectively
+    u64 k;
+    if (is_strict(cmp)) {
+        if (start >= bound) return 0;
+        auto dist = bound - start;
+        k = dist / step + (dist % step != 0 ? 1 : 0);
+    } else {
+        if (start > bound) return 0;
+        k = (bound - start) / step + 1;
+    }
+
+    auto last = start + (k - 1) * step;
+    if (mask - last < step) return {}; // the next step wraps around
+    return k;
+}
+
+/*
+ * LoopInfo
+ */
+
+LoopInfo::LoopInfo(const F_CFG& cfg)
+    : cfg_(cfg)
+{
+    using Base = LoopTree<true>::Base;
+    using Leaf = LoopTree<true>::Leaf;
+
+    // create Loop%s in pre-order; enclosing holds the Loop%s around the current node
+    std::vector<Loop*> enclosing;
+    std::vector<std::pair<const Base*, size_t>> stack(1, {cfg.looptree().root(), 0}); // (node, number of enclosing Loop%s)
+    while (!stack.empty()) {
+        auto [base, num] = stack.back();
+        stack.pop_back();
+        enclosing.resize(num);
+
+        if (auto leaf = base->isa<Leaf>()) {
+            for (auto loop : enclosing) {
+                loop->cf_nodes_.emplace_back(leaf->cf_node());
+                loop->set_.insert(leaf->cf_node());
+            }
+            continue;
+        }
+
+        auto head = base->as<Head>();
+        if (!head->is_root()) {
+            for (auto loop : enclosing) loop->innermost_ = false;
+
+            if (head->num_cf_nodes() == 1) {
+                if (auto header = head->cf_nodes().front()->nom()->isa<Lam>()) {
+                    auto& loop = loops_.emplace_back(std::make_unique<Loop>(cfg, head, header));
+                    header2loop_[header] = loop.get();
+                    enclosing.emplace_back(loop.get());
+                }
+            }
+        }
+
+        for (size_t i = head->num_children(); i-- != 0;)
+            stack.emplace_back(head->child(i), enclosing.size());
+    }
+
+    for (auto& loop : loops_) analyze(*loop);
+}
+
+const Def* LoopInfo::TripCount::count() const {
+    if (!countable) return nullptr;
+
+    auto& w = iv->var->world();
+    if (lit) return w.lit_int_width(iv->width, *lit);
+
+    auto start = on_next ? w.op(Wrap::add, iv->wmode, w.lit_int_width(iv->width, iv->step), iv->init) : iv->init;
+    auto dist  = iv->is_increasing() ? w.op(Wrap::sub, WMode::none, bound, start)
+                                     : w.op(Wrap::sub, WMode::none, start, bound);
+    if (cmp == ICmp::ne) return dist;
+
+    auto zero = w.lit_int_width(iv->width, 0);
+    if (!is_strict(cmp)) dist = w.op(Wrap::add, WMode::none, w.lit_int_width(iv->width, 1), dist);
+    return w.select(dist, zero, w.op(cmp, start, bound));
+}
+
+const LoopInfo::IndVar* LoopInfo::Loop::ind_var(const Def* var) const {
+    for (const auto& iv : ind_vars_) {
+        if (iv.var == var) return &iv;
+    }
+    return nullptr;
+}
+
+void LoopInfo::analyze(Loop& loop) {
+    auto header = cfg()[loop.header()];
+    for (auto pred : cfg().preds(header)) {
+        if (loop.contains(pred)) {
+            if (auto latch = pred->nom()->isa<Lam>()) {
+                loop.latches_.emplace_back(latch);
+                continue;
+            }
+            return; // weird back edge
+        }
+    }
+
+    find_ind_vars(loop);
+    find_trip_count(loop);
+}
+
+void LoopInfo::find_ind_vars(Loop& loop) {
+    auto header = loop.header();
+
+    // collect the Apps of all predecessors; all of them must directly jump to header
+    std::vector<const App*> entering, back;
+    for (auto pred : cfg().preds(cfg()[header])) {
+        auto lam = pred->nom()->isa<Lam>();
+        auto app = lam && lam->is_set() ? lam->body()->isa<App>() : nullptr;
+        if (app == nullptr || app->callee() != header) return;
+
+        bool is_latch = std::find(loop.latches_.begin(), loop.latches_.end(), lam) != loop.latches_.end();
+        (is_latch ? back : entering).emplace_back(app);
+    }
+    if (entering.empty() || back.empty()) return;
+
+    for (size_t i = 0, e = header->num_vars(); i != e; ++i) {
+        auto var = header->var(i);
+        auto width = isa_width(var->type());
+        if (!width) continue;
+
+        auto init = entering.front()->arg(e, i);
+        auto next = back.front()->arg(e, i);
+        auto same = [&](const std::vector<const App*>& apps, const Def* def) {
+            return std::all_of(apps.begin(), apps.end(), [&](const App* app) { return app->arg(e, i) == def; });
+        };
+        if (!same(entering, init) || !same(back, next)) continue;
+
+        if (auto add = isa<Tag::Wrap>(Wrap::add, next)) {
+            auto [a, b] = add->args<2>();
+            if (b->isa<Lit>()) std::swap(a, b); // literals are usually normalized to the left
+            auto step = isa_lit(a);
+            if (!step || b != var) continue;
+
+            auto wmode = isa_lit<nat_t>(add->decurry()->arg(0));
+            IndVar iv{var, i, init, next, *step, *width, wmode.value_or(WMode::none)};
+            iv.step &= iv.mask();
+            if (iv.step != 0) loop.ind_vars_.emplace_back(iv);
+        }
+    }
+}
+
+bool LoopInfo::is_invariant(const Loop& loop, const Def* def) {
+    auto in_loop = [&](Def* nom) { auto n = cfg()[nom]; return n != nullptr && loop.contains(n); };
+
+    unique_queue<DefSet> queue;
+    queue.push(def);
+    while (!queue.empty()) {
+        auto def = queue.pop();
+        if (auto var = def->isa<Var>()) {
+            if (in_loop(var->nom())) return false;
+        } else if (auto nom = def->isa_nom()) {
+            if (in_loop(nom)) return false;
+        } else {
+            for (auto op : def->ops()) queue.push(op);
+        }
+    }
+
+    return true;
+}
+
+void LoopInfo::find_trip_count(Loop& loop) {
+    if (loop.ind_vars_.empty()) return;
+
+    auto in_loop = [&](const Def* def) {
+        auto lam = def->isa_nom<Lam>();
+        auto n = lam ? cfg()[lam] : nullptr;
+        return n != nullptr && loop.contains(n);
+    };
+
+    // find the one and only exiting Lam
+    Lam* exiting = nullptr;
+    for (auto n : loop.cf_nodes()) {
+        for (auto succ : cfg().succs(n)) {
+            if (!loop.contains(succ)) {
+                if (exiting != nullptr && exiting != n->nom()) return;
+                exiting = n->nom()->isa<Lam>();
+                if (exiting == nullptr) return;
+            }
+        }
+    }
+    if (exiting == nullptr) return;
+
+    // the exit test must be executed exactly once per iteration:
+    // exiting must not be part of a nested loop and must dominate all latches
+    auto n = cfg()[exiting];
+    if (cfg().looptree()[n]->parent() != loop.head()) return;
+    const auto& domtree = cfg().domtree();
+    for (auto latch : loop.latches()) {
+        auto m = cfg()[latch];
+        while (m != n && m != domtree.idom(m)) m = domtree.idom(m);
+        if (m != n) return;
+    }
+
+    // exiting: branch(cond, t, f)
+    auto app = exiting->body()->isa<App>();
+    auto select = app ? app->callee()->isa<Extract>() : nullptr;
+    auto targets = select ? select->tuple()->isa<Tuple>() : nullptr;
+    if (targets == nullptr || targets->num_ops() != 2) return;
+
+    auto [f, t] = targets->ops<2>();
+    if (in_loop(f) == in_loop(t)) return;
+
+    auto cond = isa<Tag::ICmp>(select->index());
+    if (!cond) return;
+
+    auto cmp = cond.flags();
+    auto [test, bound] = cond->args<2>();
+    const IndVar* iv = nullptr;
+    bool on_next = false;
+
+    auto find = [&](const Def* def) {
+        for (const auto& i : loop.ind_vars()) {
+            if (def == i.var || def == i.next) {
+                iv = &i;
+                on_next = def == i.next;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (!find(test)) {
+        if (!find(bound)) return;
+        std::swap(test, bound);
+        cmp = swap(cmp);
+    }
+    if (in_loop(f)) cmp = negate(cmp); // normalize such that t stays in the loop
+    if (!is_invariant(loop, bound)) return;
+
+    TripCount tc{iv, on_next, cmp, bound, false, {}};
+    auto linit  = isa_lit(iv->init);
+    auto lbound = isa_lit(bound);
+    if (linit && lbound) {
+        tc.lit = count(*iv, cmp, on_next ? *linit + iv->step : *linit, *lbound);
+        tc.countable = tc.lit.has_value();
+    } else if (iv->abs_step() == 1) {
+        bool no_wrap = is_signed(cmp) ? (iv->wmode & WMode::nsw) : (iv->wmode & WMode::nuw);
+        bool towards = (iv->is_increasing() && is_less(cmp)) || (!iv->is_increasing() && is_greater(cmp));
+        // otherwise, bound might be the largest/smallest value and we loop forever
+        tc.countable = cmp == ICmp::ne || (towards && (is_strict(cmp) || no_wrap));
+    }
+
+    loop.trip_count_ = tc;
+}
+
+}
@@ -0,0 +1,116 @@
+#ifndef THORIN_ANALYSES_LOOPINFO_H
+#define THORIN_ANALYSES_LOOPINFO_H
+
+#include <optional>
+
+#include "thorin/lam.h"
+#include "thorin/analyses/cfg.h"
+#include "thorin/analyses/looptree.h"
+
+namespace thorin {
+
+/**
+ * Recognizes induction variables and trip counts of the loops in a LoopTree<true>.
+ * Only loops with a single header Lam are considered.
+ * A Var of the header is an affine induction variable if
+ * 1. all entering edges pass the same @p init value and
+ * 2. all back edges pass <tt>var + step</tt> via @p Wrap::add with the same literal @p step.
+ * Hence, in its @c k-th iteration the Var holds <tt>init + k * step</tt> - modulo the width of its type.
+ */
+class LoopInfo {
+public:
+    using Head = LoopTree<true>::Head;
+
+    /// Affine induction variable <tt>var = init + k * step</tt>.
+    struct IndVar {
+        const Def* var;  ///< Var of the header.
+        size_t index;    ///< Index of @p var within the header's vars.
+        const Def* init; ///< Value passed on all entering edges.
+        const Def* next; ///< Value passed on all back edges: <tt>var + step</tt>.
+        u64 step;        ///< Literal step in two's complement of @p width bits.
+        nat_t width;     ///< Number of bits of @p var.
+        nat_t wmode;     ///< WMode of @p next.
+
+        bool is_increasing() const { return (step & (1_u64 << (width - 1))) == 0; }
+        u64 abs_step() const { return is_increasing() ? step : mask() & (~step + 1_u64); }
+        u64 mask() const { return width == 64 ? u64(-1) : (1_u64 << width) - 1_u64; }
+    };
+
+    /**
+     * The Loop is left as soon as <tt>test cmp bound</tt> fails where @p test is either @p iv's Var or its @p next value.
+     * @p count is the number of times the test succeeds before, i.e. how often the exit test stays in the Loop.
+     */
+    struct TripCount {
+        const IndVar* iv;
+        bool on_next;               ///< Does the exit test inspect IndVar::next instead of IndVar::var?
+        ICmp cmp;                   ///< Normalized such that the Loop is continued while <tt>test cmp bound</tt> holds.
+        const Def* bound;           ///< Loop-invariant.
+        bool countable;             ///< Is count able to compute the trip count?
+        std::optional<u64> lit;     ///< Constant trip count if known.
+
+        /// Builds the symbolic trip count or yields @c nullptr if it is not countable.
+        /// Other than the rest of LoopInfo, this creates new Def%s.
+        const Def* count() const;
+    };
+
+    class Loop {
+    public:
+        Loop(const F_CFG& cfg, const Head* head, Lam* header)
+            : head_(head)
+            , header_(header)
+            , set_(cfg)
+        {}
+
+        /// @name getters
+        //@{
+        const Head* head() const { return head_; }
+        Lam* header() const { return header_; }
+        int depth() const { return head_->depth(); }
+        bool is_innermost() const { return innermost_; }
+        ArrayRef<const CFNode*> cf_nodes() const { return cf_nodes_; } ///< All CFNode%s of this Loop including nested ones.
+        bool contains(const CFNode* n) const { return set_[n]; }
+        ArrayRef<Lam*> latches() const { return latches_; }            ///< Sources of the back edges to header().
+        ArrayRef<IndVar> ind_vars() const { return ind_vars_; }
+        const IndVar* ind_var(const Def* var) const;
+        const std::optional<TripCount>& trip_count() const { return trip_count_; }
+        //@}
+
+    private:
+        const Head* head_;
+        Lam* header_;
+        bool innermost_ = true;
+        std::vector<const CFNode*> cf_nodes_;
+        F_CFG::Set set_;
+        std::vector<Lam*> latches_;
+        std::vector<IndVar> ind_vars_;
+        std::optional<TripCount> trip_count_;
+
+        friend class LoopInfo;
+    };
+
+    LoopInfo(const LoopInfo&) = delete;
+    LoopInfo& operator=(LoopInfo) = delete;
+
+    explicit LoopInfo(const F_CFG&);
+
+    const F_CFG& cfg() const { return cfg_; }
+    World& world() const { return cfg().cfa().world(); }
+    /// All analyzed Loop%s in pre-order of the LoopTree - so outer Loop%s come first.
+    ArrayRef<std::unique_ptr<Loop>> loops() const { return loops_; }
+    /// Yields the Loop whose header is @p lam or @c nullptr.
+    const Loop* operator[](Lam* lam) const { auto i = header2loop_.find(lam); return i != header2loop_.end() ? i->second : nullptr; }
+
+private:
+    void analyze(Loop&);
+    void find_ind_vars(Loop&);
+    void find_trip_count(Loop&);
+    bool is_invariant(const Loop&, const Def*);
+
+    const F_CFG& cfg_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    LamMap<Loop*> header2loop_;
+};
+
+}
+
+#endif
@@ -10,13 +10,31 @@
 #include "thorin/analyses/looptree.h"
 #include "thorin/analyses/scope.h"
 #include "thorin/util/container.h"
+#include "thorin/util/thread_pool.h"
 
 namespace thorin {
 
-typedef DefMap<const CFNode*> Def2CFNode;
+/// Rough estimate of how expensive it is to recompute @p def in each iteration of a loop.
+static u32 cost(const Def* def) {
+    if (def->level() != Sort::Term) return 0;
+    if (def->isa<Var>() || def->isa<Tuple>() || def->isa<Pack>() || def->isa<Extract>() || def->isa<Insert>()) return 0;
+    if (isa<Tag::Div>(def) || isa<Tag::ROp>(ROp::div, def) || isa<Tag::ROp>(ROp::rem, def)) return 16;
+    if (isa<Tag::Wrap>(Wrap::mul, def) || isa<Tag::ROp>(def)) return 4;
+    if (def->isa<App>()) return 1;
+    return 0;
+}
 
-//------------------------------------------------------------------------------
+/// Number of registers @p def occupies while it is live.
+static size_t weight(const Def* def) {
+    if (def->level() != Sort::Term || isa<Tag::Mem>(def->type())) return 0;
+    return 1;
+}
 
+/**
+ * Works on dense per-Scope indices:
+ * All Def%s reachable from the set @p cfg_ nominals via bound operands are numbered once in @p defs_.
+ * Afterwards, all analyses operate on flat arrays indexed by these numbers.
+ */
 class Scheduler {
 public:
     Scheduler(const Scope& scope, Schedule& schedule)
@@ -26,59 +44,77 @@ public:
         , looptree_(cfg_.looptree())
         , schedule_(schedule)
     {
-        compute_def2uses();
-        Def2CFNode* def2node = nullptr;
+        number();
+        post_order();
 
         switch (schedule.mode()) {
-            case Schedule::Early: schedule_early(); def2node = &def2early_; break;
-            case Schedule::Late:  schedule_late();  def2node = &def2late_;  break;
-            case Schedule::Smart: schedule_smart(); def2node = &def2smart_; break;
+            case Schedule::Early: schedule_early(); place(early_); break;
+            case Schedule::Late:  schedule_late();  place(late_);  break;
+            case Schedule::Smart:
+                schedule_early();
+                schedule_late();
+                schedule_smart();
+                place(smart_);
+                break;
+            case Schedule::Pressure:
+                schedule_early();
+                schedule_late();
+                schedule_smart();
+                schedule_pressure();
+                place(pressure_);
+                break;
         }
 
-        for (auto&& p : *def2node)
-            schedule[p.second].defs_.push_back(p.first);
-
-        topo_sort(*def2node);
-    }
-
-    void for_all_defs(std::function<void(const Def*)> f) {
-        for (auto&& p : def2uses_) {
-            if (!p.first->isa_nom())
-                f(p.first);
-        }
+        topo_sort();
     }
 
     World& world() const { return scope_.world(); }
-    const Uses& uses(const Def* def) const { return def2uses_.find(def)->second; }
-    void compute_def2uses();
-    void schedule_early() { for_all_defs([&](const Def* def) { schedule_early(def); }); }
-    void schedule_late()  { for_all_defs([&](const Def* def) { schedule_late (def); }); }
-    void schedule_smart() { for_all_defs([&](const Def* def) { schedule_smart(def); }); }
-    const CFNode* schedule_early(const Def*);
-    const CFNode* schedule_late(const Def*);
-    const CFNode* schedule_smart(const Def*);
-    void topo_sort(Def2CFNode&);
 
 private:
+    static constexpr u32 None = u32(-1);
+    /// Below this number of scheduled Def%s, Scheduler::topo_sort doesn't bother to use ThreadPool::global.
+    static constexpr size_t Parallel_Threshold = 4096;
+
+    /// @name adjacency in compressed sparse row format
+    //@{
+    ArrayRef<u32> ops (u32 i) const { return {op_beg_ [i+1] - op_beg_ [i], op_idx_ .data() + op_beg_ [i]}; }
+    ArrayRef<u32> uses(u32 i) const { return {use_beg_[i+1] - use_beg_[i], use_idx_.data() + use_beg_[i]}; }
+    //@}
+
+    void number();
+    void post_order();
+    void schedule_early();
+    void schedule_late();
+    void schedule_smart();
+    void schedule_pressure();
+    void place(const std::vector<const CFNode*>&);
+    void topo_sort();
+    void topo_sort(Schedule::Block&);
+
     const Scope& scope_;
     const F_CFG& cfg_;
     const DomTree& domtree_;
     const LoopTree<true>& looptree_;
-    DefMap<Uses> def2uses_;
-    Def2CFNode def2early_;
-    Def2CFNode def2late_;
-    Def2CFNode def2smart_;
     Schedule& schedule_;
+    DefMap<u32> def2idx_;
+    DefVec defs_;                           ///< Maps an index back to its Def.
+    std::vector<u32> op_beg_, op_idx_;      ///< Bound operands of each Def - without nominals.
+    std::vector<u32> use_beg_, use_idx_;    ///< Users of each Def.
+    std::vector<u32> order_;                ///< Structural Def%s in post-order: operands come before their users.
+    std::vector<const CFNode*> early_, late_, smart_, pressure_;
+    std::vector<u32> def2block_;            ///< Block index of each placed Def or None.
+    std::vector<u32> def2local_;            ///< Position of each placed Def within its Block.
+    std::vector<std::vector<u32>> block2idxs_;
 };
 
-void Scheduler::compute_def2uses() {
+void Scheduler::number() {
     // TODO use some variant of Scope::walk instead
-    std::queue<const Def*> queue;
-    DefSet done;
+    std::vector<std::pair<u32, u32>> edges; // (op, user)
 
     auto enqueue = [&](const Def* def) {
-        if (done.emplace(def).second)
-            queue.push(def);
+        auto [i, ins] = def2idx_.emplace(def, defs_.size());
+        if (ins) defs_.emplace_back(def);
+        return i->second;
     };
 
     for (auto n : cfg_.reverse_post_order()) {
@@ -86,151 +122,332 @@ void Scheduler::compute_def2uses() {
             enqueue(n->nom());
     }
 
-    while (!queue.empty()) {
-        auto def = pop(queue);
+    // defs_ doubles as BFS queue
+    for (size_t i = 0; i != defs_.size(); ++i) {
+        for (auto op : defs_[i]->ops()) {
+            if (scope_.bound(op))
+                edges.emplace_back(enqueue(op), i);
+        }
+    }
+
+    // build both CSR directions via counting sort; edges are already sorted by user
+    size_t n = defs_.size();
+    op_beg_ .assign(n + 1, 0);
+    use_beg_.assign(n + 1, 0);
+    for (auto [op, user] : edges) {
+        ++use_beg_[op + 1];
+        if (!defs_[op]->isa_nom()) ++op_beg_[user + 1];
+    }
+    for (size_t i = 0; i != n; ++i) {
+        op_beg_ [i + 1] += op_beg_ [i];
+        use_beg_[i + 1] += use_beg_[i];
+    }
+
+    op_idx_ .resize(op_beg_ .back());
+    use_idx_.resize(use_beg_.back());
+    std::vector<u32> op_pos(op_beg_.begin(), op_beg_.end() - 1), use_pos(use_beg_.begin(), use_beg_.end() - 1);
+    for (auto [op, user] : edges) {
+        use_idx_[use_pos[op]++] = user;
+        if (!defs_[op]->isa_nom()) op_idx_[op_pos[user]++] = op;
+    }
+}
 
-        for (size_t i = 0, e = def->num_ops(); i != e; ++i) {
-            auto op = def->op(i);
-            if (scope_.bound(op)) {
-                def2uses_[op].emplace(def, i);
-                enqueue(op);
+void Scheduler::post_order() {
+    std::vector<bool> done(defs_.size());
+    std::vector<std::pair<u32, u32>> stack; // (index, next operand)
+    order_.reserve(defs_.size());
+
+    for (u32 root = 0, e = defs_.size(); root != e; ++root) {
+        if (done[root] || defs_[root]->isa_nom()) continue;
+        done[root] = true;
+        stack.emplace_back(root, 0);
+
+        while (!stack.empty()) {
+            auto& [i, next] = stack.back();
+            auto ops = this->ops(i);
+            if (next != ops.size()) {
+                auto op = ops[next++];
+                if (!done[op]) {
+                    done[op] = true;
+                    stack.emplace_back(op, 0);
+                }
+            } else {
+                order_.emplace_back(i);
+                stack.pop_back();
             }
         }
     }
 }
 
-const CFNode* Scheduler::schedule_early(const Def* def) {
-    auto i = def2early_.find(def);
-    if (i != def2early_.end()) return i->second;
-
-    const CFNode* result;
-
-    if (auto nom = def->isa_nom()) {
-        result = cfg_[nom];
-    } else if (auto var = def->isa<Var>()) {
-        result = schedule_early(var->nom());
-    } else {
-        result = cfg_.entry();
-        for (auto op : def->ops()) {
-            if (op->isa_nom()) continue;
-            if (def2uses_.contains(op)) {
-                auto n = schedule_early(op);
+void Scheduler::schedule_early() {
+    early_.assign(defs_.size(), nullptr);
+
+    for (auto i : order_) {
+        auto def = defs_[i];
+        const CFNode* result;
+
+        if (auto var = def->isa<Var>()) {
+            result = cfg_[var->nom()];
+        } else {
+            result = cfg_.entry();
+            for (auto op : ops(i)) {
+                auto n = early_[op];
                 if (domtree_.depth(n) > domtree_.depth(result))
                     result = n;
             }
         }
-    }
 
-    return def2early_[def] = result;
+        early_[i] = result;
+    }
 }
 
-const CFNode* Scheduler::schedule_late(const Def* def) {
-    auto i = def2late_.find(def);
-    if (i != def2late_.end()) return i->second;
-
-    const CFNode* result = nullptr;
-
-    if (auto nom = def->isa_nom()) {
-        result = cfg_[nom];
-    } else if (auto var = def->isa<Var>()) {
-        result = schedule_late(var->nom());
-    } else {
-        for (auto use : uses(def)) {
-            auto n = schedule_late(use);
-            result = result ? domtree_.least_common_ancestor(result, n) : n;
+void Scheduler::schedule_late() {
+    late_.assign(defs_.size(), nullptr);
+
+    for (auto i : reverse_range(order_)) {
+        auto def = defs_[i];
+        const CFNode* result = nullptr;
+
+        if (auto var = def->isa<Var>()) {
+            result = cfg_[var->nom()];
+        } else {
+            for (auto use : uses(i)) {
+                auto user = defs_[use];
+                auto n = user->isa_nom() ? cfg_[user->as_nom()] : late_[use];
+                if (n == nullptr) continue; // nominal without CFNode
+                result = result ? domtree_.least_common_ancestor(result, n) : n;
+            }
         }
-    }
 
-    return def2late_[def] = result;
+        late_[i] = result;
+    }
 }
 
-const CFNode* Scheduler::schedule_smart(const Def* def) {
-    auto i = def2smart_.find(def);
-    if (i != def2smart_.end())
-        return i->second;
+void Scheduler::schedule_smart() {
+    smart_.assign(defs_.size(), nullptr);
 
-    auto early = schedule_early(def);
-    auto late  = schedule_late (def);
-    //world().DLOG("schedule {}: {} -- {}", def, early, late);
-
-    const CFNode* result;
-    //if (def->isa<Enter>() || def->isa<Slot>() || Enter::is_out_mem(def) || Enter::is_out_frame(def)) {
-    if (false) {
-        // Place allocas early for LLVM
-        result = early;
-    } else {
-        result = late;
+    for (auto i : order_) {
+        auto def   = defs_[i];
+        auto early = early_[i];
+        auto late  = late_ [i];
+        //world().DLOG("schedule {}: {} -- {}", def, early, late);
+
+        auto result = late;
         int depth = looptree_[late]->depth();
-        for (auto i = late; i != early;) {
-            auto idom = domtree_.idom(i);
-            assert(i != idom);
-            i = idom;
+        for (auto n = late; n != early;) {
+            auto idom = domtree_.idom(n);
+            assert(n != idom);
+            n = idom;
 
             // HACK this should actually never occur
-            if (i == nullptr) {
+            if (n == nullptr) {
                 world().WLOG("don't know where to put {}", def);
                 result = late;
                 break;
             }
 
-            int curr_depth = looptree_[i]->depth();
+            int curr_depth = looptree_[n]->depth();
             if (curr_depth < depth) {
-                result = i;
+                result = n;
                 depth = curr_depth;
             }
         }
-    }
 
-    return def2smart_[def] = result;
+        smart_[i] = result;
+    }
 }
 
-void Scheduler::topo_sort(Def2CFNode& def2node) {
-    for (auto& block : schedule_.blocks_) {
-        DefVec defs;
-        std::queue<const Def*> queue;
-        DefSet done;
-
-        auto inside = [&](const Def* def) {
-            auto i = def2node.find(def);
-            return i != def2node.end() && i->second == block.node();
-        };
-
-        auto enqueue = [&](const Def* def) {
-            if (!done.contains(def)) {
-                for (auto op : def->ops()) {
-                    if (inside(op) && !done.contains(op))
-                        return;
-                }
+/**
+ * Estimates the number of live registers in each block and hoists like Schedule::Smart as long as this estimate stays within Schedule::budget:
+ * 1. Starting from the Late placement, a Def is live in all blocks on the dominator tree path from its definition down to each of its uses.
+ * 2. Hoisting a Def out of a loop keeps it live throughout all blocks of this loop - we only do so if each of them still has room.
+ *    Expensive Def%s go first; cheap ones that don't fit anymore are recomputed within the loop.
+ * 3. We place users before their operands so an operand always ends up above all of its actual users.
+ */
+void Scheduler::schedule_pressure() {
+    using Base = LoopTree<true>::Base;
+    using Head = LoopTree<true>::Head;
+    using Leaf = LoopTree<true>::Leaf;
+
+    // number the loops and collect the blocks of each of them
+    size_t num_blocks = schedule_.blocks_.size();
+    std::vector<const Head*> loops;
+    std::vector<std::vector<u32>> loop2blocks;
+    std::vector<std::vector<u32>> block2loops(num_blocks); // innermost loop first
+    std::vector<u32> stack;
+    auto number = [&](auto number, const Base* base) -> void {
+        if (auto head = base->isa<Head>()) {
+            if (!head->is_root()) {
+                stack.emplace_back(loops.size());
+                loops.emplace_back(head);
+                loop2blocks.emplace_back();
+            }
+            for (const auto& child : head->children()) number(number, child.get());
+            if (!head->is_root()) stack.pop_back();
+        } else {
+            auto b = schedule_.indices_[base->as<Leaf>()->cf_node()];
+            block2loops[b].assign(stack.rbegin(), stack.rend());
+            for (auto l : stack) loop2blocks[l].emplace_back(b);
+        }
+    };
+    number(number, looptree_.root());
+
+    // visits each block where i is live - as of the Late placement
+    std::vector<size_t> live(num_blocks), stamp(num_blocks, size_t(-1));
+    auto live_blocks = [&](u32 i, auto f) {
+        auto def = late_[i];
+        for (auto use : uses(i)) {
+            auto user = defs_[use];
+            for (auto n = user->isa_nom() ? cfg_[user->as_nom()] : late_[use]; n != nullptr; n = domtree_.idom(n)) {
+                auto b = schedule_.indices_[n];
+                if (stamp[b] == i) break;
+                stamp[b] = i;
+                f(b);
+                if (n == def) break;
+            }
+        }
+    };
+
+    std::vector<int> limit(defs_.size()); // shallowest loop depth each Def may be hoisted to
+    std::vector<u32> candidates;
+
+    for (auto i : order_) {
+        if (late_[i] == nullptr) continue;
+        limit[i] = looptree_[late_[i]]->depth();
+        if (auto w = weight(defs_[i])) live_blocks(i, [&](u32 b) { live[b] += w; });
+        if (cost(defs_[i]) != 0 && looptree_[smart_[i]]->depth() < limit[i]) candidates.emplace_back(i);
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [&](u32 i, u32 j) { return cost(defs_[i]) > cost(defs_[j]); });
+
+    for (auto i : candidates) {
+        std::fill(stamp.begin(), stamp.end(), size_t(-1));
+        live_blocks(i, [](u32) {});
 
-                queue.push(def);
-                done.emplace(def);
-                defs.push_back(def);
+        auto w = weight(defs_[i]);
+        int depth = looptree_[smart_[i]]->depth();
+        // leave loops from the inside out - each block of the loop must have room for i
+        for (auto l : block2loops[schedule_.indices_[late_[i]]]) {
+            if (loops[l]->depth() < depth) break;
+
+            const auto& blocks = loop2blocks[l];
+            if (std::any_of(blocks.begin(), blocks.end(), [&](u32 b) { return stamp[b] != i && live[b] + w > schedule_.budget(); })) break;
+
+            for (auto b : blocks) {
+                if (stamp[b] != i) {
+                    stamp[b] = i;
+                    live[b] += w;
+                }
             }
-        };
+            limit[i] = loops[l]->depth();
+        }
+    }
 
-        for (auto def : block)
-            enqueue(def);
+    pressure_.assign(defs_.size(), nullptr);
 
-        while (!queue.empty()) {
-            auto def = pop(queue);
+    for (auto i : reverse_range(order_)) {
+        auto def = defs_[i];
+        const CFNode* late = nullptr;
 
-            for (auto use : uses(def)) {
-                if (inside(use)) enqueue(use);
+        if (auto var = def->isa<Var>()) {
+            late = cfg_[var->nom()];
+        } else {
+            for (auto use : uses(i)) {
+                auto user = defs_[use];
+                auto n = user->isa_nom() ? cfg_[user->as_nom()] : pressure_[use];
+                if (n == nullptr) continue;
+                late = late ? domtree_.least_common_ancestor(late, n) : n;
             }
         }
 
-        assert(block.defs_.size() == defs.size());
-        swap(block.defs_, defs);
+        auto result = late;
+        if (late != nullptr && !def->isa<Var>()) {
+            int depth = looptree_[late]->depth();
+            for (auto n = late; n != early_[i];) {
+                n = domtree_.idom(n);
+
+                // HACK this should actually never occur
+                if (n == nullptr) {
+                    world().WLOG("don't know where to put {}", def);
+                    result = late;
+                    break;
+                }
+
+                int curr_depth = looptree_[n]->depth();
+                if (curr_depth < depth && curr_depth >= limit[i]) {
+                    result = n;
+                    depth = curr_depth;
+                }
+            }
+        }
+
+        pressure_[i] = result;
     }
 }
 
+void Scheduler::place(const std::vector<const CFNode*>& def2node) {
+    def2block_.assign(defs_.size(), None);
+    def2local_.assign(defs_.size(), None);
+    block2idxs_.resize(schedule_.blocks_.size());
+
+    // visit in index order to get a deterministic initial order within each block
+    for (u32 i = 0, e = defs_.size(); i != e; ++i) {
+        if (auto n = def2node[i]) {
+            auto b = schedule_.indices_[n];
+            def2block_[i] = b;
+            def2local_[i] = block2idxs_[b].size();
+            block2idxs_[b].emplace_back(i);
+        }
+    }
+}
+
+void Scheduler::topo_sort() {
+    auto& blocks = schedule_.blocks_;
+
+    // each block only touches the entries of its own Def%s - so blocks can be sorted independently
+    if (auto pool = ThreadPool::global(); pool && order_.size() >= Parallel_Threshold)
+        pool->parallel_for(blocks.size(), [&](size_t b) { topo_sort(blocks[b]); });
+    else
+        for (auto& block : blocks) topo_sort(block);
+}
+
+void Scheduler::topo_sort(Schedule::Block& block) {
+    auto b = block.index();
+    auto& idxs = block2idxs_[b];
+
+    // in-degree = number of operands that must be scheduled before in this block
+    std::vector<u32> in_degree, queue;
+    in_degree.reserve(idxs.size());
+    queue.reserve(idxs.size());
+    for (u32 l = 0, e = idxs.size(); l != e; ++l) {
+        u32 n = 0;
+        for (auto op : ops(idxs[l])) n += def2block_[op] == b;
+        in_degree.emplace_back(n);
+        if (n == 0) queue.emplace_back(l);
+    }
+
+    for (size_t head = 0; head != queue.size(); ++head) {
+        for (auto use : uses(idxs[queue[head]])) {
+            if (def2block_[use] != b) continue;
+            // a user occurs once per operand in uses - so we decrement once per edge
+            auto l = def2local_[use];
+            if (--in_degree[l] == 0) queue.emplace_back(l);
+        }
+    }
+
+    assert(queue.size() == idxs.size());
+    block.defs_.reserve(idxs.size());
+    for (auto l : queue) block.defs_.emplace_back(defs_[idxs[l]]);
+}
+
 //------------------------------------------------------------------------------
 
-Schedule::Schedule(const Scope& scope, Mode mode)
+Schedule::Schedule(const Scope& scope, Mode mode, size_t budget)
     : scope_(scope)
     , indices_(cfg())
     , blocks_(cfa().size())
     , mode_(mode)
+    , budget_(budget)
 {
     block_schedule();
     Scheduler(scope, *this);
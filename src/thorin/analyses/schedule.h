@@ -8,7 +8,15 @@ namespace thorin {
 
 class Schedule : public Streamable<Schedule> {
 public:
-    enum Mode { Early, Late, Smart };
+    enum Mode {
+        Early,      ///< Place each Def in the first block where all of its operands are available.
+        Late,       ///< Place each Def in the last block that dominates all of its uses.
+        Smart,      ///< Hoist each Def between Early and Late placement to the shallowest loop depth.
+        Pressure,   ///< Like Smart, but only hoist as long as the estimated number of live values in each block stays within Schedule::budget.
+    };
+
+    /// Default for Schedule::budget - roughly the number of general purpose registers of common targets.
+    static constexpr size_t Default_Budget = 16;
 
     class Block {
     public:
@@ -47,10 +55,13 @@ public:
         , indices_(std::move(other.indices_))
         , blocks_(std::move(other.blocks_))
         , mode_(std::move(other.mode_))
+        , budget_(std::move(other.budget_))
     {}
-    Schedule(const Scope&, Mode = Smart);
+    Schedule(const Scope&, Mode = Smart, size_t budget = Default_Budget);
 
     Mode mode() const { return mode_; }
+    /// Register-pressure budget per block; only used in Mode Pressure.
+    size_t budget() const { return budget_; }
     const Scope& scope() const { return scope_; }
     Def* entry() const { return scope().entry(); }
     Def* exit()  const { return scope().exit(); }
@@ -75,11 +86,14 @@ private:
     F_CFG::Map<size_t> indices_;
     Array<Block> blocks_;
     Mode mode_;
+    size_t budget_;
 
     friend class Scheduler;
 };
 
-inline Schedule schedule(const Scope& scope, Schedule::Mode mode = Schedule::Smart) { return Schedule(scope, mode); }
+inline Schedule schedule(const Scope& scope, Schedule::Mode mode = Schedule::Smart, size_t budget = Schedule::Default_Budget) {
+    return Schedule(scope, mode, budget);
+}
 
 }
 
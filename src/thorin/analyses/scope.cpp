@@ -20,6 +20,15 @@ Scope::Scope(Def* entry)
     run();
 }
 
+Scope::Scope(const ScopeTree& tree, Def* entry)
+    : world_(entry->world())
+    , entry_(entry)
+    , exit_(world().nom_lam(world().cn(world().bot_kind()), world_.dbg("exit")))
+    , node_(tree[entry])
+{
+    if (node_ == nullptr) run();
+}
+
 Scope::~Scope() {}
 
 void Scope::run() {
@@ -37,6 +46,11 @@ void Scope::calc_bound() const {
     if (has_bound_) return;
     has_bound_ = true;
 
+    if (node_) {
+        node_->for_each_bound([&](const Def* def) { bound_.emplace(def); });
+        return;
+    }
+
     DefSet live;
     unique_queue<DefSet&> queue(live);
 
@@ -2,6 +2,7 @@
 #define THORIN_ANALYSES_SCOPE_H
 
 #include "thorin/def.h"
+#include "thorin/analyses/scopetree.h"
 #include "thorin/util/stream.h"
 
 namespace thorin {
@@ -23,6 +24,8 @@ public:
     Scope& operator=(Scope) = delete;
 
     explicit Scope(Def* entry);
+    /// Uses the precomputed results of @p tree as view - if @p entry is part of @p tree.
+    Scope(const ScopeTree& tree, Def* entry);
     ~Scope();
 
     /// @name getters
@@ -35,11 +38,11 @@ public:
 
     /// @name Def%s bound/free in this Scope
     //@{
-    bool bound(const Def* def) const { return bound().contains(def); }
+    bool bound(const Def* def) const { return node_ ? node_->bound(def) : bound().contains(def); }
     const DefSet& bound()     const { calc_bound(); return bound_;     } ///< All @p Def%s within this @p Scope.
-    const DefSet& free_defs() const { calc_bound(); return free_defs_; } ///< All @em non-const @p Def%s @em directly referenced but @em not @p bound within this @p Scope. May also include @p Var%s or @em noms.
-    const VarSet& free_vars() const { calc_free (); return free_vars_; } ///< All @p Var%s that occurr free in this @p Scope. Does @em not transitively contain any free @p Var%s from @p noms.
-    const NomSet& free_noms() const { calc_free (); return free_noms_; } ///< All @em noms that occurr free in this @p Scope.
+    const DefSet& free_defs() const { if (node_) return node_->free_defs(); calc_bound(); return free_defs_; } ///< All @em non-const @p Def%s @em directly referenced but @em not @p bound within this @p Scope. May also include @p Var%s or @em noms.
+    const VarSet& free_vars() const { if (node_) return node_->free_vars(); calc_free (); return free_vars_; } ///< All @p Var%s that occurr free in this @p Scope. Does @em not transitively contain any free @p Var%s from @p noms.
+    const NomSet& free_noms() const { if (node_) return node_->free_noms(); calc_free (); return free_noms_; } ///< All @em noms that occurr free in this @p Scope.
     //@}
 
     /// @name simple CFA to construct a CFG
@@ -59,6 +62,7 @@ private:
     World& world_;
     Def* entry_ = nullptr;
     Def* exit_  = nullptr;
+    const ScopeTree::Node* node_ = nullptr;
     mutable bool has_bound_ = false;
     mutable bool has_free_  = false;
     mutable DefSet bound_;
@@ -0,0 +1,313 @@
+#include "thorin/analyses/scopetree.h"
+
+#include <algorithm>
+
+#include "thorin/world.h"
+#include "thorin/util/container.h"
+
+namespace thorin {
+
+ScopeTree::ScopeTree(const World& world)
+    : world_(world)
+    , root_(std::make_unique<Node>(nullptr, nullptr))
+{
+    summarize();
+    solve();
+    nest();
+    release();
+    sweep();
+}
+
+/*
+ * sets
+ */
+
+void ScopeTree::release() {
+    def2refs_  = DefMap<Set>();
+    nom2local_ = NomMap<Set>();
+    nom2free_  = NomMap<Set>();
+    sets_.clear();
+}
+
+/*
+ * phases
+ */
+
+void ScopeTree::summarize() {
+    NomSet done;
+    auto discover = [&](Def* nom) {
+        if (done.emplace(nom).second) noms_.emplace_back(nom);
+    };
+
+    for (const auto& [_, nom] : world().externals()) discover(nom);
+
+    auto refs = [&](const Def* def) -> Set {
+        if (def->no_dep()) return sets_.empty();
+        if (def->isa_nom() || def->isa<Var>()) return sets_.intern({def});
+        return def2refs_.find(def)->second;
+    };
+
+    std::vector<std::pair<const Def*, size_t>> stack; // (def, next extended op)
+    auto push = [&](const Def* def) {
+        if (def->no_dep() || def->isa_nom() || def->isa<Var>() || !def2refs_.emplace(def, nullptr).second) return;
+        stack.emplace_back(def, 0);
+    };
+
+    // noms_ grows while we iterate
+    for (size_t n = 0; n != noms_.size(); ++n) {
+        auto nom = noms_[n];
+        auto local = sets_.empty();
+
+        for (auto op : nom->extended_ops()) {
+            push(op);
+
+            while (!stack.empty()) {
+                auto& [def, i] = stack.back();
+                auto ops = def->extended_ops();
+                if (i != ops.size()) {
+                    push(ops[i++]);
+                    continue;
+                }
+
+                auto result = sets_.empty();
+                for (auto op : ops) result = sets_.merge(result, refs(op));
+                def2refs_[def] = result;
+                stack.pop_back();
+            }
+
+            local = sets_.merge(local, refs(op));
+        }
+
+        nom2local_[nom] = local;
+        for (auto ref : *local)
+            discover(ref->isa<Var>() ? ref->as<Var>()->nom() : ref->as_nom());
+    }
+}
+
+/*
+ * The free Var%s of a nom are the Var%s it references plus the free Var%s of all noms it references.
+ * Referencing a Var implies referencing its nom.
+ * Finally, a nom is not free within itself.
+ * Since noms may be mutually recursive, we iterate until a fixed point is reached.
+ */
+void ScopeTree::solve() {
+    NomMap<std::vector<Def*>> users;
+    for (auto nom : noms_) {
+        nom2free_[nom] = sets_.empty();
+        for (auto ref : *nom2local_[nom]) {
+            auto callee = ref->isa<Var>() ? ref->as<Var>()->nom() : ref->as_nom();
+            users[callee].emplace_back(nom);
+        }
+    }
+
+    // nested noms are usually discovered late - so start from the back
+    std::queue<Def*> queue;
+    NomSet queued;
+    for (auto nom : reverse_range(noms_)) {
+        queue.push(nom);
+        queued.emplace(nom);
+    }
+
+    while (!queue.empty()) {
+        auto nom = pop(queue);
+        queued.erase(nom);
+
+        auto result = sets_.empty();
+        for (auto ref : *nom2local_[nom]) {
+            if (auto var = ref->isa<Var>()) {
+                result = sets_.merge(result, sets_.intern({var}));
+                result = sets_.merge(result, nom2free_[var->nom()]);
+            } else {
+                result = sets_.merge(result, nom2free_[ref->as_nom()]);
+            }
+        }
+        if (auto var = nom->has_var()) result = sets_.erase(result, var);
+
+        if (result != nom2free_[nom]) {
+            nom2free_[nom] = result;
+            for (auto user : users[nom]) {
+                if (queued.emplace(user).second) queue.push(user);
+            }
+        }
+    }
+}
+
+/*
+ * Free Var%s are transitively closed: If X's Var is free in nom, so are all free Var%s of X (except nom's own Var).
+ * Thus, the nom with the most free Var%s among those nom's free Var%s belong to is the innermost one.
+ */
+void ScopeTree::nest() {
+    for (auto nom : noms_)
+        nom2node_[nom] = std::make_unique<Node>(nom, nullptr);
+
+    for (auto nom : noms_) {
+        auto node = nom2node_[nom].get();
+        auto size = nom2free_[nom]->size();
+        Node* parent = root_.get();
+        size_t parent_size = 0;
+
+        for (auto var : *nom2free_[nom]) {
+            auto outer = var->as<Var>()->nom();
+            auto outer_size = nom2free_[outer]->size();
+            // outer_size < size guarantees a proper tree even for ill-formed nestings
+            if (outer_size < size && (parent == root_.get() || outer_size > parent_size)) {
+                parent = nom2node_[outer].get();
+                parent_size = outer_size;
+            }
+        }
+
+        node->parent_ = parent;
+        parent->children_.emplace_back(node);
+    }
+
+    // assign depths and pre-order intervals
+    size_t i = 0;
+    std::vector<std::pair<Node*, size_t>> stack; // (node, next child)
+    root_->tree_ = this;
+    root_->begin_ = i++;
+    stack.emplace_back(root_.get(), 0);
+
+    while (!stack.empty()) {
+        auto& [node, c] = stack.back();
+        if (c != node->children_.size()) {
+            auto child = node->children_[c++];
+            child->tree_ = this;
+            child->depth_ = node->depth_ + 1;
+            child->begin_ = i++;
+            stack.emplace_back(child, 0);
+        } else {
+            node->end_ = i;
+            stack.pop_back();
+        }
+    }
+}
+
+const ScopeTree::Node* ScopeTree::owner(const Def* def) const {
+    if (auto nom = def->isa_nom()) {
+        auto n = (*this)[nom];
+        return n ? n->parent() : root();
+    }
+
+    if (auto n = def2owner_.lookup(def)) return *n;
+    return root();
+}
+
+void ScopeTree::sweep() {
+    auto root = root_.get();
+
+    // innermost Node whose Scope binds def as far as known - so far
+    auto contribution = [&](const Def* def) -> Node* {
+        if (def->no_dep()) return root;
+        if (auto nom = def->isa_nom()) {
+            auto i = nom2node_.find(nom);
+            return i != nom2node_.end() ? i->second->parent_ : root;
+        }
+        if (auto var = def->isa<Var>()) {
+            auto i = nom2node_.find(var->nom());
+            auto n = i != nom2node_.end() ? i->second.get() : root;
+            if (n != root && def2owner_.emplace(var, n).second) n->defs_.emplace_back(var);
+            return n;
+        }
+        return def2owner_.find(def)->second;
+    };
+
+    // visit in pre-order for a deterministic order of Node::defs_
+    std::vector<std::pair<const Def*, size_t>> stack; // (def, next extended op)
+    std::vector<Node*> nodes(root->children_.rbegin(), root->children_.rend());
+
+    while (!nodes.empty()) {
+        auto node = nodes.back();
+        nodes.pop_back();
+        nodes.insert(nodes.end(), node->children_.rbegin(), node->children_.rend());
+
+        auto push = [&](const Def* def) {
+            if (def->no_dep() || def->isa_nom() || def->isa<Var>() || def2owner_.contains(def)) return;
+            def2owner_[def] = nullptr; // mark as visited
+            stack.emplace_back(def, 0);
+        };
+
+        for (auto op : node->nom()->extended_ops()) {
+            push(op);
+
+            while (!stack.empty()) {
+                auto& [def, i] = stack.back();
+                auto ops = def->extended_ops();
+                if (i != ops.size()) {
+                    push(ops[i++]);
+                    continue;
+                }
+
+                Node* owner = root;
+                for (auto op : ops) {
+                    auto n = contribution(op);
+                    if (n->depth_ > owner->depth_) owner = n;
+                }
+
+                def2owner_[def] = owner;
+                if (owner != root) owner->defs_.emplace_back(def);
+                stack.pop_back();
+            }
+
+            contribution(op); // register Var
+        }
+    }
+}
+
+bool ScopeTree::Node::bound(const Def* def) const {
+    if (def->no_dep()) return false;
+    if (auto nom = def->isa_nom()) {
+        auto n = (*tree_)[nom];
+        return n != nullptr && n != this && contains(n);
+    }
+    return contains(tree_->owner(def));
+}
+
+const DefSet& ScopeTree::Node::free_defs() const {
+    if (has_free_defs_) return free_defs_;
+    has_free_defs_ = true;
+
+    auto enqueue = [&](const Def* def) {
+        if (!def->no_dep() && !bound(def)) free_defs_.emplace(def);
+    };
+
+    for (auto op : nom()->extended_ops()) enqueue(op);
+
+    for (auto def : defs_) {
+        for (auto op : def->extended_ops()) enqueue(op);
+    }
+
+    // whatever is free in a child is either bound here or free here as well
+    for (auto child : children_) {
+        for (auto def : child->free_defs()) enqueue(def);
+    }
+
+    return free_defs_;
+}
+
+void ScopeTree::Node::calc_free() const {
+    if (has_free_) return;
+    has_free_ = true;
+
+    unique_queue<DefSet> queue;
+
+    auto enqueue = [&](const Def* def) {
+        if (def->no_dep()) return;
+
+        if (auto var = def->isa<Var>())
+            free_vars_.emplace(var);
+        else if (auto nom = def->isa_nom())
+            free_noms_.emplace(nom);
+        else
+            queue.push(def);
+    };
+
+    for (auto free : free_defs())
+        enqueue(free);
+
+    while (!queue.empty()) {
+        for (auto op : queue.pop()->extended_ops())
+            enqueue(op);
+    }
+}
+
+}
@@ -0,0 +1,118 @@
+#ifndef THORIN_ANALYSES_SCOPETREE_H
+#define THORIN_ANALYSES_SCOPETREE_H
+
+#include "thorin/def.h"
+#include "thorin/util/interned_set.h"
+
+namespace thorin {
+
+/**
+ * Computes the Scope%s of @em all @em noms reachable from the World's externals at once.
+ * 1. Each reachable Def is summarized once by the Var%s and @em noms it transitively references.
+ * 2. A fixed point over the @em noms yields the free Var%s of each @em nom; the innermost one of these is its parent.
+ * 3. A single sweep over all reachable Def%s assigns each Def to its @em owner:
+ *    the innermost @em nom whose Var the Def transitively uses.
+ * Hence, a Def is bound in the Scope of @p nom iff its owner is @p nom or nested within @p nom.
+ * This is linear in the number of reachable Def%s in practice - instead of the sum of all Scope sizes.
+ */
+class ScopeTree {
+public:
+    class Node {
+    public:
+        Node(const Node&) = delete;
+        Node& operator=(Node) = delete;
+
+        Node(Def* nom, Node* parent)
+            : nom_(nom)
+            , parent_(parent)
+        {}
+
+        /// @name getters
+        //@{
+        Def* nom() const { return nom_; }
+        const Node* parent() const { return parent_; }
+        ArrayRef<Node*> children() const { return children_; }
+        size_t depth() const { return depth_; }
+        //@}
+
+        /// @name views on the Scope of nom()
+        //@{
+        bool contains(const Node* n) const { return begin_ <= n->begin_ && n->end_ <= end_; } ///< Is @p n nested within or equal to @c this?
+        bool bound(const Def* def) const;                                                      ///< Same as Scope::bound.
+        ArrayRef<const Def*> defs() const { return defs_; } ///< Structural Def%s and Var%s bound here but @em not in any child.
+        const DefSet& free_defs() const;                    ///< Same as Scope::free_defs.
+        const VarSet& free_vars() const { calc_free(); return free_vars_; } ///< Same as Scope::free_vars.
+        const NomSet& free_noms() const { calc_free(); return free_noms_; } ///< Same as Scope::free_noms.
+        template<class F> void for_each_bound(F f) const;   ///< Invokes @p f for each Def in Scope::bound.
+        //@}
+
+    private:
+        void calc_free() const;
+
+        Def* nom_;
+        Node* parent_;
+        std::vector<Node*> children_;
+        DefVec defs_;
+        size_t depth_ = 0;
+        size_t begin_ = 0, end_ = 0; ///< Pre-order interval of this subtree.
+        const ScopeTree* tree_ = nullptr;
+        mutable bool has_free_defs_ = false;
+        mutable bool has_free_ = false;
+        mutable DefSet free_defs_;
+        mutable VarSet free_vars_;
+        mutable NomSet free_noms_;
+
+        friend class ScopeTree;
+    };
+
+    ScopeTree(const ScopeTree&) = delete;
+    ScopeTree& operator=(ScopeTree) = delete;
+
+    explicit ScopeTree(const World&);
+
+    const World& world() const { return world_; }
+    const Node* root() const { return root_.get(); }
+    /// Yields @c nullptr if @p nom is not reachable from the World's externals.
+    const Node* operator[](Def* nom) const { auto i = nom2node_.find(nom); return i != nom2node_.end() ? i->second.get() : nullptr; }
+    /// Innermost Node whose Scope binds @p def or root() if @p def is not bound anywhere.
+    const Node* owner(const Def* def) const;
+
+private:
+    /// Only valid during construction - see release.
+    using Set = InternedSet<const Def*>::Set;
+
+    void summarize();
+    void solve();
+    void nest();
+    void sweep();
+    /// Frees all Set%s - only nest needs them.
+    void release();
+
+    const World& world_;
+    std::unique_ptr<Node> root_;
+    NomMap<std::unique_ptr<Node>> nom2node_;
+    DefMap<Node*> def2owner_;
+    InternedSet<const Def*> sets_;
+    DefMap<Set> def2refs_;      ///< Var%s and @em noms referenced by a structural Def - without entering @em noms.
+    NomMap<Set> nom2local_;     ///< Var%s and @em noms referenced by a @em nom's extended_ops - without entering @em noms.
+    NomMap<Set> nom2free_;      ///< Free Var%s of each reachable @em nom.
+    std::vector<Def*> noms_;    ///< All reachable @em noms in discovery order.
+};
+
+template<class F>
+void ScopeTree::Node::for_each_bound(F f) const {
+    std::vector<const Node*> stack(children_.begin(), children_.end());
+    for (auto def : defs_) f(def);
+
+    while (!stack.empty()) {
+        auto n = stack.back();
+        stack.pop_back();
+        f(n->nom());
+        for (auto def : n->defs_) f(def);
+        stack.insert(stack.end(), n->children_.begin(), n->children_.end());
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "thorin/apply_cache.h"
+
+#include <algorithm>
+
+namespace thorin {
+
+const DefArray* ApplyCache::lookup(Def* nom, const Def* arg) {
+    ++stats_.lookups;
+    auto i = key2entry_.find({nom, arg});
+    if (i == key2entry_.end()) return nullptr;
+
+    ++stats_.hits;
+    auto entry = i->second;
+    lru_.splice(lru_.begin(), lru_, entry);
+    return &entry->ops;
+}
+
+void ApplyCache::insert(Def* nom, const Def* arg, DefArray ops, ArrayRef<Def*> noms) {
+    if (capacity_ == 0) return;
+
+    DefDef key{nom, arg};
+    if (auto i = key2entry_.find(key); i != key2entry_.end()) erase(i->second);
+    while (size() >= capacity_) {
+        ++stats_.evictions;
+        erase(std::prev(lru_.end()));
+    }
+
+    std::vector<Def*> deps;
+    deps.reserve(noms.size() + 1);
+    deps.emplace_back(nom);
+    NomSet done;
+    done.emplace(nom);
+    for (auto n : noms) {
+        if (done.emplace(n).second) deps.emplace_back(n);
+    }
+
+    // list node + map slot + one index slot per nom
+    size_t bytes = sizeof(Entry) + 2 * sizeof(void*) + ops.size() * sizeof(const Def*)
+                 + sizeof(DefDef) + sizeof(Iter) + deps.size() * (sizeof(Def*) + sizeof(DefDef));
+
+    for (auto n : deps) nom2keys_[n].emplace(key);
+    lru_.push_front({key, std::move(ops), std::move(deps), bytes});
+    key2entry_[key] = lru_.begin();
+
+    ++stats_.inserts;
+    stats_.bytes += bytes;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.bytes);
+}
+
+void ApplyCache::erase(Iter entry) {
+    for (auto n : entry->noms) {
+        auto i = nom2keys_.find(n);
+        i->second.erase(entry->key);
+        if (i->second.empty()) nom2keys_.erase(i);
+    }
+
+    stats_.bytes -= entry->bytes;
+    key2entry_.erase(entry->key);
+    lru_.erase(entry);
+}
+
+void ApplyCache::invalidate(Def* nom) {
+    auto i = nom2keys_.find(nom);
+    if (i == nom2keys_.end()) return;
+
+    std::vector<DefDef> keys(i->second.begin(), i->second.end());
+    for (const auto& key : keys) {
+        ++stats_.invalidations;
+        erase(key2entry_.find(key)->second);
+    }
+}
+
+void ApplyCache::set_capacity(size_t capacity) {
+    capacity_ = capacity;
+    while (size() > capacity_) {
+        ++stats_.evictions;
+        erase(std::prev(lru_.end()));
+    }
+}
+
+void ApplyCache::clear() {
+    lru_.clear();
+    key2entry_.clear();
+    nom2keys_.clear();
+    stats_.bytes = 0;
+}
+
+Stream& ApplyCache::stream(Stream& s) const {
+    return s.fmt("apply cache: {}/{} entries, {} lookups, {} hits ({}%), {} evictions, {} invalidations, {} bytes ({} peak)",
+                 size(), capacity(), stats_.lookups, stats_.hits, size_t(stats_.hit_rate() * 100.),
+                 stats_.evictions, stats_.invalidations, stats_.bytes, stats_.peak_bytes);
+}
+
+}
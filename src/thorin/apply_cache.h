@@ -0,0 +1,84 @@
+#ifndef THORIN_APPLY_CACHE_H
+#define THORIN_APPLY_CACHE_H
+
+#include <list>
+
+#include "thorin/def.h"
+
+namespace thorin {
+
+/**
+ * Memoizes the results of Def::apply.
+ * The cache holds at most @p capacity() entries and evicts the least recently used one when full.
+ * Each entry is indexed by all @em noms it has been instantiated from - i.e. the applied @em nom itself and all nested @em noms that the instantiation copied.
+ * Whenever one of these @em noms is modified via Def::set or Def::unset, all dependent entries are dropped.
+ */
+class ApplyCache : public Streamable<ApplyCache> {
+public:
+    static constexpr size_t Default_Capacity = 1 << 16;
+
+    struct Stats {
+        size_t lookups       = 0;
+        size_t hits          = 0;
+        size_t inserts       = 0;
+        size_t evictions     = 0; ///< Entries dropped due to the @p capacity().
+        size_t invalidations = 0; ///< Entries dropped because one of their @em noms has been modified.
+        size_t bytes         = 0; ///< Current (approximate) memory footprint.
+        size_t peak_bytes    = 0;
+
+        double hit_rate() const { return lookups == 0 ? 0. : double(hits) / double(lookups); }
+    };
+
+    ApplyCache(size_t capacity = Default_Capacity)
+        : capacity_(capacity)
+    {}
+
+    /// @name getters
+    //@{
+    size_t size() const { return lru_.size(); }
+    bool empty() const { return lru_.empty(); }
+    size_t capacity() const { return capacity_; }
+    const Stats& stats() const { return stats_; }
+    //@}
+
+    /// @name lookup/insert
+    //@{
+    /// Yields the cached result of applying @p nom to @p arg or @c nullptr and marks the entry as recently used.
+    /// The result is only valid until the next modification of the cache.
+    const DefArray* lookup(Def* nom, const Def* arg);
+    /// Caches @p ops as result of applying @p nom to @p arg; @p noms are the nested @em noms that this result depends on.
+    void insert(Def* nom, const Def* arg, DefArray ops, ArrayRef<Def*> noms = {});
+    //@}
+
+    /// @name invalidate/evict
+    //@{
+    /// Drops all entries that depend on @p nom.
+    void invalidate(Def* nom);
+    /// Evicts entries until at most @p capacity entries remain; @c 0 disables the cache.
+    void set_capacity(size_t capacity);
+    void clear();
+    //@}
+
+    Stream& stream(Stream&) const;
+
+private:
+    struct Entry {
+        DefDef key;
+        DefArray ops;
+        std::vector<Def*> noms; ///< Includes <tt>key.first</tt>.
+        size_t bytes;
+    };
+    using Iter = std::list<Entry>::iterator;
+
+    void erase(Iter);
+
+    size_t capacity_;
+    std::list<Entry> lru_; ///< Most recently used entry first.
+    DefDefMap<Iter> key2entry_;
+    NomMap<DefDefSet> nom2keys_;
+    Stats stats_;
+};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "thorin/be/llvm/llvm.h"
 
 #include <algorithm>
+#include <limits>
 #include <stdexcept>
 
 #include <llvm/ADT/Triple.h>
@@ -12,6 +13,7 @@
 #include <llvm/IR/InlineAsm.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
@@ -31,6 +33,7 @@
 
 #include "thorin/def.h"
 #include "thorin/world.h"
+#include "thorin/analyses/loopinfo.h"
 #include "thorin/analyses/schedule.h"
 #include "thorin/analyses/scope.h"
 #include "thorin/be/llvm/amdgpu.h"
@@ -104,6 +107,44 @@ void CodeGen::emit_result_phi(const Def* var, llvm::Value* value) {
     phis_.lookup(var).value()->addIncoming(value, irbuilder_.GetInsertBlock());
 }
 
+/// Loops with a constant trip count up to this many iterations are fully unrolled.
+static constexpr u64 Unroll_Threshold = 8;
+
+void CodeGen::emit_loop_metadata(const LoopInfo& loops, const BBMap& bb2lam) {
+    auto hint = [&](const char* name, llvm::Metadata* value = nullptr) -> llvm::Metadata* {
+        if (value) return llvm::MDNode::get(context_, {llvm::MDString::get(context_, name), value});
+        return llvm::MDNode::get(context_, {llvm::MDString::get(context_, name)});
+    };
+
+    for (const auto& loop : loops.loops()) {
+        const auto& tc = loop->trip_count();
+        if (!tc || !tc->countable || !tc->lit) continue;
+
+        // we only state facts - whether vectorizing or partially unrolling pays off is up to LLVM's cost models
+        std::vector<llvm::Metadata*> hints(1, nullptr); // the first operand refers to the loop id itself
+        auto count = u32(std::min<u64>(*tc->lit, std::numeric_limits<u32>::max()));
+        hints.emplace_back(hint("llvm.loop.estimated_trip_count", llvm::ConstantAsMetadata::get(irbuilder_.getInt32(count))));
+        if (*tc->lit <= Unroll_Threshold) hints.emplace_back(hint("llvm.loop.unroll.full"));
+
+        auto id = llvm::MDNode::getDistinct(context_, hints);
+        id->replaceOperandWith(0, id);
+
+        auto header = bb2lam.lookup(loop->header()).value();
+        for (auto latch : loop->latches()) {
+            // a latch may have been split by an intrinsic - only annotate the actual back edge
+            auto term = bb2lam.lookup(latch).value()->getTerminator();
+            auto br = llvm::dyn_cast_or_null<llvm::BranchInst>(term);
+            if (br == nullptr) continue;
+            for (unsigned i = 0, e = br->getNumSuccessors(); i != e; ++i) {
+                if (br->getSuccessor(i) == header) {
+                    br->setMetadata(llvm::LLVMContext::MD_loop, id);
+                    break;
+                }
+            }
+        }
+    }
+}
+
 Lam* CodeGen::emit_atomic(Lam* lam) {
     assert(lam->body()->as<App>()->num_args() == 5 && "required arguments are missing");
     if (!isa<Tag::Int>(lam->body()->as<App>()->arg(3)->type()))
@@ -483,6 +524,8 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
             }
         }
 
+        emit_loop_metadata(LoopInfo(scope.f_cfg()), bb2lam);
+
         // add missing arguments to phis_
         for (const auto& p : phis_) {
             if (auto phi = p.second) {
@@ -902,14 +945,24 @@ llvm::Value* CodeGen::emit_store(const App* store) {
     return irbuilder_.CreateStore(lookup(val), lookup(ptr));
 }
 
+/// Folds a chain of nested LEAs into a single GEP - a literal index into a Sigma becomes a constant field offset.
 llvm::Value* CodeGen::emit_lea(const App* lea) {
-    auto [ptr, index] = lea->args<2>();
-    auto pointee = as<Tag::Ptr>(ptr->type())->arg(0);
-    if (pointee->isa<Sigma>())
-        return irbuilder_.CreateStructGEP(convert(pointee), lookup(ptr), as_lit<u64>(index));
+    std::vector<llvm::Value*> args;
+    const Def* ptr = lea;
+    while (auto l = isa<Tag::LEA>(ptr)) {
+        auto [p, index] = l->args<2>();
+        auto pointee = as<Tag::Ptr>(p->type())->arg(0);
+        if (pointee->isa<Sigma>()) {
+            args.emplace_back(irbuilder_.getInt32(as_lit<u64>(index)));
+        } else {
+            assert(pointee->isa<Arr>());
+            args.emplace_back(i1toi32(lookup(index)));
+        }
+        ptr = p;
+    }
 
-    assert(pointee->isa<Arr>());
-    llvm::Value* args[2] = { irbuilder_.getInt64(0), i1toi32(lookup(index)) };
+    args.emplace_back(irbuilder_.getInt64(0));
+    std::reverse(args.begin(), args.end());
     return irbuilder_.CreateInBoundsGEP(lookup(ptr), args);
 }
 
@@ -14,6 +14,7 @@
 
 namespace thorin {
 
+class LoopInfo;
 class World;
 
 typedef LamMap<llvm::BasicBlock*> BBMap;
@@ -69,6 +70,7 @@ private:
     llvm::Value* emit_bitcast(const Def*, const Def*);
     virtual Lam* emit_reserve(Lam*);
     void emit_result_phi(const Def*, llvm::Value*);
+    void emit_loop_metadata(const LoopInfo&, const BBMap&); ///< Attaches the constant trip counts of loops as @c llvm.loop metadata to their back edges.
     void emit_vectorize(u32, llvm::Function*, llvm::CallInst*);
 
 protected:
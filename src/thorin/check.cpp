@@ -7,6 +7,7 @@ namespace thorin {
 bool Checker::equiv(const Def* d1, const Def* d2) {
     if (d1 == d2 || (!d1->is_set() && !d2->is_set()) || (d1->isa<Space>() && d2->isa<Space>())) return true;
     if (d1->level() != d2->level()) return false;
+    auto guard = world().lock(); // equiv_ and vars_ are shared in concurrent mode
 
     // normalize: always put smaller gid to the left
     if (d1->gid() > d2->gid()) std::swap(d1, d2);
@@ -20,6 +20,7 @@ Def::Def(node_t node, const Def* type, Defs ops, uint64_t fields, const Def* dbg
     , var_(false)
     , dep_(Dep::Bot)
     , proxy_(0)
+    , reclaimed_(0)
     , order_(0)
     , num_ops_(ops.size())
     , dbg_(dbg)
@@ -47,6 +48,7 @@ Def::Def(node_t node, const Def* type, size_t num_ops, uint64_t fields, const De
     , var_(false)
     , dep_(Dep::Nom)
     , proxy_(0)
+    , reclaimed_(0)
     , order_(0)
     , num_ops_(num_ops)
     , dbg_(dbg)
@@ -55,7 +57,10 @@ Def::Def(node_t node, const Def* type, size_t num_ops, uint64_t fields, const De
     gid_ = world().next_gid();
     hash_ = murmur3(gid());
     std::fill_n(ops_ptr(), num_ops, nullptr);
-    if (!type->no_dep()) type->uses_.emplace(this, -1);
+    if (!type->no_dep()) {
+        if (type->reclaimed_) world().revive(type);
+        type->uses_.emplace(this, -1);
+    }
 }
 
 Kind::Kind(World& world)
@@ -122,8 +127,10 @@ const Pi* Pi::restructure() {
 
 const Def* Arr::restructure() {
     auto& w = world();
-    if (auto n = isa_lit(shape()))
-        return w.sigma(DefArray(*n, [&](size_t i) { return apply(w.lit_int(*n, i)).back(); }));
+    if (auto n = isa_lit(shape())) {
+        auto bodies = apply_each(DefArray(*n, [&](size_t i) { return w.lit_int(*n, i); }));
+        return w.sigma(DefArray(*n, [&](size_t i) { return bodies[i].back(); }));
+    }
     return nullptr;
 }
 
@@ -229,6 +236,7 @@ void Def::set_name(const std::string& n) const {
 void Def::finalize() {
     for (size_t i = 0, e = num_ops(); i != e; ++i) {
         if (auto dep = op(i)->dep(); dep != Dep::Bot) {
+            if (op(i)->reclaimed_) world().revive(op(i));
             dep_ |= dep;
             const auto& p = op(i)->uses_.emplace(this, i);
             assert_unused(p.second);
@@ -238,6 +246,7 @@ void Def::finalize() {
 
     if (!isa<Space>() && !isa<Axiom>()) {
         if (auto dep = type()->dep(); dep != Dep::Bot) {
+            if (type()->reclaimed_) world().revive(type());
             dep_ |= dep;
             const auto& p = type()->uses_.emplace(this, -1);
             assert_unused(p.second);
@@ -262,12 +271,17 @@ void Def::finalize() {
 
 Def* Def::set(size_t i, const Def* def) {
     if (op(i) == def) return this;
-    if (op(i) != nullptr) unset(i);
+    auto guard = world().lock(); // def may be shared with other threads in concurrent mode
+    if (op(i) != nullptr)
+        unset(i);
+    else
+        invalidate();
 
     if (def != nullptr) {
         assert(i < num_ops() && "index out of bounds");
         ops_ptr()[i] = def;
         order_ = std::max(order_, def->order_);
+        if (def->reclaimed_) world().revive(def);
         const auto& p = def->uses_.emplace(this, i);
         assert_unused(p.second);
     }
@@ -276,11 +290,17 @@ Def* Def::set(size_t i, const Def* def) {
 
 void Def::unset(size_t i) {
     assert(i < num_ops() && "index out of bounds");
+    auto guard = world().lock();
     auto def = op(i);
     assert(def->uses_.contains(Use(this, i)));
     def->uses_.erase(Use(this, i));
     assert(!def->uses_.contains(Use(this, i)));
     ops_ptr()[i] = nullptr;
+    invalidate();
+}
+
+void Def::invalidate() {
+    if (auto& cache = world().apply_cache(); !cache.empty()) cache.invalidate(this);
 }
 
 bool Def::is_set() const {
@@ -325,10 +345,43 @@ DefArray Def::apply(const Def* arg) const {
 }
 
 DefArray Def::apply(const Def* arg) {
-    auto& cache = world().data_.cache_;
-    if (auto res = cache.lookup({this, arg})) return *res;
+    auto& cache = world().apply_cache();
+    if (auto guard = world().lock(); auto res = cache.lookup(this, arg)) return *res;
+
+    std::vector<Def*> noms;
+    auto res = rewrite(this, arg, &noms);
+    auto guard = world().lock();
+    cache.insert(this, arg, res, noms);
+    return res;
+}
 
-    return cache[{this, arg}] = rewrite(this, arg);
+std::vector<DefArray> Def::apply_each(Defs args) {
+    auto& cache = world().apply_cache();
+    std::vector<DefArray> result(args.size());
+    DefVec todo;
+    std::vector<size_t> indices;
+
+    {
+        auto guard = world().lock();
+        for (size_t i = 0, e = args.size(); i != e; ++i) {
+            if (auto res = cache.lookup(this, args[i])) {
+                result[i] = *res;
+            } else {
+                todo.emplace_back(args[i]);
+                indices.emplace_back(i);
+            }
+        }
+    }
+
+    std::vector<std::vector<Def*>> noms;
+    auto res = rewrite_each(this, todo, &noms);
+    auto guard = world().lock();
+    for (size_t j = 0, e = todo.size(); j != e; ++j) {
+        cache.insert(this, todo[j], res[j], noms[j]);
+        result[indices[j]] = std::move(res[j]);
+    }
+
+    return result;
 }
 
 const Def* Def::reduce() const {
@@ -9,6 +9,7 @@
 #include "thorin/util/array.h"
 #include "thorin/util/cast.h"
 #include "thorin/util/hash.h"
+#include "thorin/util/persistent.h"
 #include "thorin/util/ptr.h"
 #include "thorin/util/stream.h"
 
@@ -30,6 +31,10 @@ template<class Key, class Value>
 using GIDMap = thorin::HashMap<Key, Value, GIDHash<Key>>;
 template<class Key>
 using GIDSet = thorin::HashSet<Key, GIDHash<Key>>;
+template<class Key, class Value>
+using PersistentGIDMap = thorin::PersistentMap<Key, Value, GIDHash<Key>>;
+template<class Key>
+using PersistentGIDSet = thorin::PersistentSet<Key, GIDHash<Key>>;
 
 //------------------------------------------------------------------------------
 
@@ -288,6 +293,8 @@ public:
     //@{
     DefArray apply(const Def* arg) const;
     DefArray apply(const Def* arg);
+    /// Same as @p apply for each of @p args but computes the Scope of @c this @em nom at most once.
+    std::vector<DefArray> apply_each(Defs args);
     //@}
 
     /// @name reduce/subst
@@ -338,6 +345,8 @@ public:
 protected:
     const Def** ops_ptr() const { return reinterpret_cast<const Def**>(reinterpret_cast<char*>(const_cast<Def*>(this + 1))); }
     void finalize();
+    /// Drops all results of Def::apply that depend on this @em nom.
+    void invalidate();
 
     union {
         /// @p Axiom%s use this member to store their normalize function and the currying depth.
@@ -351,6 +360,7 @@ protected:
     unsigned var_   :  1;
     unsigned dep_   :  2;
     unsigned proxy_ :  1;
+    mutable unsigned reclaimed_ : 1; ///< See World::reclaim.
     unsigned order_ : 11;
     u32 gid_;
     u32 num_ops_;
@@ -0,0 +1,345 @@
+#include "thorin/egraph.h"
+
+#include "thorin/fold.h"
+#include "thorin/world.h"
+
+namespace thorin {
+
+/*
+ * helpers
+ */
+
+namespace {
+
+/// Tag, flags, and - for @p Wrap and @p ROp - the mode of the operation @p callee.
+struct OpInfo {
+    OpInfo(const Def* callee) {
+        auto [axiom, _] = get_axiom(callee);
+        tag   = axiom->tag();
+        flags = axiom->flags();
+        if (tag == Tag::Wrap || tag == Tag::ROp) mode = isa_lit(callee->as<App>()->arg(0));
+    }
+
+    tag_t tag;
+    flags_t flags;
+    std::optional<nat_t> mode;
+};
+
+}
+
+static bool is_commutative(const Def* callee) {
+    OpInfo op(callee);
+    switch (op.tag) {
+        case Tag::Wrap: return is_commutative(Wrap(op.flags));
+        case Tag::ROp:  return is_commutative(ROp (op.flags));
+        case Tag::Bit:  return is_commutative(Bit (op.flags));
+        default:        return false;
+    }
+}
+
+static bool is_associative(const Def* callee) {
+    OpInfo op(callee);
+    switch (op.tag) {
+        case Tag::Wrap: return is_associative(Wrap(op.flags)) && op.mode == WMode::none; // nsw/nuw don't survive reassociation
+        case Tag::ROp:  return is_associative(ROp (op.flags)) && op.mode && has(*op.mode, RMode::reassoc);
+        case Tag::Bit:  return is_associative(Bit (op.flags));
+        default:        return false;
+    }
+}
+
+/// Does @p callee distribute over @p other?
+static bool is_distributive(const Def* callee, const Def* other) {
+    OpInfo op(callee), ot(other);
+    if (op.tag != ot.tag) return false;
+    switch (op.tag) {
+        case Tag::Wrap: return is_distributive(Wrap(op.flags), Wrap(ot.flags)) && op.mode == WMode::none && ot.mode == WMode::none;
+        case Tag::Bit:  return is_distributive(Bit (op.flags), Bit (ot.flags)) && is_commutative(Bit(op.flags));
+        default:        return false;
+    }
+}
+
+/*
+ * EGraph
+ */
+
+EGraph::EGraph(World& world)
+    : EGraph(world, Limits())
+{}
+
+hash_t EGraph::NodeHash::hash(const Node& node) {
+    auto hash = hash_begin(node.op->gid());
+    for (auto kid : node.kids) hash = hash_combine(hash, kid);
+    return hash;
+}
+
+size_t EGraph::default_cost(const Node& node) {
+    if (node.is_leaf()) return 0;
+
+    OpInfo op(node.op);
+    switch (op.tag) {
+        case Tag::Wrap: return Wrap(op.flags) == Wrap::mul ? 4 : 1;
+        case Tag::ROp:
+            switch (ROp(op.flags)) {
+                case ROp::mul: return 4;
+                case ROp::div:
+                case ROp::rem: return 16;
+                default:       return 2;
+            }
+        default: return 1;
+    }
+}
+
+const App* EGraph::isa_op(const Def* def) {
+    auto [axiom, currying_depth] = get_axiom(def);
+    if (axiom == nullptr || currying_depth != 0) return nullptr;
+
+    switch (axiom->tag()) {
+        case Tag::Wrap:
+        case Tag::ROp:
+        case Tag::Bit:
+        case Tag::Shr:
+        case Tag::Conv: return def->as<App>();
+        default:        return nullptr;
+    }
+}
+
+EGraph::Id EGraph::import(const Def* def) {
+    if (auto id = def2id_.lookup(def)) return find(*id);
+
+    Node node{def, {}};
+    if (auto app = isa_op(def)) {
+        node.op = app->callee();
+        if (isa<Tag::Conv>(app))
+            node.kids = {import(app->arg())};
+        else
+            node.kids = {import(app->arg(0)), import(app->arg(1))};
+    }
+
+    auto id = add(std::move(node));
+    if (classes_[id].def == nullptr) classes_[id].def = def;
+    def2id_[def] = id;
+    return id;
+}
+
+void EGraph::canonicalize(Node& node) const {
+    for (auto& kid : node.kids) kid = find(kid);
+}
+
+EGraph::Id EGraph::add(Node node) {
+    canonicalize(node);
+    if (auto i = memo_.find(node); i != memo_.end()) return find(i->second);
+
+    auto id = Id(classes_.size());
+    auto& c = classes_.emplace_back();
+    c.nodes.emplace_back(nodes_.size());
+    if (node.is_leaf()) {
+        c.def = node.op;
+        if (node.op->isa<Lit>()) c.lit = node.op;
+    }
+
+    parents_.emplace_back(id);
+    node2class_.emplace_back(id);
+    memo_.emplace(node, id);
+    nodes_.emplace_back(std::move(node));
+    changed_ = true;
+    return id;
+}
+
+EGraph::Id EGraph::find(Id id) const {
+    while (parents_[id] != id) id = parents_[id] = parents_[parents_[id]];
+    return id;
+}
+
+bool EGraph::merge(Id a, Id b) {
+    a = find(a), b = find(b);
+    if (a == b) return false;
+
+    if (classes_[a].nodes.size() < classes_[b].nodes.size()) std::swap(a, b);
+    parents_[b] = a;
+
+    auto& ca = classes_[a];
+    auto& cb = classes_[b];
+    if (ca.lit == nullptr) ca.lit = cb.lit;
+    if (ca.def == nullptr) ca.def = cb.def;
+    ca.nodes.insert(ca.nodes.end(), cb.nodes.begin(), cb.nodes.end());
+    cb.nodes.clear();
+    changed_ = true;
+    return true;
+}
+
+bool EGraph::rebuild() {
+    bool merged = false;
+    for (bool todo = true; todo;) {
+        todo = false;
+        memo_.clear();
+        for (size_t i = 0, e = nodes_.size(); i != e; ++i) {
+            canonicalize(nodes_[i]);
+            auto [j, ins] = memo_.emplace(nodes_[i], node2class_[i]);
+            if (!ins && merge(j->second, node2class_[i])) todo = merged = true;
+        }
+    }
+
+    // drop duplicates and recollect the Nodes of each e-class
+    std::vector<Node> nodes;
+    std::vector<Id> node2class;
+    for (auto& c : classes_) c.nodes.clear();
+    memo_.clear();
+
+    for (size_t i = 0, e = nodes_.size(); i != e; ++i) {
+        auto id = find(node2class_[i]);
+        if (memo_.emplace(nodes_[i], id).second) {
+            classes_[id].nodes.emplace_back(nodes.size());
+            nodes.emplace_back(std::move(nodes_[i]));
+            node2class.emplace_back(id);
+        }
+    }
+
+    nodes_.swap(nodes);
+    node2class_.swap(node2class);
+    return merged;
+}
+
+bool EGraph::exceeded() const {
+    return nodes_.size() >= limits_.nodes || std::chrono::steady_clock::now() - start_ >= limits_.time;
+}
+
+size_t EGraph::saturate() {
+    start_ = std::chrono::steady_clock::now();
+    rebuild();
+
+    size_t i = 0;
+    while (i != limits_.iterations && !exceeded()) {
+        ++i;
+        changed_ = false;
+        for (size_t j = 0, e = nodes_.size(); j != e && !exceeded(); ++j) {
+            if (nodes_[j].is_leaf()) continue;
+            auto node = nodes_[j]; // copy as the rules add Nodes
+            auto id = find(node2class_[j]);
+            commute   (node, id);
+            associate (node, id);
+            distribute(node, id);
+            fold      (node, id);
+        }
+
+        rebuild();
+        if (!changed_) break; // saturated
+    }
+
+    world().DLOG("saturated e-graph after {} iterations: {} nodes, {} classes", i, num_nodes(), num_classes());
+    return i;
+}
+
+/*
+ * rules
+ */
+
+void EGraph::commute(const Node& node, Id id) {
+    if (node.kids.size() != 2 || !is_commutative(node.op)) return;
+    merge(id, add({node.op, {node.kids[1], node.kids[0]}}));
+}
+
+void EGraph::associate(const Node& node, Id id) {
+    if (node.kids.size() != 2 || !is_associative(node.op)) return;
+    auto a = node.kids[0], b = node.kids[1];
+
+    // (x op y) op b -> x op (y op b)
+    for (auto i : std::vector<size_t>(classes_[find(a)].nodes)) {
+        auto xy = nodes_[i];
+        if (xy.op == node.op) merge(id, add({node.op, {xy.kids[0], add({node.op, {xy.kids[1], b}})}}));
+    }
+
+    // a op (y op z) -> (a op y) op z
+    for (auto i : std::vector<size_t>(classes_[find(b)].nodes)) {
+        auto yz = nodes_[i];
+        if (yz.op == node.op) merge(id, add({node.op, {add({node.op, {a, yz.kids[0]}}), yz.kids[1]}}));
+    }
+}
+
+void EGraph::distribute(const Node& node, Id id) {
+    if (node.kids.size() != 2) return;
+    auto a = node.kids[0], b = node.kids[1];
+
+    // a * (y + z) -> a*y + a*z
+    for (auto i : std::vector<size_t>(classes_[find(b)].nodes)) {
+        auto yz = nodes_[i];
+        if (yz.kids.size() == 2 && is_distributive(node.op, yz.op))
+            merge(id, add({yz.op, {add({node.op, {a, yz.kids[0]}}), add({node.op, {a, yz.kids[1]}})}}));
+    }
+
+    // x*y + x*z -> x * (y + z)
+    auto xys = classes_[find(a)].nodes, xzs = classes_[find(b)].nodes;
+    for (auto i : xys) {
+        for (auto j : xzs) {
+            auto xy = nodes_[i], xz = nodes_[j];
+            if (xy.op == xz.op && xy.kids.size() == 2 && find(xy.kids[0]) == find(xz.kids[0]) && is_distributive(xy.op, node.op))
+                merge(id, add({xy.op, {xy.kids[0], add({node.op, {xy.kids[1], xz.kids[1]}})}}));
+        }
+    }
+}
+
+void EGraph::fold(const Node& node, Id id) {
+    bool lit = false;
+    DefVec ops;
+    for (auto kid : node.kids) {
+        const auto& c = classes_[find(kid)];
+        auto def = c.lit ? c.lit : c.def;
+        if (def == nullptr) return;
+        lit |= c.lit != nullptr;
+        ops.emplace_back(def);
+    }
+    if (!lit) return;
+
+    auto arg = ops.size() == 1 ? ops.front() : world().tuple(ops);
+    auto res = world().app(node.op, arg);
+    if (auto app = res->isa<App>(); app && app->callee() == node.op && app->arg() == arg) return; // nothing to fold
+    merge(id, import(res));
+}
+
+/*
+ * extract
+ */
+
+void EGraph::compute_costs(const Cost& cost) {
+    static constexpr size_t Inf = std::numeric_limits<size_t>::max();
+
+    std::vector<size_t> node_costs;
+    for (const auto& node : nodes_) node_costs.emplace_back(node.is_leaf() ? cost(node) : std::max(cost(node), size_t(1)));
+
+    best_.assign(classes_.size(), {Inf, 0});
+    for (bool todo = true; todo;) {
+        todo = false;
+        for (size_t i = 0, e = nodes_.size(); i != e; ++i) {
+            auto sum = node_costs[i];
+            for (auto kid : nodes_[i].kids) {
+                auto k = best_[find(kid)].first;
+                sum = k == Inf || sum > Inf - k ? Inf : sum + k;
+            }
+
+            auto& [c, n] = best_[find(node2class_[i])];
+            if (sum < c) {
+                c = sum;
+                n = i;
+                todo = true;
+            }
+        }
+    }
+}
+
+const Def* EGraph::extract(Id id) {
+    std::vector<const Def*> built(classes_.size(), nullptr); // e-class -> Def
+    std::function<const Def*(Id)> build = [&](Id id) {
+        id = find(id);
+        if (auto def = built[id]) return def;
+
+        const auto& node = nodes_[best_[id].second];
+        if (node.is_leaf()) return built[id] = node.op;
+
+        DefVec ops;
+        for (auto kid : node.kids) ops.emplace_back(build(kid));
+        return built[id] = world().app(node.op, ops.size() == 1 ? ops.front() : world().tuple(ops));
+    };
+
+    return build(id);
+}
+
+}
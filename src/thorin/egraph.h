@@ -0,0 +1,124 @@
+#ifndef THORIN_EGRAPH_H
+#define THORIN_EGRAPH_H
+
+#include <chrono>
+#include <functional>
+
+#include "thorin/def.h"
+
+namespace thorin {
+
+class App;
+class World;
+
+/**
+ * An e-graph for equality saturation of arithmetic.
+ * @p App%s of @p Wrap, @p ROp, @p Bit, @p Shr, and @p Conv become e-nodes; all other Def%s are opaque leaves.
+ * saturate applies rewrite rules until nothing changes anymore or the Limits are exceeded:
+ * * commutativity, associativity, and distributivity - derived from @p is_commutative, @p is_associative, and @p is_distributive,
+ * * whatever the normalizers of the World make out of an e-node with a @p Lit among its operands.
+ *
+ * Afterwards, compute_costs selects the cheapest e-node of each e-class under a pluggable Cost model and extract rebuilds the cheapest Def.
+ */
+class EGraph {
+public:
+    using Id = u32;
+
+    struct Node {
+        const Def* op;        ///< The callee of an operation or the Def itself for a leaf.
+        std::vector<Id> kids; ///< Empty for a leaf.
+
+        bool is_leaf() const { return kids.empty(); }
+        bool operator==(const Node& other) const { return op == other.op && kids == other.kids; }
+    };
+
+    /// Yields the cost of a single Node excluding its kids; must not be @c 0 for operations.
+    using Cost = std::function<size_t(const Node&)>;
+    static size_t default_cost(const Node&);
+
+    struct Limits {
+        size_t nodes      = 10000;
+        size_t iterations = 16;
+        std::chrono::steady_clock::duration time = std::chrono::milliseconds(100);
+    };
+
+    EGraph(World& world, Limits limits)
+        : world_(world)
+        , limits_(limits)
+    {}
+    EGraph(World&);
+
+    /// @name getters
+    //@{
+    World& world() const { return world_; }
+    size_t num_nodes() const { return nodes_.size(); }
+    size_t num_classes() const { return classes_.size(); }
+    //@}
+
+    /// @name build
+    //@{
+    /// Adds @p def and - if it's an operation - its operands recursively.
+    Id import(const Def* def);
+    Id add(Node);
+    Id find(Id) const;
+    /// Yields @c true if @p a and @p b haven't been equivalent before.
+    bool merge(Id a, Id b);
+    //@}
+
+    /// @name saturate/extract
+    //@{
+    /// Returns the number of iterations.
+    size_t saturate();
+    void compute_costs(const Cost& = default_cost);
+    /// Cheapest cost of @p id as of the last compute_costs.
+    size_t cost(Id id) const { return best_[find(id)].first; }
+    /// Builds the cheapest Def of @p id as of the last compute_costs.
+    const Def* extract(Id);
+    //@}
+
+    /// Yields the @p App if @p def becomes an e-node.
+    static const App* isa_op(const Def* def);
+
+private:
+    struct Class {
+        std::vector<size_t> nodes; ///< Indices into nodes_; only complete right after rebuild.
+        const Def* lit = nullptr;  ///< A @p Lit in this e-class.
+        const Def* def = nullptr;  ///< Some Def in this e-class - if known.
+    };
+
+    struct NodeHash {
+        static hash_t hash(const Node&);
+        static bool eq(const Node& a, const Node& b) { return a == b; }
+        static Node sentinel() { return {(const Def*)(1), {}}; }
+    };
+
+    void canonicalize(Node&) const;
+    /// Restores congruence: e-nodes with equivalent kids end up in the same e-class.
+    /// Returns @c true if any e-classes have been merged.
+    bool rebuild();
+    bool exceeded() const;
+
+    /// @name rules
+    //@{
+    void commute(const Node&, Id);
+    void associate(const Node&, Id);
+    void distribute(const Node&, Id);
+    void fold(const Node&, Id);
+    //@}
+
+    World& world_;
+    Limits limits_;
+    std::chrono::steady_clock::time_point start_;
+    bool changed_ = false; ///< Has any Node been added or any e-class been merged?
+    std::vector<Node> nodes_;
+    std::vector<Id> node2class_;
+    mutable std::vector<Id> parents_; ///< Union-find; mutable for path compression.
+    std::vector<Class> classes_;
+    HashMap<Node, Id, NodeHash> memo_;
+    DefMap<Id> def2id_;
+    std::vector<std::pair<size_t, size_t>> best_; ///< Cost and index of the cheapest Node per e-class.
+};
+
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef THORIN_FOLD_H
+#define THORIN_FOLD_H
+
+#include <array>
+#include <optional>
+
+#include "thorin/tables.h"
+#include "thorin/util/cast.h"
+#include "thorin/util/types.h"
+
+namespace thorin {
+
+/// @name algebraic properties
+//@{
+/// Use like this:
+/// @code a op b = tab[a][b] @endcode
+constexpr std::array<std::array<uint64_t, 2>, 2> make_truth_table(Bit op) {
+    return {{ {tag_t(op) & tag_t(0b0001) ? u64(-1) : 0, tag_t(op) & tag_t(0b0100) ? u64(-1) : 0},
+              {tag_t(op) & tag_t(0b0010) ? u64(-1) : 0, tag_t(op) & tag_t(0b1000) ? u64(-1) : 0} }};
+}
+
+template<class T> constexpr bool is_commutative(T) { return false; }
+constexpr bool is_commutative(Wrap op) { return op == Wrap:: add || op == Wrap::mul; }
+constexpr bool is_commutative(ROp  op) { return op == ROp :: add || op == ROp ::mul; }
+constexpr bool is_commutative(ICmp op) { return op == ICmp::   e || op == ICmp:: ne; }
+constexpr bool is_commutative(RCmp op) { return op == RCmp::   e || op == RCmp:: ne; }
+constexpr bool is_commutative(Bit  op) {
+    auto tab = make_truth_table(op);
+    return tab[0][1] == tab[1][0];
+}
+
+template<class T> constexpr bool is_associative(T op) { return is_commutative(op); }
+constexpr bool is_associative(Bit op) {
+    switch (op) {
+        case Bit::   t:
+        case Bit::_xor:
+        case Bit::_and:
+        case Bit::nxor:
+        case Bit::   a:
+        case Bit::   b:
+        case Bit:: _or:
+        case Bit::   f: return true;
+        default       : return false;
+    }
+}
+
+/// Does @p op distribute over @p other - i.e. <tt>a op (b other c) = (a op b) other (a op c)</tt>?
+template<class T> constexpr bool is_distributive(T, T) { return false; }
+constexpr bool is_distributive(Wrap op, Wrap other) { return op == Wrap::mul && (other == Wrap::add || other == Wrap::sub); }
+constexpr bool is_distributive(Bit op, Bit other) {
+    auto f = make_truth_table(op), g = make_truth_table(other);
+    for (int a = 0; a != 2; ++a) {
+        for (int b = 0; b != 2; ++b) {
+            for (int c = 0; c != 2; ++c) {
+                if (f[a][g[b][c] & 1] != g[f[a][b] & 1][f[a][c] & 1]) return false;
+            }
+        }
+    }
+    return true;
+}
+//@}
+
+/// @name Fold
+/// Constant folding of primops on the bit patterns of their literal operands.
+/// The normalizers use these templates; they also serve as oracle for testing other rewrites.
+//@{
+template<class T> T get(u64 u) { return bitcast<T>(u); }
+
+// This code assumes two-complement arithmetic for unsigned operations.
+// This is *implementation-defined* but *NOT* *undefined behavior*.
+
+class Res {
+public:
+    Res()
+        : data_{}
+    {}
+    template<class T>
+    Res(T val)
+        : data_(bitcast<u64>(val))
+    {}
+
+    constexpr const u64& operator*() const& { return *data_; }
+    constexpr u64& operator*() & { return *data_; }
+    explicit operator bool() const { return data_.has_value(); }
+
+private:
+    std::optional<u64> data_;
+};
+
+template<class T, T, nat_t> struct Fold {};
+
+template<nat_t w> struct Fold<Wrap, Wrap::add, w> {
+    static Res run(u64 a, u64 b, bool /*nsw*/, bool nuw) {
+        auto x = get<w2u<w>>(a), y = get<w2u<w>>(b);
+        decltype(x) res = x + y;
+        if (nuw && res < x) return {};
+        // TODO nsw
+        return res;
+    }
+};
+
+template<nat_t w> struct Fold<Wrap, Wrap::sub, w> {
+    static Res run(u64 a, u64 b, bool /*nsw*/, bool /*nuw*/) {
+        using UT = w2u<w>;
+        auto x = get<UT>(a), y = get<UT>(b);
+        decltype(x) res = x - y;
+        //if (nuw && y && x > std::numeric_limits<UT>::max() / y) return {};
+        // TODO nsw
+        return res;
+    }
+};
+
+template<nat_t w> struct Fold<Wrap, Wrap::mul, w> {
+    static Res run(u64 a, u64 b, bool /*nsw*/, bool /*nuw*/) {
+        using UT = w2u<w>;
+        auto x = get<UT>(a), y = get<UT>(b);
+        if constexpr (std::is_same_v<UT, bool>)
+            return UT(x & y);
+        else
+            return UT(x * y);
+        // TODO nsw/nuw
+    }
+};
+
+template<nat_t w> struct Fold<Wrap, Wrap::shl, w> {
+    static Res run(u64 a, u64 b, bool nsw, bool nuw) {
+        using T = w2u<w>;
+        auto x = get<T>(a), y = get<T>(b);
+        if (u64(y) >= w) return {};
+        decltype(x) res;
+        if constexpr (std::is_same_v<T, bool>)
+            res = bool(u64(x) << u64(y));
+        else
+            res = x << y;
+        if (nuw && res < x) return {};
+        if (nsw && get_sign(x) != get_sign(res)) return {};
+        return res;
+    }
+};
+
+template<nat_t w> struct Fold<Div, Div::sdiv, w> { static Res run(u64 a, u64 b) { using T = w2s<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) / r); } };
+template<nat_t w> struct Fold<Div, Div::udiv, w> { static Res run(u64 a, u64 b) { using T = w2u<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) / r); } };
+template<nat_t w> struct Fold<Div, Div::srem, w> { static Res run(u64 a, u64 b) { using T = w2s<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) % r); } };
+template<nat_t w> struct Fold<Div, Div::urem, w> { static Res run(u64 a, u64 b) { using T = w2u<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) % r); } };
+
+template<nat_t w> struct Fold<Shr, Shr::ashr, w> { static Res run(u64 a, u64 b) { using T = w2s<w>; if (b >= w) return {}; return T(get<T>(a) >> get<T>(b)); } };
+template<nat_t w> struct Fold<Shr, Shr::lshr, w> { static Res run(u64 a, u64 b) { using T = w2u<w>; if (b >= w) return {}; return T(get<T>(a) >> get<T>(b)); } };
+
+template<nat_t w> struct Fold<ROp, ROp:: add, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) + get<T>(b)); } };
+template<nat_t w> struct Fold<ROp, ROp:: sub, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) - get<T>(b)); } };
+template<nat_t w> struct Fold<ROp, ROp:: mul, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) * get<T>(b)); } };
+template<nat_t w> struct Fold<ROp, ROp:: div, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) / get<T>(b)); } };
+template<nat_t w> struct Fold<ROp, ROp:: rem, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(rem(get<T>(a), get<T>(b))); } };
+
+template<ICmp cmp, nat_t w> struct Fold<ICmp, cmp, w> {
+    inline static Res run(u64 a, u64 b) {
+        using T = w2u<w>;
+        auto x = get<T>(a), y = get<T>(b);
+        bool result = false;
+        auto pm = !(x >> T(w-1)) &&  (y >> T(w-1));
+        auto mp =  (x >> T(w-1)) && !(y >> T(w-1));
+        result |= ((cmp & ICmp::_x) != ICmp::_f) && pm;
+        result |= ((cmp & ICmp::_y) != ICmp::_f) && mp;
+        result |= ((cmp & ICmp::_g) != ICmp::_f) && x > y && !mp;
+        result |= ((cmp & ICmp::_l) != ICmp::_f) && x < y && !pm;
+        result |= ((cmp & ICmp:: e) != ICmp::_f) && x == y;
+        return result;
+    }
+};
+
+template<RCmp cmp, nat_t w> struct Fold<RCmp, cmp, w> {
+    inline static Res run(u64 a, u64 b) {
+        using T = w2r<w>;
+        auto x = get<T>(a), y = get<T>(b);
+        bool result = false;
+        result |= ((cmp & RCmp::u) != RCmp::f) && std::isunordered((uint64_t)x, (uint64_t)y);
+        result |= ((cmp & RCmp::g) != RCmp::f) && x > y;
+        result |= ((cmp & RCmp::l) != RCmp::f) && x < y;
+        result |= ((cmp & RCmp::e) != RCmp::f) && x == y;
+        return result;
+    }
+};
+
+template<Conv op, nat_t, nat_t> struct FoldConv {};
+template<nat_t dw, nat_t sw> struct FoldConv<Conv::s2s, dw, sw> { static Res run(u64 src) { return w2s<dw>(get<w2s<sw>>(src)); } };
+template<nat_t dw, nat_t sw> struct FoldConv<Conv::u2u, dw, sw> { static Res run(u64 src) { return w2u<dw>(get<w2u<sw>>(src)); } };
+template<nat_t dw, nat_t sw> struct FoldConv<Conv::s2r, dw, sw> { static Res run(u64 src) { return w2r<dw>(get<w2s<sw>>(src)); } };
+template<nat_t dw, nat_t sw> struct FoldConv<Conv::u2r, dw, sw> { static Res run(u64 src) { return w2r<dw>(get<w2u<sw>>(src)); } };
+template<nat_t dw, nat_t sw> struct FoldConv<Conv::r2s, dw, sw> { static Res run(u64 src) { return w2s<dw>(get<w2r<sw>>(src)); } };
+template<nat_t dw, nat_t sw> struct FoldConv<Conv::r2u, dw, sw> { static Res run(u64 src) { return w2u<dw>(get<w2r<sw>>(src)); } };
+template<nat_t dw, nat_t sw> struct FoldConv<Conv::r2r, dw, sw> { static Res run(u64 src) { return w2r<dw>(get<w2r<sw>>(src)); } };
+//@}
+
+}
+
+#endif
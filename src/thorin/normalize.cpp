@@ -1,4 +1,5 @@
 #include "thorin/def.h"
+#include "thorin/fold.h"
 #include "thorin/world.h"
 
 // TODO rewrite int normalization to work on all int modulos.
@@ -24,168 +25,6 @@ static const Def* is_not(const Def* def) {
 }
 #endif
 
-template<class T> static T get(u64 u) { return bitcast<T>(u); }
-
-/// Use like this:
-/// @code a op b = tab[a][b] @endcode
-constexpr std::array<std::array<uint64_t, 2>, 2> make_truth_table(Bit op) {
-    return {{ {tag_t(op) & tag_t(0b0001) ? u64(-1) : 0, tag_t(op) & tag_t(0b0100) ? u64(-1) : 0},
-              {tag_t(op) & tag_t(0b0010) ? u64(-1) : 0, tag_t(op) & tag_t(0b1000) ? u64(-1) : 0} }};
-}
-
-template<class T> constexpr bool is_commutative(T) { return false; }
-constexpr bool is_commutative(Wrap op) { return op == Wrap:: add || op == Wrap::mul; }
-constexpr bool is_commutative(ROp  op) { return op == ROp :: add || op == ROp ::mul; }
-constexpr bool is_commutative(ICmp op) { return op == ICmp::   e || op == ICmp:: ne; }
-constexpr bool is_commutative(RCmp op) { return op == RCmp::   e || op == RCmp:: ne; }
-constexpr bool is_commutative(Bit  op) {
-    auto tab = make_truth_table(op);
-    return tab[0][1] == tab[1][0];
-}
-
-template<class T> constexpr bool is_associative(T op) { return is_commutative(op); }
-constexpr bool is_associative(Bit op) {
-    switch (op) {
-        case Bit::   t:
-        case Bit::_xor:
-        case Bit::_and:
-        case Bit::nxor:
-        case Bit::   a:
-        case Bit::   b:
-        case Bit:: _or:
-        case Bit::   f: return true;
-        default       : return false;
-    }
-}
-
-/*
- * Fold
- */
-
-// This code assumes two-complement arithmetic for unsigned operations.
-// This is *implementation-defined* but *NOT* *undefined behavior*.
-
-class Res {
-public:
-    Res()
-        : data_{}
-    {}
-    template<class T>
-    Res(T val)
-        : data_(bitcast<u64>(val))
-    {}
-
-    constexpr const u64& operator*() const& { return *data_; }
-    constexpr u64& operator*() & { return *data_; }
-    explicit operator bool() const { return data_.has_value(); }
-
-private:
-    std::optional<u64> data_;
-};
-
-template<class T, T, nat_t> struct Fold {};
-
-template<nat_t w> struct Fold<Wrap, Wrap::add, w> {
-    static Res run(u64 a, u64 b, bool /*nsw*/, bool nuw) {
-        auto x = get<w2u<w>>(a), y = get<w2u<w>>(b);
-        decltype(x) res = x + y;
-        if (nuw && res < x) return {};
-        // TODO nsw
-        return res;
-    }
-};
-
-template<nat_t w> struct Fold<Wrap, Wrap::sub, w> {
-    static Res run(u64 a, u64 b, bool /*nsw*/, bool /*nuw*/) {
-        using UT = w2u<w>;
-        auto x = get<UT>(a), y = get<UT>(b);
-        decltype(x) res = x - y;
-        //if (nuw && y && x > std::numeric_limits<UT>::max() / y) return {};
-        // TODO nsw
-        return res;
-    }
-};
-
-template<nat_t w> struct Fold<Wrap, Wrap::mul, w> {
-    static Res run(u64 a, u64 b, bool /*nsw*/, bool /*nuw*/) {
-        using UT = w2u<w>;
-        auto x = get<UT>(a), y = get<UT>(b);
-        if constexpr (std::is_same_v<UT, bool>)
-            return UT(x & y);
-        else
-            return UT(x * y);
-        // TODO nsw/nuw
-    }
-};
-
-template<nat_t w> struct Fold<Wrap, Wrap::shl, w> {
-    static Res run(u64 a, u64 b, bool nsw, bool nuw) {
-        using T = w2u<w>;
-        auto x = get<T>(a), y = get<T>(b);
-        if (u64(y) >= w) return {};
-        decltype(x) res;
-        if constexpr (std::is_same_v<T, bool>)
-            res = bool(u64(x) << u64(y));
-        else
-            res = x << y;
-        if (nuw && res < x) return {};
-        if (nsw && get_sign(x) != get_sign(res)) return {};
-        return res;
-    }
-};
-
-template<nat_t w> struct Fold<Div, Div::sdiv, w> { static Res run(u64 a, u64 b) { using T = w2s<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) / r); } };
-template<nat_t w> struct Fold<Div, Div::udiv, w> { static Res run(u64 a, u64 b) { using T = w2u<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) / r); } };
-template<nat_t w> struct Fold<Div, Div::srem, w> { static Res run(u64 a, u64 b) { using T = w2s<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) % r); } };
-template<nat_t w> struct Fold<Div, Div::urem, w> { static Res run(u64 a, u64 b) { using T = w2u<w>; T r = get<T>(b); if (r == 0) return {}; return T(get<T>(a) % r); } };
-
-template<nat_t w> struct Fold<Shr, Shr::ashr, w> { static Res run(u64 a, u64 b) { using T = w2s<w>; if (b > w) return {}; return T(get<T>(a) >> get<T>(b)); } };
-template<nat_t w> struct Fold<Shr, Shr::lshr, w> { static Res run(u64 a, u64 b) { using T = w2u<w>; if (b > w) return {}; return T(get<T>(a) >> get<T>(b)); } };
-
-template<nat_t w> struct Fold<ROp, ROp:: add, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) + get<T>(b)); } };
-template<nat_t w> struct Fold<ROp, ROp:: sub, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) - get<T>(b)); } };
-template<nat_t w> struct Fold<ROp, ROp:: mul, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) * get<T>(b)); } };
-template<nat_t w> struct Fold<ROp, ROp:: div, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(get<T>(a) / get<T>(b)); } };
-template<nat_t w> struct Fold<ROp, ROp:: rem, w> { static Res run(u64 a, u64 b) { using T = w2r<w>; return T(rem(get<T>(a), get<T>(b))); } };
-
-template<ICmp cmp, nat_t w> struct Fold<ICmp, cmp, w> {
-    inline static Res run(u64 a, u64 b) {
-        using T = w2u<w>;
-        auto x = get<T>(a), y = get<T>(b);
-        bool result = false;
-        auto pm = !(x >> T(w-1)) &&  (y >> T(w-1));
-        auto mp =  (x >> T(w-1)) && !(y >> T(w-1));
-        result |= ((cmp & ICmp::_x) != ICmp::_f) && pm;
-        result |= ((cmp & ICmp::_y) != ICmp::_f) && mp;
-        result |= ((cmp & ICmp::_g) != ICmp::_f) && x > y && !mp;
-        result |= ((cmp & ICmp::_l) != ICmp::_f) && x < y && !pm;
-        result |= ((cmp & ICmp:: e) != ICmp::_f) && x == y;
-        return result;
-    }
-};
-
-template<RCmp cmp, nat_t w> struct Fold<RCmp, cmp, w> {
-    inline static Res run(u64 a, u64 b) {
-        using T = w2r<w>;
-        auto x = get<T>(a), y = get<T>(b);
-        bool result = false;
-        result |= ((cmp & RCmp::u) != RCmp::f) && std::isunordered((uint64_t)x, (uint64_t)y);
-        result |= ((cmp & RCmp::g) != RCmp::f) && x > y;
-        result |= ((cmp & RCmp::l) != RCmp::f) && x < y;
-        result |= ((cmp & RCmp::e) != RCmp::f) && x == y;
-        return result;
-    }
-};
-
-template<Conv op, nat_t, nat_t> struct FoldConv {};
-template<nat_t dw, nat_t sw> struct FoldConv<Conv::s2s, dw, sw> { static Res run(u64 src) { return w2s<dw>(get<w2s<sw>>(src)); } };
-template<nat_t dw, nat_t sw> struct FoldConv<Conv::u2u, dw, sw> { static Res run(u64 src) { return w2u<dw>(get<w2u<sw>>(src)); } };
-template<nat_t dw, nat_t sw> struct FoldConv<Conv::s2r, dw, sw> { static Res run(u64 src) { return w2r<dw>(get<w2s<sw>>(src)); } };
-template<nat_t dw, nat_t sw> struct FoldConv<Conv::u2r, dw, sw> { static Res run(u64 src) { return w2r<dw>(get<w2u<sw>>(src)); } };
-template<nat_t dw, nat_t sw> struct FoldConv<Conv::r2s, dw, sw> { static Res run(u64 src) { return w2s<dw>(get<w2r<sw>>(src)); } };
-template<nat_t dw, nat_t sw> struct FoldConv<Conv::r2u, dw, sw> { static Res run(u64 src) { return w2u<dw>(get<w2r<sw>>(src)); } };
-template<nat_t dw, nat_t sw> struct FoldConv<Conv::r2r, dw, sw> { static Res run(u64 src) { return w2r<dw>(get<w2r<sw>>(src)); } };
-
 /*
  * bigger logic used by several ops
  */
@@ -501,12 +340,71 @@ const Def* normalize_Shr(const Def* type, const Def* c, const Def* arg, const De
             }
         }
 
-        if (lb->get() > *w) return world.bot(type, dbg);
+        if (auto width = mod2width(*w); width && lb->get() >= *width) return world.bot(type, dbg);
     }
 
     return world.raw_app(callee, {a, b}, dbg);
 }
 
+/*
+ * strength reduction
+ */
+
+/// @c 2^k * b -> b << k
+/// @p nuw carries over; @p nsw only if @c 2^k is positive as signed number.
+static const Def* reduce_mul(World& world, nat_t mode, const Def* b, u64 x, nat_t mod, const Def* dbg) {
+    auto width = mod2width(mod);
+    if (!width || !is_power_of_2(x)) return nullptr;
+
+    auto k = log2(x);
+    mode &= WMode::nuw | (k + 1 < *width ? nat_t(WMode::nsw) : nat_t(WMode::none));
+    return world.op(Wrap::shl, mode, b, world.lit_int(mod, k), dbg);
+}
+
+/// Replaces a division or remainder of @p a by the literal @p d by shifts, masks, or a multiplication with a magic number.
+/// The caller guarantees @c d ∉ {0, 1}: so, the Div can't trap and we can safely drop it.
+template<Div op>
+static const Def* reduce_div(World& world, const Def* a, u64 d, nat_t mod, const Def* dbg) {
+    auto width = mod2width(mod);
+    if (!width || *width == 1) return nullptr;
+
+    auto w = *width;
+    auto lit = [&](u64 val) { return world.lit_int(mod, val); };
+
+    if constexpr (op == Div::udiv || op == Div::urem) {
+        if (is_power_of_2(d)) {
+            if constexpr (op == Div::udiv) return world.op(Shr::lshr, a, lit(log2(d)), dbg); // a / 2^k -> a >> k
+            return world.op(Bit::_and, a, lit(d - 1), dbg);                                // a % 2^k -> a & (2^k - 1)
+        }
+
+        // a / d -> (zext(a) * m) >> s with m = ⌈2^s / d⌉ computed in twice the width
+        if (w > 32) return nullptr;
+        for (u64 s = w, max = 1_u64 << w; s < 2 * w; ++s) {
+            u64 p = 1_u64 << s;
+            u64 m = p / d + (p % d != 0 ? 1 : 0);
+            u64 e = m * d - p;
+            if (m > max || e * (max - 1) >= p) continue; // m too big or not exact for all a < 2^w
+
+            auto wide = world.type_int_width(2 * w);
+            auto prod = world.op(Wrap::mul, WMode::none, world.lit(wide, m), world.op(Conv::u2u, wide, a));
+            auto q    = world.op(Conv::u2u, a->type(), world.op(Shr::lshr, prod, world.lit(wide, s)), dbg);
+            if constexpr (op == Div::udiv) return q;
+            return world.op(Wrap::sub, WMode::none, a, world.op(Wrap::mul, WMode::none, lit(d), q), dbg); // a % d -> a - d * (a / d)
+        }
+    } else {
+        // only positive powers of two: a / 2^k -> (a + ((a >>s (w-1)) >>u (w-k))) >>s k
+        if (!is_power_of_2(d) || (d >> (w - 1)) & 1) return nullptr;
+
+        auto k    = log2(d);
+        auto bias = world.op(Shr::lshr, world.op(Shr::ashr, a, lit(w - 1)), lit(w - k));
+        auto q    = world.op(Shr::ashr, world.op(Wrap::add, WMode::none, a, bias), lit(k), dbg);
+        if constexpr (op == Div::sdiv) return q;
+        return world.op(Wrap::sub, WMode::none, a, world.op(Wrap::shl, WMode::none, q, lit(k)), dbg); // a % 2^k -> a - (a / 2^k << k)
+    }
+
+    return nullptr;
+}
+
 template<Wrap op>
 const Def* normalize_Wrap(const Def* type, const Def* c, const Def* arg, const Def* dbg) {
     auto& world = type->world();
@@ -550,7 +448,7 @@ const Def* normalize_Wrap(const Def* type, const Def* c, const Def* arg, const D
 
         if (op == Wrap::sub)
             return world.op(Wrap::add, *m, a, world.lit_int_mod(*w, ~lb->get() + 1_u64)); // a - lb -> a + (~lb + 1)
-        else if (op == Wrap::shl && lb->get() > *w)
+        else if (auto width = mod2width(*w); op == Wrap::shl && width && lb->get() >= *width)
             return world.bot(type, dbg);
     }
 
@@ -566,6 +464,10 @@ const Def* normalize_Wrap(const Def* type, const Def* c, const Def* arg, const D
 
     if (auto res = reassociate<Tag::Wrap>(op, world, callee, a, b, dbg)) return res;
 
+    if (auto la = a->isa<Lit>(); la && m && op == Wrap::mul) {
+        if (auto res = reduce_mul(world, *m, b, la->get(), *w, dbg)) return res;
+    }
+
     return world.raw_app(callee, {a, b}, dbg);
 }
 
@@ -596,6 +498,8 @@ const Def* normalize_Div(const Def* type, const Def* c, const Def* arg, const De
                 default: THORIN_UNREACHABLE;
             }
         }
+
+        if (auto res = reduce_div<op>(world, a, lb->get(), *w, dbg)) return make_res(res);
     }
 
     if (a == b) {
@@ -863,17 +767,94 @@ const Def* normalize_bitcast(const Def* dst_type, const Def* callee, const Def*
     return world.raw_app(callee, src, dbg);
 }
 
+/// Nested LEAs are not canonicalized into multi-dimensional indices or byte offsets - the IR has neither.
+/// CodeGen::emit_lea lowers a whole chain of them to a single GEP instead.
 const Def* normalize_lea(const Def* type, const Def* callee, const Def* arg, const Def* dbg) {
     auto& world = type->world();
     auto [ptr, index] = arg->projs<2>();
     auto [pointee, addr_space] = as<Tag::Ptr>(ptr->type())->args<2>();
 
     if (auto a = isa_lit(pointee->arity()); a && *a ==  1) return ptr;
-    //TODO
+    if (ptr->isa<Bot>() || index->isa<Bot>()) return world.bot(type, dbg);
 
     return world.raw_app(callee, {ptr, index}, dbg);
 }
 
+/*
+ * memory helpers
+ */
+
+/// Strips all @p LEA%s from @p ptr and records their indices - outermost first - in @p path; non-literal indices are recorded as @c std::nullopt.
+static const Def* lea_root(const Def* ptr, std::vector<std::optional<u64>>& path) {
+    while (auto lea = isa<Tag::LEA>(ptr)) {
+        auto [p, i] = lea->args<2>();
+        path.emplace_back(isa_lit(i));
+        ptr = p;
+    }
+    std::reverse(path.begin(), path.end());
+    return ptr;
+}
+
+/// Yields the @p Slot or @p Alloc, if @p ptr is the pointer obtained by one of those.
+static const Def* isa_fresh(const Def* ptr) {
+    if (auto extract = ptr->isa<Extract>()) {
+        auto tuple = extract->tuple();
+        if (isa<Tag::Slot>(tuple) || isa<Tag::Alloc>(tuple)) return tuple;
+    }
+    return nullptr;
+}
+
+/// @c true if @p p and @p q provably never alias.
+/// This is the case for pointers into different @p Slot%s/@p Alloc%s or if their @p LEA paths diverge at a literal index.
+static bool is_disjoint(const Def* p, const Def* q) {
+    std::vector<std::optional<u64>> p_path, q_path;
+    auto p_root = lea_root(p, p_path);
+    auto q_root = lea_root(q, q_path);
+    if (p_root != q_root) return isa_fresh(p_root) && isa_fresh(q_root);
+
+    for (size_t i = 0, e = std::min(p_path.size(), q_path.size()); i != e; ++i) {
+        if (!p_path[i] || !q_path[i]) return false;
+        if (*p_path[i] != *q_path[i]) return true;
+    }
+    return false; // one path is a prefix of the other
+}
+
+/// Walks up the mem chain starting at @p mem and skips all @p Load%s and all @p Store%s to pointers disjoint from @p ptr.
+/// Yields the value at @p ptr, if this walk hits a @p Store to @p ptr or the @p Slot/@p Alloc of @p ptr, and @c nullptr otherwise.
+static const Def* forward(const Def* mem, const Def* ptr) {
+    static constexpr size_t Max_Steps = 16; // keep this local - we are invoked for each Load/Store
+
+    std::vector<std::optional<u64>> path;
+    auto root = lea_root(ptr, path);
+    auto fresh = isa_fresh(root);
+
+    for (size_t n = 0; n != Max_Steps; ++n) {
+        if (auto store = isa<Tag::Store>(mem)) {
+            auto [m, p, v] = store->args<3>();
+            if (p == ptr) return v;
+            if (!is_disjoint(p, ptr)) return nullptr;
+            mem = m;
+        } else if (auto extract = mem->isa<Extract>()) {
+            auto tuple = extract->tuple();
+            if (auto load = isa<Tag::Load>(tuple)) {
+                mem = load->arg(0);
+            } else if (auto slot = isa<Tag::Slot>(tuple)) {
+                if (tuple == fresh) return ptr->world().bot(as<Tag::Ptr>(ptr->type())->arg(0));
+                mem = slot->arg(0);
+            } else if (auto alloc = isa<Tag::Alloc>(tuple)) {
+                if (tuple == fresh) return ptr->world().bot(as<Tag::Ptr>(ptr->type())->arg(0));
+                mem = alloc->arg();
+            } else {
+                return nullptr;
+            }
+        } else {
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
 const Def* normalize_load(const Def* type, const Def* callee, const Def* arg, const Def* dbg) {
     auto& world = type->world();
     auto [mem, ptr] = arg->projs<2>();
@@ -885,6 +866,9 @@ const Def* normalize_load(const Def* type, const Def* callee, const Def* arg, co
     if (auto sigma = pointee->isa<Sigma>(); sigma && sigma->num_ops() == 0)
         return world.tuple({mem, world.tuple(sigma->type(), {}, dbg)});
 
+    // store-to-load forwarding
+    if (auto val = forward(mem, ptr)) return world.tuple({mem, val}, dbg);
+
     return world.raw_app(callee, {mem, ptr}, dbg);
 }
 
@@ -906,6 +890,13 @@ const Def* normalize_store(const Def* type, const Def* callee, const Def* arg, c
             return mem;
     }
 
+    // the previous store to ptr is dead
+    if (auto store = isa<Tag::Store>(mem); store && store->arg(1) == ptr)
+        return world.op_store(store->arg(0), ptr, val, dbg);
+
+    // ptr already holds val
+    if (forward(mem, ptr) == val) return mem;
+
     return world.raw_app(callee, {mem, ptr, val}, dbg);
 }
 
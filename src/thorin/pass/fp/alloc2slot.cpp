@@ -0,0 +1,108 @@
+#include "thorin/pass/fp/alloc2slot.h"
+
+#include "thorin/analyses/scope.h"
+
+namespace thorin {
+
+/// Number of scalars in @p type or @c std::nullopt if the size of @p type is not known at compile time.
+static std::optional<u64> num_scalars(const Def* type) {
+    if (auto arr = type->isa<Arr>()) {
+        auto a = isa_lit(arr->shape());
+        auto n = num_scalars(arr->body());
+        if (a && n && !arr->isa_nom()) return *a * *n;
+        return {};
+    }
+
+    if (auto sigma = type->isa<Sigma>()) {
+        if (auto nom = sigma->isa_nom(); nom && nom->has_var()) return {}; // dependent
+        u64 result = 0;
+        for (auto op : sigma->ops()) {
+            auto n = num_scalars(op);
+            if (!n) return {};
+            result += *n;
+        }
+        return result;
+    }
+
+    return 1;
+}
+
+void Alloc2Slot::enter() {
+    auto lam = curr_nom();
+    if (!lam->is_returning() || fn_.contains(lam)) return;
+
+    // nested functions are entered later on and claim their basic blocks then
+    Scope scope(lam);
+    for (auto def : scope.bound()) {
+        if (auto bb = def->isa_nom<Lam>(); bb && !bb->is_returning()) fn_[bb] = lam;
+    }
+    fn_[lam] = lam;
+}
+
+const Def* Alloc2Slot::rewrite(const Def* def) {
+    if (auto alloc = isa<Tag::Alloc>(def); alloc && !keep_.contains(alloc) && !exhausted()) {
+        auto [type, as] = alloc->decurry()->args<2>();
+        if (auto n = num_scalars(type); !n || *n > Max_Scalars) return def;
+
+        // reuse the Slot after a roll back - other passes such as SSAConstr recognize it by its id
+        auto& slot = alloc2slot_[alloc];
+        if (slot == nullptr) {
+            slot = world().app(world().app(world().ax_slot(), {type, as}), {alloc->arg(), world().lit_nat(world().curr_gid())}, alloc->dbg());
+            slot2info_[slot] = {alloc, curr_nom(), func(curr_nom())};
+        }
+        world().DLOG("alloc '{}' -> slot '{}'", alloc, slot);
+        return slot;
+    }
+
+    return def;
+}
+
+const Def* Alloc2Slot::isa_slot(const Def* def) {
+    while (auto lea = isa<Tag::LEA>(def)) def = lea->arg(0);
+    if (auto extract = def->isa<Extract>(); extract && isa_lit(extract->index()) == 1) def = extract->tuple(); // the pointer - not the mem
+    return slot2info_.contains(def) ? def : nullptr;
+}
+
+const Def* Alloc2Slot::leaks(const Def* def) {
+    if (auto slot = isa_slot(def)) return slot;
+    if (def->isa<Tuple>()) {
+        for (auto op : def->ops())
+            if (auto slot = leaks(op)) return slot;
+    }
+    return nullptr;
+}
+
+undo_t Alloc2Slot::escape(const Def* slot, const Def* use) {
+    auto [alloc, lam, _] = slot2info_[slot];
+    if (!keep_.emplace(alloc).second) return No_Undo;
+
+    world().DLOG("keep '{}': escapes via '{}' within '{}'", alloc, use, curr_nom());
+    return undo_enter(lam);
+}
+
+undo_t Alloc2Slot::analyze(const Def* def) {
+    if (def->isa<Tuple>()) return No_Undo; // the consumer of the tuple decides
+
+    if (auto app = def->isa<App>()) {
+        if (isa<Tag::LEA>(app)) return No_Undo;
+        if (isa<Tag::Load>(app) || isa<Tag::Store>(app)) {
+            if (auto slot = isa_slot(app->arg(1)); slot && func(curr_nom()) != slot2info_[slot].func)
+                return escape(slot, def); // used within another function
+            if (auto store = isa<Tag::Store>(app); store && leaks(store->arg(2))) return escape(leaks(store->arg(2)), def);
+            return No_Undo;
+        }
+
+        if (auto slot = leaks(app->arg())) return escape(slot, def);
+        return No_Undo;
+    }
+
+    if (auto extract = def->isa<Extract>(); extract && slot2info_.contains(extract->tuple())) return No_Undo;
+
+    for (auto op : def->ops()) {
+        if (auto slot = leaks(op)) return escape(slot, def);
+    }
+
+    return No_Undo;
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef THORIN_PASS_FP_ALLOC2SLOT_H
+#define THORIN_PASS_FP_ALLOC2SLOT_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Escape analysis that promotes @p Alloc%s to @p Slot%s.
+/// Optimistically assumes that the pointer of each @p Alloc of fixed size never escapes and turns the @p Alloc into a @p Slot.
+/// A pointer escapes if it - or an @p LEA of it - is used for anything else than the address of a @p Load or @p Store,
+/// or if it is used within another function - i.e. a @p Lam whose enclosing returning @p Lam differs from the one that created the pointer.
+/// In this case, we roll back and keep the @p Alloc.
+/// As @p Slot%s end up in the entry block of their function, all promoted @p Alloc%s of a function share a single stack frame.
+/// Afterwards, @p SSAConstr may promote these @p Slot%s further to SSA values.
+class Alloc2Slot : public FPPass<Alloc2Slot, Lam> {
+public:
+    Alloc2Slot(PassMan& man)
+        : FPPass(man, "alloc2slot")
+    {}
+
+    using Data = std::tuple<>; ///< No state needed - see @p keep_.
+
+    static constexpr u64 Max_Scalars = 1024; ///< Larger @p Alloc%s stay on the heap.
+
+    /// Another pass - such as @p SROA - has split @p field off @p slot: if @p field escapes, so does the @p Alloc of @p slot.
+    void split(const Def* slot, const Def* field) {
+        if (auto info = slot2info_.lookup(slot)) slot2info_[field] = *info;
+    }
+
+private:
+    /// @name PassMan hooks
+    //@{
+    void enter() override;
+    const Def* rewrite(const Def*) override;
+    undo_t analyze(const Def*) override;
+    //@}
+
+    /// The returning @p Lam whose basic block @p lam is - or @p lam itself if we don't know.
+    Lam* func(Lam* lam) const { return fn_.lookup(lam).value_or(lam); }
+    /// Yields the @p Slot that @p def points into - possibly through some @p LEA%s - or @c nullptr.
+    const Def* isa_slot(const Def* def);
+    /// Yields a @p Slot whose pointer is contained in @p def or @c nullptr.
+    const Def* leaks(const Def* def);
+    undo_t escape(const Def* slot, const Def* use);
+
+    struct Info {
+        const Def* alloc;
+        Lam* lam;  ///< Where we've created the @p Slot.
+        Lam* func; ///< The function of @p lam.
+    };
+    Def2Def alloc2slot_;
+    DefMap<Info> slot2info_;
+    LamMap<Lam*> fn_; ///< Maps the basic blocks in the Scope%s of the returning @p Lam%s we've entered so far to their function.
+    DefSet keep_; ///< @p Alloc%s that escape.
+};
+
+}
+
+#endif
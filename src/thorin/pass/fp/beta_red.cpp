@@ -5,6 +5,8 @@
 namespace thorin {
 
 const Def* BetaRed::rewrite(const Def* def) {
+    if (exhausted()) return def;
+
     if (auto app = def->isa<App>()) {
         if (auto lam = app->callee()->isa_nom<Lam>(); !ignore(lam) && !keep_.contains(lam)) {
             if (auto [_, ins] = data().emplace(lam); ins) {
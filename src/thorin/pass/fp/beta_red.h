@@ -14,7 +14,7 @@ public:
         : FPPass(man, "beta_red")
     {}
 
-    using Data = LamSet;
+    using Data = PersistentGIDSet<Lam*>;
 
     void keep(Lam* lam) { keep_.emplace(lam); }
 
@@ -15,7 +15,7 @@ const Def* CopyProp::rewrite(const Def* def) {
 }
 
 const Def* CopyProp::var2prop(const App* app, Lam* var_lam) {
-    if (ignore(var_lam) || var_lam->num_vars() == 0 || keep_.contains(var_lam)) return app;
+    if (ignore(var_lam) || var_lam->num_vars() == 0 || keep_.contains(var_lam) || exhausted()) return app;
 
     auto& args = data(var_lam);
     args.resize(app->num_args());
@@ -19,7 +19,7 @@ public:
         , eta_exp_(eta_exp)
     {}
 
-    using Data = LamMap<DefVec>;
+    using Data = PersistentGIDMap<Lam*, DefVec>;
 
 private:
     /// @name PassMan hooks
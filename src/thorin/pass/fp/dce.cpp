@@ -24,7 +24,7 @@ const Def* DCE::rewrite(const Def* def) {
 }
 
 const Def* DCE::var2dead(const App* app, Lam* var_lam) {
-    if (ignore(var_lam) || var_lam->num_vars() == 0 || keep_.contains(var_lam)) return app;
+    if (ignore(var_lam) || var_lam->num_vars() == 0 || keep_.contains(var_lam) || exhausted()) return app;
 
     DefVec new_args;
     DefVec types;
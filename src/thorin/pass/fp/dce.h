@@ -18,7 +18,7 @@ public:
         , eta_exp_(eta_exp)
     {}
 
-    using Data = LamSet;
+    using Data = PersistentGIDSet<Lam*>;
 
 private:
     /// @name PassMan hooks
@@ -0,0 +1,39 @@
+#include "thorin/pass/fp/dse.h"
+
+namespace thorin {
+
+const Proxy* DSE::isa_sloxy(const Def* ptr) {
+    while (auto lea = isa<Tag::LEA>(ptr)) ptr = lea->arg(0);
+    return isa_proxy(ptr);
+}
+
+const Def* DSE::rewrite(const Def* def) {
+    if (auto slot = isa<Tag::Slot>(def)) {
+        auto [mem, id] = slot->args<2>();
+        auto [_, ptr] = slot->projs<2>();
+        auto sloxy = proxy(ptr->type(), {curr_nom(), id}, 0, slot->dbg());
+        if (!keep_.contains(sloxy) && !exhausted()) {
+            world().DLOG("sloxy: '{}'", sloxy);
+            return world().tuple({mem, sloxy});
+        }
+    } else if (auto store = isa<Tag::Store>(def)) {
+        auto [mem, ptr, val] = store->args<3>();
+        if (auto sloxy = isa_sloxy(ptr)) {
+            world().DLOG("dead store to '{}': '{}'", sloxy, store);
+            return mem;
+        }
+    }
+
+    return def;
+}
+
+undo_t DSE::analyze(const Proxy* sloxy) {
+    if (keep_.emplace(sloxy).second) {
+        world().DLOG("keep: '{}'; slot is read", sloxy);
+        return undo_enter(sloxy->op(0)->as_nom<Lam>());
+    }
+
+    return No_Undo;
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef THORIN_PASS_FP_DSE_H
+#define THORIN_PASS_FP_DSE_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Dead Store Elimination.
+/// Optimistically assumes that no @p Slot is ever read and removes all @p Store%s to it - also through @p LEA%s.
+/// As soon as the pointer of such a @p Slot is needed for anything else, we roll back and keep its @p Store%s.
+/// Overwritten @p Store%s and @p Store%s of values already present are removed by the normalizers of @p Load and @p Store.
+class DSE : public FPPass<DSE, Lam> {
+public:
+    DSE(PassMan& man)
+        : FPPass(man, "dse")
+    {}
+
+    using Data = std::tuple<>; ///< No state needed - see @p keep_.
+
+private:
+    /// @name PassMan hooks
+    //@{
+    const Def* rewrite(const Def*) override;
+    undo_t analyze(const Proxy*) override;
+    //@}
+
+    /// Yields the proxy for the @p Slot @p ptr points into - possibly through some @p LEA%s.
+    const Proxy* isa_sloxy(const Def* ptr);
+
+    /// Contains the proxies of @p Slot%s that are read.
+    GIDSet<const Proxy*> keep_;
+};
+
+}
+
+#endif
@@ -95,6 +95,9 @@ undo_t EtaExp::analyze(const Proxy* proxy) {
 }
 
 undo_t EtaExp::analyze(const Def* def) {
+    // requests of other passes via proxy are still served - they resolve speculation that is already pending
+    if (exhausted()) return No_Undo;
+
     auto undo = No_Undo;
     for (size_t i = 0, e = def->num_ops(); i != e; ++i) {
         if (auto lam = def->op(i)->isa_nom<Lam>(); lam && lam->is_set()) {
@@ -41,7 +41,7 @@ public:
     static const char* lattice2str(Lattice l) { return l == Callee ? "Callee" : "Non_Callee_1"; }
     //@}
 
-    using Data = LamMap<Lattice>;
+    using Data = PersistentGIDMap<Lam*, Lattice>;
 
 private:
     /// @name PassMan hooks
@@ -19,7 +19,7 @@ public:
         Irreducible, ///< η-reduction not possible as we stumbled upon a Var.
     };
 
-    using Data = LamMap<Lattice>;
+    using Data = PersistentGIDMap<Lam*, Lattice>;
     void mark_irreducible(Lam* lam) { irreducible_.emplace(lam); }
 
 private:
@@ -0,0 +1,108 @@
+#include "thorin/pass/fp/inliner.h"
+
+#include "thorin/analyses/looptree.h"
+
+namespace thorin {
+
+void Inliner::enter() {
+    if (!loop_depth_.contains(curr_nom())) find_loops(curr_nom());
+    last_gid_ = world().curr_gid();
+}
+
+void Inliner::find_loops(Def* nom) {
+    // nom may be a copy made by an inlining or another pass - so (re)compute the loops of the top-level Scope around it
+    for (auto curr = nom;;) {
+        Scope scope(curr);
+        if (const auto& vars = scope.free_vars(); !vars.empty()) {
+            if (auto lam = (*vars.begin())->nom()->isa_nom<Lam>(); lam && lam->is_set()) {
+                curr = lam;
+                continue;
+            }
+        }
+
+        const auto& cfg = scope.f_cfg();
+        for (auto n : cfg.reverse_post_order()) {
+            if (auto leaf = cfg.looptree()[n]) {
+                loop_depth_[n->nom()] = leaf->depth() - 1; // top-level Leaf%s have depth 1
+                if (!leaf->parent()->is_root()) {
+                    for (auto head : leaf->parent()->cf_nodes()) headers_.emplace(head->nom());
+                }
+            }
+        }
+        break;
+    }
+
+    loop_depth_.emplace(nom, 0); // in case nom isn't part of the CFG
+}
+
+const Def* Inliner::rewrite(const Def* def) {
+    if (exhausted()) return def;
+
+    auto app = def->isa<App>();
+    if (app == nullptr) return def;
+
+    auto lam = app->callee()->isa_nom<Lam>();
+    if (ignore(lam) || lam == curr_nom()) return def;
+    // a copy made while rewriting curr_nom isn't part of curr_nom's CFG yet - so we can't tell whether it's a loop header
+    if (lam->gid() > last_gid_) return def;
+    if (!loop_depth_.contains(lam)) find_loops(lam);
+    if (headers_.contains(lam)) return def;       // don't unroll loops
+    if (lam->cc() == Lam::CC::Device) return def; // kernels stay kernels - whatever their threshold
+
+    auto lit_bonus = 0_s;
+    for (size_t i = 0, e = app->num_args(); i != e; ++i)
+        if (app->arg(i)->isa<Lit>()) lit_bonus += Lit_Bonus;
+    auto limit = threshold(lam->cc());
+    if (auto depth = loop_depth_.lookup(curr_nom())) limit += Loop_Bonus * *depth;
+
+    // estimate without instantiating lam: we assume that each Lit folds Lit_Bonus Def%s away
+    auto estimate = size(lam) - std::min(size(lam), lit_bonus);
+    if (estimate > limit || data() + estimate > growth_) return def;
+
+    // charge what the instantiation actually adds - the nested noms are instantiated as well and we assume that they don't shrink
+    auto body  = lam->apply(app->arg()).back();
+    auto added = size(lam) - count(lam->body(), lam->var()) + count(body, app->arg());
+    world().DLOG("inline '{}' into '{}': {} Def%s added", lam, curr_nom(), added);
+    data() += added;
+    return body;
+}
+
+size_t Inliner::size(Lam* lam) {
+    if (auto size = size_.lookup(lam)) return *size;
+
+    Scope scope(lam);
+    size_t size = 0;
+    for (auto def : scope.bound()) {
+        if (auto app = def->isa<App>(); app && app->callee() == lam) { // don't unroll recursion
+            size = std::numeric_limits<size_t>::max();
+            break;
+        }
+        if (!def->no_dep()) ++size;
+    }
+
+    return size_[lam] = size;
+}
+
+size_t Inliner::count(const Def* def, const Def* arg) const {
+    DefSet done = {arg};
+    if (arg->isa<Tuple>()) done.insert(arg->ops().begin(), arg->ops().end());
+
+    size_t result = 0;
+    std::vector<const Def*> stack;
+    auto push = [&](const Def* def) {
+        if (def == nullptr || def->isa_nom() || def->no_dep() || !done.emplace(def).second) return;
+        if (auto extract = def->isa<Extract>(); extract && extract->tuple() == arg) return;
+        stack.emplace_back(def);
+    };
+
+    for (push(def); !stack.empty();) {
+        auto def = stack.back();
+        stack.pop_back();
+        ++result;
+        for (auto op : def->ops()) push(op);
+    }
+
+    return result;
+}
+
+}
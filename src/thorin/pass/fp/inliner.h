@@ -0,0 +1,63 @@
+#ifndef THORIN_PASS_FP_INLINER_H
+#define THORIN_PASS_FP_INLINER_H
+
+#include <array>
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Inlines calls of @p Lam%s that occur more than once - as opposed to @p BetaRed - based on a cost model.
+/// The cost of inlining <code>f e</code> is the number of Def%s in @p f's Scope; each loop around the call site raises the threshold of @p f's Lam::CC by a bonus.
+/// We estimate this cost without instantiating @p f by assuming that each @p Lit in @p e folds away a few Def%s.
+/// The Inliner decides on this estimate alone and never speculates - it doesn't cause any roll backs.
+/// The Def%s the instantiations actually add are charged against a growth budget that is kept in the current State - so a roll back of another pass refunds them.
+/// Neither loop headers nor @p Lam%s with Lam::CC::Device are inlined.
+/// The loops are those of the top-level Scope around a @em nom; they are recomputed whenever the Inliner meets a @em nom it doesn't know yet.
+class Inliner : public FPPass<Inliner, Lam> {
+public:
+    Inliner(PassMan& man)
+        : FPPass(man, "inliner")
+    {
+        thresholds_[size_t(Lam::CC::C)]      = 32;
+        thresholds_[size_t(Lam::CC::Device)] = 0; // unused - see rewrite
+    }
+
+    using Data = size_t; ///< Number of Def%s all inlinings up to the current State have added.
+
+    static constexpr size_t Lit_Bonus  = 4; ///< Def%s a @p Lit argument is assumed to fold away.
+    static constexpr size_t Loop_Bonus = 8; ///< Per loop around the call site.
+
+    /// @name configuration
+    //@{
+    size_t threshold(Lam::CC cc) const { return thresholds_[size_t(cc)]; }
+    void set_threshold(Lam::CC cc, size_t threshold) { thresholds_[size_t(cc)] = threshold; }
+    size_t growth() const { return growth_; }
+    /// Limits the number of Def%s all inlinings together may add.
+    void set_growth(size_t growth) { growth_ = growth; }
+    //@}
+
+private:
+    /// @name PassMan hooks
+    //@{
+    void enter() override;
+    const Def* rewrite(const Def*) override;
+    //@}
+
+    /// Computes the loop depths and headers in the top-level Scope around @p nom.
+    void find_loops(Def* nom);
+    size_t size(Lam*);
+    /// Number of structural Def%s reachable from @p def - apart from @p arg and its projections; @em noms are not entered.
+    size_t count(const Def* def, const Def* arg) const;
+
+    std::array<size_t, 2> thresholds_;
+    size_t growth_ = 1024;
+    DefMap<size_t> size_;       ///< Memoizes size.
+    DefMap<size_t> loop_depth_; ///< Loop depth of all @em noms found so far.
+    DefSet headers_;            ///< Loop headers among these @em noms - size only catches direct recursion.
+    u32 last_gid_ = 0;          ///< World::curr_gid when entering PassMan::curr_nom.
+};
+
+}
+
+#endif
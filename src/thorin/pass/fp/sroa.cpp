@@ -0,0 +1,87 @@
+#include "thorin/pass/fp/sroa.h"
+
+#include "thorin/pass/fp/alloc2slot.h"
+
+namespace thorin {
+
+/// Yields the arity if SROA splits a @p Slot of @p type.
+static std::optional<nat_t> isa_aggregate(const Def* type) {
+    if (auto sigma = type->isa<Sigma>(); sigma && sigma->num_ops() > 1 && (!sigma->isa_nom() || !sigma->isa_nom()->has_var()))
+        return sigma->num_ops();
+    if (auto arr = type->isa<Arr>(); arr && !arr->isa_nom()) {
+        if (auto a = isa_lit(arr->shape()); a && *a > 1 && *a <= SROA::Max_Arity) return *a;
+    }
+    return {};
+}
+
+const SROA::Split* SROA::isa_split(const Def* ptr) {
+    if (auto proxy = isa_proxy(ptr)) {
+        if (auto i = splits_.find(proxy); i != splits_.end()) return &i->second;
+    }
+    return nullptr;
+}
+
+const Def* SROA::rewrite(const Def* def) {
+    if (auto slot = isa<Tag::Slot>(def)) {
+        auto [type, as] = slot->decurry()->args<2>();
+        auto [mem, id] = slot->args<2>();
+        auto a = isa_aggregate(type);
+        if (!a) return def;
+
+        auto ptr = slot->proj(2_s, 1_s);
+        auto sroaxy = proxy(ptr->type(), {curr_nom(), id, world().lit_nat(slot->gid())}, 0, slot->dbg());
+        if (keep_.contains(sroaxy) || exhausted()) return def;
+
+        auto i = splits_.find(sroaxy);
+        if (i == splits_.end()) {
+            Split split{mem, {}};
+            for (size_t j = 0; j != *a; ++j) {
+                auto field = world().app(world().app(world().ax_slot(), {type->proj(*a, j), as}), {split.mem, world().lit_nat(world().curr_gid())}, slot->dbg());
+                if (alloc2slot_) alloc2slot_->split(def, field);
+                auto [m, p] = field->projs<2>();
+                split.mem = m;
+                split.ptrs.emplace_back(p);
+            }
+            i = splits_.emplace(sroaxy, std::move(split)).first;
+        }
+
+        world().DLOG("split '{}' into {} slots", slot, *a);
+        return world().tuple({i->second.mem, sroaxy});
+    } else if (auto lea = isa<Tag::LEA>(def)) {
+        auto [ptr, index] = lea->args<2>();
+        if (auto split = isa_split(ptr)) {
+            if (auto i = isa_lit(index)) return split->ptrs[*i];
+        }
+    } else if (auto load = isa<Tag::Load>(def)) {
+        auto [mem, ptr] = load->args<2>();
+        if (auto split = isa_split(ptr)) {
+            DefArray vals(split->ptrs.size());
+            for (size_t i = 0, e = vals.size(); i != e; ++i) {
+                auto [m, v] = world().op_load(mem, split->ptrs[i], load->dbg())->projs<2>();
+                mem = m;
+                vals[i] = v;
+            }
+            return world().tuple({mem, world().tuple(as<Tag::Ptr>(ptr->type())->arg(0), vals)});
+        }
+    } else if (auto store = isa<Tag::Store>(def)) {
+        auto [mem, ptr, val] = store->args<3>();
+        if (auto split = isa_split(ptr)) {
+            auto a = split->ptrs.size();
+            for (size_t i = 0; i != a; ++i) mem = world().op_store(mem, split->ptrs[i], val->proj(a, i), store->dbg());
+            return mem;
+        }
+    }
+
+    return def;
+}
+
+undo_t SROA::analyze(const Proxy* sroaxy) {
+    if (keep_.emplace(sroaxy).second) {
+        world().DLOG("keep: '{}'; pointer needed", sroaxy);
+        return undo_enter(sroaxy->op(0)->as_nom<Lam>());
+    }
+
+    return No_Undo;
+}
+
+}
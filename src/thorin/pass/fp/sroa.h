@@ -0,0 +1,50 @@
+#ifndef THORIN_PASS_FP_SROA_H
+#define THORIN_PASS_FP_SROA_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+class Alloc2Slot;
+
+/// Scalar Replacement of Aggregates.
+/// Optimistically splits each @p Slot of a non-dependent @p Sigma or of an @p Arr with a small @p Lit arity into one @p Slot per field.
+/// @p LEA%s with a @p Lit index yield the pointer to the field's @p Slot; @p Load%s and @p Store%s of the whole aggregate become one per field.
+/// Nested aggregates are split recursively as the new @p Slot%s are subject to this pass as well.
+/// As soon as the pointer of such a @p Slot is needed for anything else - e.g. an @p LEA with a non-constant index - we roll back and keep the @p Slot.
+/// Run this pass before @p SSAConstr to promote the fields to SSA values.
+/// If @p Alloc2Slot runs as well, we tell it about the new @p Slot%s - their pointers may still escape.
+class SROA : public FPPass<SROA, Lam> {
+public:
+    SROA(PassMan& man, Alloc2Slot* alloc2slot = nullptr)
+        : FPPass(man, "sroa")
+        , alloc2slot_(alloc2slot)
+    {}
+
+    using Data = std::tuple<>; ///< No state needed - see @p keep_.
+
+    static constexpr nat_t Max_Arity = 16; ///< Larger @p Arr%s are not split.
+
+private:
+    /// @name PassMan hooks
+    //@{
+    const Def* rewrite(const Def*) override;
+    undo_t analyze(const Proxy*) override;
+    //@}
+
+    struct Split {
+        const Def* mem; ///< After all @p Slot%s of the fields.
+        DefVec ptrs;    ///< One per field.
+    };
+
+    /// Yields the Split if @p ptr is a proxy of this pass.
+    const Split* isa_split(const Def* ptr);
+
+    Alloc2Slot* alloc2slot_;
+    GIDMap<const Proxy*, Split> splits_; ///< Memoized, so we come up with the same @p Slot%s after a roll back.
+    GIDSet<const Proxy*> keep_;          ///< Contains the proxies of @p Slot%s whose pointers are needed.
+};
+
+}
+
+#endif
@@ -28,7 +28,7 @@ const Def* SSAConstr::rewrite(const Def* def) {
         auto [_, ptr] = slot->projs<2>();
         auto sloxy = proxy(ptr->type(), {curr_nom(), id}, Sloxy, slot->dbg());
         world().DLOG("sloxy: '{}'", sloxy);
-        if (!keep_.contains(sloxy)) {
+        if (!keep_.contains(sloxy) && !exhausted()) {
             set_val(curr_nom(), sloxy, world().bot(get_sloxy_type(sloxy)));
             data(curr_nom()).writable.emplace(sloxy);
             return world().tuple({mem, sloxy});
@@ -26,10 +26,10 @@ public:
 
     struct Info {
         Lam* pred = nullptr;
-        GIDSet<const Proxy*> writable;
+        PersistentGIDSet<const Proxy*> writable;
     };
 
-    using Data = std::map<Lam*, Info, GIDLt<Lam*>>;
+    using Data = PersistentGIDMap<Lam*, Info>;
 
 private:
     /// @name PassMan hooks
@@ -0,0 +1,297 @@
+#include "thorin/pass/fp/value_range.h"
+
+#include "thorin/util/bit.h"
+
+namespace thorin {
+
+using Val = ValueRange::Val;
+
+static u64 mask(nat_t w) { return w == 64 ? u64(-1) : (1_u64 << w) - 1_u64; }
+
+/// All bits from the most significant set bit of @p x downwards.
+static u64 smear(u64 x) {
+    for (u64 i = 1; i != 64; i <<= 1_u64) x |= x >> i;
+    return x;
+}
+
+/// The run of set bits in @p x that starts at bit @c 0.
+static u64 low_run(u64 x) { return x & ~(x + 1_u64); }
+
+static std::optional<nat_t> isa_width(const Def* type) {
+    if (auto int_ = isa<Tag::Int>(type)) {
+        if (auto mod = isa_lit(int_->arg())) return mod2width(*mod);
+    }
+    return {};
+}
+
+/*
+ * Val
+ */
+
+Val Val::top(nat_t w) { return {0, 0, 0, mask(w)}; }
+Val Val::lit(nat_t w, u64 val) { return {~val & mask(w), val, val, val}; }
+
+Val Val::join(const Val& other) const {
+    return {zeros & other.zeros, ones & other.ones, std::min(lo, other.lo), std::max(hi, other.hi)};
+}
+
+std::optional<Val> Val::tighten(nat_t w) const {
+    auto m = mask(w);
+    auto v = *this;
+    v.zeros &= m;
+    v.ones  &= m;
+    if (v.zeros & v.ones) return {};
+
+    v.lo = std::max(v.lo, v.ones);
+    v.hi = std::min(v.hi, m & ~v.zeros);
+    if (v.lo > v.hi) return {};
+
+    // all values in [lo, hi] share the leading bits of lo and hi
+    auto prefix = m & ~smear(v.lo ^ v.hi);
+    v.ones  |=  v.lo & prefix;
+    v.zeros |= ~v.lo & prefix;
+    return v;
+}
+
+static bool must_neg(const Val& v, nat_t w) { return v.ones  & (1_u64 << (w - 1_u64)); }
+static bool must_pos(const Val& v, nat_t w) { return v.zeros & (1_u64 << (w - 1_u64)); }
+
+/*
+ * transfer functions
+ */
+
+std::optional<bool> ValueRange::transfer(ICmp cmp, const Val& a, const Val& b, nat_t w) {
+    bool can_true = false, can_false = false;
+    auto may = [&](ICmp c, bool possible) {
+        if (possible) ((cmp & c) != ICmp::_f ? can_true : can_false) = true;
+    };
+
+    // see Fold<ICmp, cmp, w>
+    may(ICmp::_x, !must_neg(a, w) && !must_pos(b, w));
+    may(ICmp::_y, !must_pos(a, w) && !must_neg(b, w));
+    may(ICmp::_g, a.hi > b.lo && !(must_neg(a, w) && must_pos(b, w)));
+    may(ICmp::_l, a.lo < b.hi && !(must_pos(a, w) && must_neg(b, w)));
+    may(ICmp:: e, a.lo <= b.hi && b.lo <= a.hi && !(a.ones & b.zeros) && !(a.zeros & b.ones));
+
+    if (can_true != can_false) return can_true;
+    return {};
+}
+
+Val ValueRange::transfer(Div div, const Val& a, const Val& b, nat_t w) {
+    if (b.lo == 0) return Val::top(w); // may trap
+    switch (div) {
+        case Div::udiv: return {0, 0, a.lo / b.hi, a.hi / b.lo};
+        case Div::urem: return a.hi < b.lo ? a : Val{0, 0, 0, std::min(a.hi, b.hi - 1_u64)};
+        default:        return Val::top(w);
+    }
+}
+
+Val ValueRange::transfer(Wrap wrap, const Val& a, const Val& b, nat_t w) {
+    auto m   = mask(w);
+    auto res = Val::top(w);
+    switch (wrap) {
+        case Wrap::add: {
+            if (a.hi <= m - b.hi) res.lo = a.lo + b.lo, res.hi = a.hi + b.hi;
+            // the low bits known in both operands are known in the sum as well
+            auto known = low_run((a.zeros | a.ones) & (b.zeros | b.ones));
+            auto sum = a.ones + b.ones;
+            res.zeros = ~sum & known;
+            res.ones  =  sum & known;
+            return res;
+        }
+        case Wrap::sub: {
+            if (a.lo >= b.hi) res.lo = a.lo - b.hi, res.hi = a.hi - b.lo;
+            auto known = low_run((a.zeros | a.ones) & (b.zeros | b.ones));
+            auto diff = a.ones - b.ones;
+            res.zeros = ~diff & known;
+            res.ones  =  diff & known;
+            return res;
+        }
+        case Wrap::mul: {
+            if (b.hi == 0 || a.hi <= m / b.hi) res.lo = a.lo * b.lo, res.hi = a.hi * b.hi;
+            // trailing zeros add up
+            auto tz = bitcount(low_run(a.zeros)) + bitcount(low_run(b.zeros));
+            res.zeros = tz >= w ? m : mask(tz);
+            return res;
+        }
+        case Wrap::shl: {
+            if (!b.is_lit() || b.lo >= w) return res;
+            auto k = b.lo;
+            if (a.hi <= m >> k) res.lo = a.lo << k, res.hi = a.hi << k;
+            res.zeros = (a.zeros << k) | mask(k);
+            res.ones  =  a.ones  << k;
+            return res;
+        }
+        default: THORIN_UNREACHABLE;
+    }
+}
+
+Val ValueRange::transfer(Shr shr, const Val& a, const Val& b, nat_t w) {
+    auto m = mask(w);
+    if (!b.is_lit() || b.lo >= w) return Val::top(w);
+    // for non-negative values ashr and lshr coincide
+    if (shr == Shr::ashr && !must_pos(a, w)) return Val::top(w);
+    auto k = b.lo;
+    return {(a.zeros >> k) | (m & ~(m >> k)), a.ones >> k, a.lo >> k, a.hi >> k};
+}
+
+Val ValueRange::transfer(Bit bit, const Val& a, const Val& b, nat_t w) {
+    auto m = mask(w);
+    switch (bit) {
+        case Bit::_and: return {a.zeros | b.zeros, a.ones & b.ones, 0, std::min(a.hi, b.hi)};
+        case Bit:: _or: return {a.zeros & b.zeros, a.ones | b.ones, std::max(a.lo, b.lo), m};
+        case Bit::_xor: return {(a.zeros & b.zeros) | (a.ones & b.ones), (a.zeros & b.ones) | (a.ones & b.zeros), 0, m};
+        default:        return Val::top(w);
+    }
+}
+
+/*
+ * ValueRange
+ */
+
+void ValueRange::enter() { cache_.clear(); }
+
+std::optional<Val> ValueRange::value(const Def* def, size_t depth) {
+    auto w = isa_width(def->type());
+    if (!w) return {};
+    if (depth > Max_Depth) return Val::top(*w);
+    if (auto val = cache_.lookup(def)) return val;
+
+    auto val = transfer(def, *w, depth).tighten(*w).value_or(Val::top(*w));
+    return cache_[def] = val;
+}
+
+Val ValueRange::transfer(const Def* def, nat_t w, size_t depth) {
+    auto m   = mask(w);
+    auto top = Val::top(w);
+    auto get = [&](const Def* def) { return value(def, depth + 1).value_or(top); };
+
+    if (auto lit = isa_lit(def)) return Val::lit(w, *lit);
+    if (auto val = var2val_.lookup(def)) return exhausted() ? top : *val;
+
+    if (auto wrap = isa<Tag::Wrap>(def)) return transfer(wrap.flags(), get(wrap->arg(0)), get(wrap->arg(1)), w);
+    if (auto shr  = isa<Tag::Shr >(def)) return transfer(shr .flags(), get(shr ->arg(0)), get(shr ->arg(1)), w);
+    if (auto bit  = isa<Tag::Bit >(def)) return transfer(bit .flags(), get(bit ->arg(0)), get(bit ->arg(1)), w);
+
+    if (auto icmp = isa<Tag::ICmp>(def)) {
+        auto [x, y] = icmp->args<2>();
+        auto a = value(x, depth + 1), b = value(y, depth + 1);
+        if (a && b) {
+            if (auto res = transfer(icmp.flags(), *a, *b, *isa_width(x->type()))) return Val::lit(w, *res);
+        }
+    } else if (auto conv = isa<Tag::Conv>(Conv::u2u, def)) {
+        if (auto a = value(conv->arg(), depth + 1)) {
+            auto sm = mask(*isa_width(conv->arg()->type()));
+            if (a->hi <= m) return {(a->zeros & m) | (m & ~sm), a->ones, a->lo, a->hi};
+            return {a->zeros & m, a->ones & m, 0, m};
+        }
+    } else if (auto extract = def->isa<Extract>()) {
+        if (auto div = isa<Tag::Div>(extract->tuple()); div && isa_lit(extract->index()) == 1_u64)
+            return transfer(div.flags(), get(div->arg(1)), get(div->arg(2)), w);
+    }
+
+    return top;
+}
+
+const Def* ValueRange::rewrite(const Def* def) {
+    if (def->isa<Lit>()) return def;
+
+    if (auto div = isa<Tag::Div>(def)) {
+        auto [mem, x, y] = div->args<3>();
+        auto a = value(x), b = value(y);
+        // the divisor can't be 0 - so we can drop the side effect as soon as we know the result
+        if (a && b && b->lo != 0) {
+            auto w = *isa_width(x->type());
+            if (auto res = transfer(div.flags(), *a, *b, w).tighten(w); res && res->is_lit()) {
+                world().DLOG("fold '{}' to '{}'", div, res->lo);
+                return world().tuple({mem, world().lit(x->type(), res->lo)}, div->dbg());
+            }
+            if (div.flags() == Div::urem && a->hi < b->lo) {
+                world().DLOG("fold '{}' to '{}'", div, x);
+                return world().tuple({mem, x}, div->dbg());
+            }
+        }
+    } else if (auto val = value(def); val && val->is_lit()) {
+        world().DLOG("fold '{}' to '{}'", def, val->lo);
+        return world().lit(def->type(), val->lo, def->dbg());
+    } else if (auto op = operand(def)) {
+        world().DLOG("fold '{}' to '{}'", def, op);
+        return op;
+    }
+
+    return def;
+}
+
+const Def* ValueRange::operand(const Def* def) {
+    if (!isa<Tag::Wrap>(def) && !isa<Tag::Shr>(def) && !isa<Tag::Bit>(def)) return nullptr;
+
+    auto [x, y] = def->as<App>()->args<2>();
+    auto a = value(x), b = value(y);
+    if (!a || !b) return nullptr;
+
+    auto m = mask(*isa_width(x->type()));
+    auto is = [](const Val& v, u64 n) { return v.is_lit() && v.lo == n; };
+
+    if (auto wrap = isa<Tag::Wrap>(def)) {
+        switch (wrap.flags()) {
+            case Wrap::add: return is(*a, 0) ? y : is(*b, 0) ? x : nullptr;
+            case Wrap::mul: return is(*a, 1) ? y : is(*b, 1) ? x : nullptr;
+            case Wrap::sub:
+            case Wrap::shl: return is(*b, 0) ? x : nullptr;
+            default: THORIN_UNREACHABLE;
+        }
+    } else if (isa<Tag::Shr>(def)) {
+        return is(*b, 0) ? x : nullptr;
+    } else if (auto bit = isa<Tag::Bit>(def)) {
+        // the bits that may be 1 in one operand are known in the other one
+        switch (bit.flags()) {
+            case Bit::_and: return (m & ~a->zeros & ~b->ones) == 0 ? x : (m & ~b->zeros & ~a->ones) == 0 ? y : nullptr;
+            case Bit:: _or: return (m & ~b->zeros & ~a->ones) == 0 ? x : (m & ~a->zeros & ~b->ones) == 0 ? y : nullptr;
+            case Bit::_xor: return is(*b, 0) ? x : is(*a, 0) ? y : nullptr;
+            default:        return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+undo_t ValueRange::join(Lam* lam, size_t i, std::optional<Val> val) {
+    auto var = lam->var(i);
+    auto w = isa_width(var->type());
+    if (!w) return No_Undo;
+
+    auto arg = val.value_or(Val::top(*w));
+    auto [entry, inserted] = var2val_.emplace(var, arg);
+    if (inserted) {
+        // until now, value assumed ⊤ for var
+        cache_.clear();
+        return No_Undo;
+    }
+
+    auto& old = entry->second;
+    auto res = old.join(arg);
+    if (res == old) return No_Undo;
+
+    if (++grow_[var] > Max_Grow) res.lo = 0, res.hi = mask(*w);
+    world().DLOG("grow '{}': [{}, {}] -> [{}, {}]", var, old.lo, old.hi, res.lo, res.hi);
+    old = res;
+    cache_.clear();
+    return undo_visit(lam);
+}
+
+undo_t ValueRange::analyze(const Def* def) {
+    auto undo = No_Undo;
+    for (size_t i = 0, e = def->num_ops(); i != e; ++i) {
+        auto lam = def->op(i)->isa_nom<Lam>();
+        if (ignore(lam)) continue;
+
+        // a Lam that escapes may be invoked with anything
+        auto app = isa_callee(def, i);
+        for (size_t j = 0, n = lam->num_vars(); j != n; ++j)
+            undo = std::min(undo, join(lam, j, app ? value(app->arg(j)) : std::nullopt));
+    }
+
+    return undo;
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef THORIN_PASS_FP_VALUE_RANGE_H
+#define THORIN_PASS_FP_VALUE_RANGE_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Sparse known-bits and value-range analysis for @p Int%s.
+/// The @p Var%s of each @p Lam start at ⊥ and are joined with the arguments of all its direct calls - a @p Lam that escapes gets ⊤ @p Var%s.
+/// Whenever the Val of a @p Var grows, we roll back to the point where its @p Lam has been visited.
+/// With these facts, this pass folds @p ICmp%s - the normalizer of @p Extract then drops impossible branch arms -,
+/// replaces @p Int%s with a known value by @p Lit%s, drops operations like <tt>x & 15</tt> for <tt>x < 16</tt>, and removes @p Div%s whose result is known and whose divisor can't be @c 0.
+class ValueRange : public FPPass<ValueRange, Lam> {
+public:
+    ValueRange(PassMan& man)
+        : FPPass(man, "value_range")
+    {}
+
+    /// Lattice element for an @p Int of power-of-two width.
+    /// Both components describe the same set of values and are kept consistent with each other.
+    struct Val {
+        u64 zeros = 0; ///< Bits known to be @c 0.
+        u64 ones  = 0; ///< Bits known to be @c 1.
+        u64 lo    = 0; ///< Unsigned lower bound.
+        u64 hi    = 0; ///< Unsigned upper bound.
+
+        static Val top(nat_t width);
+        static Val lit(nat_t width, u64 val);
+        bool is_lit() const { return lo == hi; }
+        Val join(const Val&) const;
+        /// Derives known bits from the interval and vice versa; yields @c std::nullopt if both contradict each other.
+        std::optional<Val> tighten(nat_t width) const;
+        bool operator==(const Val& other) const { return zeros == other.zeros && ones == other.ones && lo == other.lo && hi == other.hi; }
+        bool operator!=(const Val& other) const { return !(*this == other); }
+    };
+
+    using Data = std::tuple<>; ///< No state needed - see var2val_.
+
+    static constexpr size_t Max_Depth = 32; ///< Deeper expressions are ⊤.
+    static constexpr size_t Max_Grow  = 4;  ///< A @p Var that has grown more often than this is widened to the full range.
+
+    /// @name transfer functions
+    //@{
+    /// Over-approximate the results of the respective operation for all values of @p a and @p b of the given @p width.
+    static Val transfer(Wrap, const Val& a, const Val& b, nat_t width);
+    static Val transfer(Shr,  const Val& a, const Val& b, nat_t width);
+    static Val transfer(Bit,  const Val& a, const Val& b, nat_t width);
+    static Val transfer(Div,  const Val& a, const Val& b, nat_t width); ///< Only the result - without mem.
+    /// Yields the result of the comparison if all values of @p a and @p b agree on it.
+    static std::optional<bool> transfer(ICmp, const Val& a, const Val& b, nat_t width);
+    //@}
+
+private:
+    /// @name PassMan hooks
+    //@{
+    void enter() override;
+    const Def* rewrite(const Def*) override;
+    undo_t analyze(const Def*) override;
+    //@}
+
+    /// Yields the Val of @p def or @c std::nullopt if @p def is no @p Int of power-of-two width.
+    std::optional<Val> value(const Def* def, size_t depth = 0);
+    Val transfer(const Def* def, nat_t width, size_t depth);
+    /// Yields the operand that the binary @p Int operation @p def is known to be equivalent to or @c nullptr.
+    const Def* operand(const Def* def);
+    /// Joins the @p i%th @p Var of @p lam with @p val.
+    undo_t join(Lam* lam, size_t i, std::optional<Val> val);
+
+    /// Join of all arguments seen so far for the @p Int @p Var%s of non-escaping @p Lam%s.
+    /// This only grows and survives roll backs - otherwise, we would roll back the very growth that triggered the roll back.
+    DefMap<Val> var2val_;
+    DefMap<size_t> grow_; ///< How often the Val of a @p Var has grown.
+    DefMap<Val> cache_;   ///< Memoizes value; only valid as long as var2val_ doesn't change.
+};
+
+}
+
+#endif
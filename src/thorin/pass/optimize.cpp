@@ -1,14 +1,20 @@
+#include "thorin/pass/fp/alloc2slot.h"
 #include "thorin/pass/fp/beta_red.h"
 #include "thorin/pass/fp/copy_prop.h"
 #include "thorin/pass/fp/dce.h"
+#include "thorin/pass/fp/dse.h"
 #include "thorin/pass/fp/eta_exp.h"
 #include "thorin/pass/fp/eta_red.h"
+#include "thorin/pass/fp/inliner.h"
+#include "thorin/pass/fp/sroa.h"
 #include "thorin/pass/fp/ssa_constr.h"
+#include "thorin/pass/fp/value_range.h"
 #include "thorin/pass/rw/auto_diff.h"
 #include "thorin/pass/rw/bound_elim.h"
 #include "thorin/pass/rw/partial_eval.h"
 #include "thorin/pass/rw/ret_wrap.h"
 #include "thorin/pass/rw/scalarize.h"
+#include "thorin/pass/rw/tail_rec_elim.h"
 
 // old stuff
 #include "thorin/transform/cleanup_world.h"
@@ -29,10 +35,17 @@ void optimize(World& world) {
 
     PassMan opt2(world);
     opt2.add<PartialEval>();
+    opt2.add<TailRecElim>();
     opt2.add<BetaRed>();
+    opt2.add<Inliner>();
     auto er = opt2.add<EtaRed>();
     auto ee = opt2.add<EtaExp>(er);
+    opt2.add<Scalerize>(ee);
+    auto a2s = opt2.add<Alloc2Slot>();
+    opt2.add<SROA>(a2s);
     opt2.add<SSAConstr>(ee);
+    opt2.add<DSE>();
+    opt2.add<ValueRange>();
     opt2.run();
     printf("Finished Opti2\n");
 
@@ -1,6 +1,10 @@
 #include "thorin/pass/pass.h"
 
+#include <iomanip>
+#include <sstream>
+
 #include "thorin/rewrite.h"
+#include "thorin/analyses/deptree.h"
 #include "thorin/util/container.h"
 
 namespace thorin {
@@ -18,13 +22,15 @@ FPPassBase::FPPassBase(PassMan& man, const std::string& name)
 
 void PassMan::push_state() {
     if (size_t num = fp_passes_.size()) {
-        states_.emplace_back(num);
+        states_.emplace_back(num, stamp_++);
+        curr_state().mark = world().journal_size();
+        ++stats_.states;
+        stats_.peak_states = std::max(stats_.peak_states, states_.size());
 
-        // copy over from prev_state to curr_state
+        // copy over from prev_state to curr_state - all of these copies are O(1)
         auto&& prev_state      = states_[states_.size() - 2];
-        curr_state().curr_nom  = prev_state.stack.top();
-        curr_state().old_ops   = curr_state().curr_nom->ops();
-        curr_state().stack     = prev_state.stack;
+        curr_state().curr_nom  = prev_state.worklist.top().nom;
+        curr_state().worklist  = prev_state.worklist;
         curr_state().nom2visit = prev_state.nom2visit;
 
         for (size_t i = 0; i != num; ++i)
@@ -33,48 +39,127 @@ void PassMan::push_state() {
 }
 
 void PassMan::pop_states(size_t undo) {
+    auto mark = undo < states_.size() ? states_[undo].mark : world().journal_size();
     while (states_.size() != undo) {
         for (size_t i = 0, e = curr_state().data.size(); i != e; ++i)
             fp_passes_[i]->dealloc(curr_state().data[i]);
+        states_.pop_back();
+    }
 
-        if (undo != 0) // only reset if not final cleanup
-            curr_state().curr_nom->set(curr_state().old_ops);
+    if (undo == 0) { // final cleanup: keep all modifications
+        journal_.clear();
+    } else {
+        while (!journal_.empty() && std::get<0>(journal_.back()) >= undo) {
+            auto& [_, nom, i, old_op] = journal_.back();
+            nom->set(i, old_op);
+            journal_.pop_back();
+        }
+        stats_.reclaimed += world().reclaim(mark);
+    }
 
-        states_.pop_back();
+    // entries of popped States are lazily invalidated via alive() - but we have to restore what they shadowed
+    while (!trail_.empty() && std::get<0>(trail_.back()) >= undo) {
+        auto& [_, old_def, entry] = trail_.back();
+        old2new_[old_def] = entry;
+        trail_.pop_back();
+    }
+
+    if (undo == 0) {
+        old2new_.clear();
+        analyzed_.clear();
     }
 }
 
+void PassMan::map(const Def* old_def, const Def* new_def, bool overwrite) {
+    auto [i, ins] = old2new_.emplace(old_def, std::pair(new_def, curr_version()));
+    if (ins) return;
+
+    auto& entry = i->second;
+    if (!alive(entry.second)) {
+        entry = {new_def, curr_version()};
+    } else if (entry.second.undo == curr_undo()) {
+        if (overwrite) entry.first = new_def;
+    } else {
+        trail_.emplace_back(curr_undo(), old_def, entry);
+        entry = {new_def, curr_version()};
+    }
+}
+
+void PassMan::set(Def* nom, size_t i, const Def* def) {
+    auto old_op = nom->op(i);
+    if (old_op == def) return;
+    if (!fp_passes_.empty()) journal_.emplace_back(curr_undo(), nom, i, old_op);
+    nom->set(i, def);
+}
+
 void PassMan::run() {
+    world().debug_stream();
+    std::vector<Def*> externals;
+    for (const auto& [_, nom] : world().externals()) externals.emplace_back(nom);
+    run(externals);
+    world().debug_stream();
+    cleanup(world());
+}
+
+void PassMan::run_parallel(World& world, const Config& config, ThreadPool* pool) {
+    world.debug_stream();
+    auto components = DepTree(world).components();
+    world.ILOG("run {} components on {} threads", components.size(), pool ? pool->num_threads() + 1 : 1);
+
+    auto run = [&](size_t i) {
+        PassMan man(world);
+        config(man);
+        man.run(components[i]);
+    };
+
+    if (pool) {
+        world.set_concurrent();
+        pool->parallel_for(components.size(), run);
+        world.set_concurrent(false);
+    } else {
+        for (size_t i = 0, e = components.size(); i != e; ++i) run(i);
+    }
+
+    world.debug_stream();
+    cleanup(world);
+}
+
+void PassMan::run(ArrayRef<Def*> externals) {
     world().ILOG("run");
+    start_ = PassStats::Clock::now();
+    stats_ = {};
+    for (auto pass : passes_) pass->stats_ = {};
+
+    for (auto pass : passes_)
+        world().ILOG(" + {}", pass->name());
 
     auto num = fp_passes_.size();
-    states_.emplace_back(num);
+    bool journal = num != 0 && !world().is_concurrent();
+    if (journal) world().set_journal();
+    states_.emplace_back(num, stamp_++);
     for (size_t i = 0; i != num; ++i)
         curr_state().data[i] = fp_passes_[i]->alloc();
 
-    for (auto pass : passes_)
-        world().ILOG(" + {}", pass->name());
-    world().debug_stream();
-
-    auto externals = std::vector(world().externals().begin(), world().externals().end());
-    for (const auto& [_, nom] : externals) {
+    schedule_->init(*this, externals);
+    for (auto nom : externals) {
         analyzed(nom);
-        curr_state().stack.push(nom);
+        push(nom);
     }
 
-    while (!curr_state().stack.empty()) {
+    while (!curr_state().worklist.empty()) {
+        check_budgets();
         push_state();
-        curr_nom_ = pop(curr_state().stack);
+        curr_nom_ = pop(curr_state().worklist).nom;
         world().VLOG("=== state {}: {} ===", states_.size() - 1, curr_nom_);
 
         if (!curr_nom_->is_set()) continue;
 
         for (auto pass : passes_) {
-            if (pass->inspect()) pass->enter();
+            if (pass->inspect()) profile(pass, &PassStats::enter, [&] { pass->enter(); });
         }
 
         for (size_t i = 0, e = curr_nom_->num_ops(); i != e; ++i)
-            curr_nom_->set(i, rewrite(curr_nom_->op(i)));
+            set(curr_nom_, i, rewrite(curr_nom_->op(i)));
 
         world().VLOG("=== analyze ===");
         proxy_ = false;
@@ -86,19 +171,72 @@ void PassMan::run() {
             assert(!proxy_ && "proxies must not occur anymore after leaving a nom with No_Undo");
             world().DLOG("=== done ===");
         } else {
+            ++stats_.undos;
+            stats_.undo_depth += states_.size() - undo;
             pop_states(undo);
-            world().DLOG("=== undo: {} -> {} ===", undo, curr_state().stack.top());
+            world().DLOG("=== undo: {} -> {} ===", undo, curr_state().worklist.top().nom);
         }
     }
 
-    world().ILOG("finished");
     pop_states(0);
+    if (journal) world().set_journal(false);
 
-    world().debug_stream();
-    cleanup(world());
+    world().ILOG("finished");
+    stats_.time = PassStats::Clock::now() - start_;
+
+    if (int(world().min_level()) <= int(LogLevel::Info)) {
+        std::ostringstream table;
+        Stream s(table);
+        stream_stats(s);
+        std::istringstream lines(table.str());
+        for (std::string line; std::getline(lines, line);) world().ILOG("{}", line);
+        world().ILOG("{}", world().apply_cache());
+    }
+    if (json_os_) json_stats(*json_os_) << std::endl;
 }
 
-const Def* PassMan::rewrite(const Def* old_def) {
+void PassMan::check_budgets() {
+    auto exhaust = [&](RWPassBase* pass) {
+        if (!pass->stats_.exhausted) {
+            pass->stats_.exhausted = true;
+            world().WLOG("{} has run out of budget; it won't speculate anymore", pass->name());
+        }
+    };
+
+    size_t rewrites = 0, nodes = 0;
+    for (auto pass : passes_) {
+        if (pass->budget().exceeded(pass->stats())) exhaust(pass);
+        rewrites += pass->stats().rewrites;
+        nodes    += pass->stats().nodes;
+    }
+
+    if (!stats_.exhausted && budget().exceeded(rewrites, stats_.undos, nodes, PassStats::Clock::now() - start_)) {
+        stats_.exhausted = true;
+        world().WLOG("pass manager has run out of budget");
+        for (auto&& pass : fp_passes_) exhaust(pass.get());
+    }
+}
+
+template<class D>
+const Def* PassMan::rewrite(RWPassBase* pass, const D* def) {
+    auto rw = profile(pass, &PassStats::rewrite, [&] { return pass->rewrite(def); });
+    if (rw != def) ++pass->stats_.rewrites;
+    return rw;
+}
+
+template<class D>
+undo_t PassMan::analyze(FPPassBase* pass, const D* def) {
+    auto undo = profile(pass, &PassStats::analyze, [&] { return pass->analyze(def); });
+    if (undo != No_Undo) {
+        auto depth = states_.size() - undo;
+        ++pass->stats_.undos;
+        pass->stats_.undo_depth += depth;
+        pass->stats_.max_undo_depth = std::max(pass->stats_.max_undo_depth, depth);
+    }
+    return undo;
+}
+
+std::optional<const Def*> PassMan::known(const Def* old_def) {
     if (old_def->no_dep()) return old_def;
 
     if (auto nom = old_def->isa_nom()) {
@@ -106,66 +244,222 @@ const Def* PassMan::rewrite(const Def* old_def) {
         return map(nom, nom);
     }
 
-    if (auto new_def = lookup(old_def)) {
-        if (old_def == *new_def)
-            return old_def;
-        else
-            return map(old_def, rewrite(*new_def));
-    }
-
-    auto new_type = rewrite(old_def->type());
-    auto new_dbg  = old_def->dbg() ? rewrite(old_def->dbg()) : nullptr;
-
-    DefArray new_ops(old_def->num_ops(), [&](size_t i) { return rewrite(old_def->op(i)); });
-    auto new_def = old_def->rebuild(world(), new_type, new_ops, new_dbg);
+    if (auto new_def = lookup(old_def); new_def && *new_def == old_def) return old_def;
+    return {};
+}
 
+const Def* PassMan::pass_rewrite(const Def* new_def) {
     if (auto proxy = new_def->isa<Proxy>()) {
         if (auto pass = static_cast<FPPassBase*>(passes_[proxy->id()]); pass->inspect()) {
-            if (auto rw = pass->rewrite(proxy); rw != proxy)
-                return map(old_def, rewrite(rw));
+            if (auto rw = rewrite(pass, proxy); rw != proxy) return rw;
         }
     } else {
         for (auto pass : passes_) {
             if (!pass->inspect()) continue;
 
             if (auto var = new_def->isa<Var>()) {
-                if (auto rw = pass->rewrite(var); rw != var)
-                    return map(old_def, rewrite(rw));
+                if (auto rw = rewrite(pass, var); rw != var) return rw;
             } else {
-                if (auto rw = pass->rewrite(new_def); rw != new_def)
-                    return map(old_def, rewrite(rw));
+                if (auto rw = rewrite(pass, new_def); rw != new_def) return rw;
             }
         }
     }
 
-    return map(old_def, new_def);
+    return new_def;
 }
 
-undo_t PassMan::analyze(const Def* def) {
-    undo_t undo = No_Undo;
-
-    if (def->no_dep() || analyzed(def)) {
-        // do nothing
-    } else if (auto nom = def->isa_nom()) {
-        curr_state().stack.push(nom);
-    } else if (auto proxy = def->isa<Proxy>()) {
-        proxy_ = true;
-        undo = static_cast<FPPassBase*>(passes_[proxy->id()])->analyze(proxy);
-    } else {
-        auto var = def->isa<Var>();
+/*
+ * Rewriting old_def involves one of these two things:
+ * 1. If old_def has already been mapped to a different Def, rewrite that one instead.
+ * 2. Otherwise, rewrite type, dbg, and ops, rebuild, and let the passes have a go.
+ *    If one of the passes yields a different Def, rewrite that one instead.
+ * Either way, old_def is mapped to the final result.
+ * Instead of recursing, we keep the pending Frame%s on rw_stack_.
+ */
+const Def* PassMan::rewrite(const Def* old_def) {
+    if (auto new_def = known(old_def)) return *new_def;
+
+    auto base = rw_stack_.size();
+    auto enter = [&](const Def* def) {
+        if (auto new_def = lookup(def))
+            rw_stack_.emplace_back(RWFrame{def, *new_def, 0, nullptr, nullptr, rw_ops_.size()});
+        else
+            rw_stack_.emplace_back(RWFrame{def, nullptr, 0, nullptr, nullptr, rw_ops_.size()});
+    };
+
+    enter(old_def);
+    const Def* result = nullptr;
+    bool has_result = false;
+
+    while (true) {
+        auto& frame = rw_stack_.back();
+
+        if (frame.replacement != nullptr) {
+            if (has_result) { // the replacement has been rewritten
+                result = map(frame.old_def, result);
+                rw_stack_.pop_back();
+                if (rw_stack_.size() == base) return result;
+                continue; // has_result is still set
+            }
+
+            auto replacement = frame.replacement;
+            if (auto new_def = known(replacement)) {
+                result = *new_def;
+                has_result = true;
+            } else {
+                enter(replacement);
+            }
+            continue;
+        }
+
+        auto consume = [&](const Def* new_def) {
+            if (frame.i == 0)
+                frame.new_type = new_def;
+            else if (frame.i == 1)
+                frame.new_dbg = new_def;
+            else
+                rw_ops_.emplace_back(new_def);
+            ++frame.i;
+        };
+
+        if (has_result) {
+            consume(result);
+            has_result = false;
+        }
+
+        const Def* next = nullptr;
+        for (auto e = frame.old_def->num_ops() + 2; next == nullptr && frame.i != e;) {
+            auto old_op = frame.i == 0 ? frame.old_def->type()
+                        : frame.i == 1 ? frame.old_def->dbg()
+                        :                frame.old_def->op(frame.i - 2);
+            if (old_op == nullptr) { // no dbg
+                ++frame.i;
+            } else if (auto new_op = known(old_op)) {
+                consume(*new_op);
+            } else {
+                next = old_op;
+            }
+        }
+
+        if (next != nullptr) {
+            enter(next);
+            continue;
+        }
+
+        auto new_ops = Defs(rw_ops_).skip_front(frame.ops);
+        auto new_def = frame.old_def->rebuild(world(), frame.new_type, new_ops, frame.new_dbg);
+        rw_ops_.resize(frame.ops);
+
+        if (auto rw = pass_rewrite(new_def); rw != new_def) {
+            frame.replacement = rw; // continue with case 1
+            continue;
+        }
 
-        if (!var) {
-            for (auto op : def->extended_ops())
-                undo = std::min(undo, analyze(op));
+        result = map(frame.old_def, new_def);
+        rw_stack_.pop_back();
+        if (rw_stack_.size() == base) return result;
+        has_result = true;
+    }
+}
+
+/// Analyzes the extended_ops of all structural Def%s before the Def itself - using an explicit stack instead of recursion.
+undo_t PassMan::analyze(const Def* def) {
+    // Yields true if def needs a Frame on an_stack_ - otherwise the result goes to undo.
+    auto enter = [&](const Def* def, undo_t& undo) {
+        if (def->no_dep() || analyzed(def)) {
+            // do nothing
+        } else if (auto nom = def->isa_nom()) {
+            push(nom);
+        } else if (auto proxy = def->isa<Proxy>()) {
+            proxy_ = true;
+            undo = std::min(undo, analyze(static_cast<FPPassBase*>(passes_[proxy->id()]), proxy));
+        } else {
+            return true;
         }
+        return false;
+    };
 
+    auto leave = [&](const Def* def, undo_t undo) {
+        auto var = def->isa<Var>();
         for (auto&& pass : fp_passes_) {
             if (pass->inspect())
-                undo = std::min(undo, var ? pass->analyze(var) : pass->analyze(def));
+                undo = std::min(undo, var ? analyze(pass.get(), var) : analyze(pass.get(), def));
         }
+        return undo;
+    };
+
+    auto result = No_Undo;
+    if (!enter(def, result)) return result;
+
+    auto base = an_stack_.size();
+    an_stack_.emplace_back(def, 0, No_Undo);
+    while (true) {
+        auto& [curr, i, undo] = an_stack_.back();
+        auto ops = curr->isa<Var>() ? Defs() : curr->extended_ops();
+
+        const Def* next = nullptr;
+        while (next == nullptr && i != ops.size()) {
+            auto op = ops[i++];
+            if (enter(op, undo)) next = op;
+        }
+
+        if (next != nullptr) {
+            an_stack_.emplace_back(next, 0, No_Undo);
+            continue;
+        }
+
+        result = leave(curr, undo);
+        an_stack_.pop_back();
+        if (an_stack_.size() == base) return result;
+        auto& parent_undo = std::get<2>(an_stack_.back());
+        parent_undo = std::min(parent_undo, result);
     }
+}
 
-    return undo;
+/*
+ * statistics
+ */
+
+static double secs(PassStats::Duration d) { return std::chrono::duration<double>(d).count(); }
+
+Stream& PassMan::stream_stats(Stream& s) const {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3);
+    os << std::left << std::setw(16) << "pass" << std::right
+       << std::setw(10) << "enter[s]" << std::setw(12) << "rewrite[s]" << std::setw(12) << "analyze[s]"
+       << std::setw(10) << "rewrites" << std::setw(8) << "undos" << std::setw(12) << "undo depth"
+       << std::setw(10) << "max depth" << std::setw(10) << "nodes" << std::setw(11) << "exhausted" << '\n';
+
+    for (auto pass : passes_) {
+        const auto& p = pass->stats();
+        os << std::left << std::setw(16) << pass->name() << std::right
+           << std::setw(10) << secs(p.enter) << std::setw(12) << secs(p.rewrite) << std::setw(12) << secs(p.analyze)
+           << std::setw(10) << p.rewrites << std::setw(8) << p.undos << std::setw(12) << p.undo_depth
+           << std::setw(10) << p.max_undo_depth << std::setw(10) << p.nodes << std::setw(11) << (p.exhausted ? "yes" : "no") << '\n';
+    }
+
+    os << "total: " << secs(stats_.time) << "s, states: " << stats_.states << ", peak states: " << stats_.peak_states
+       << ", undos: " << stats_.undos << ", undo depth: " << stats_.undo_depth
+       << ", reclaimed: " << stats_.reclaimed << (stats_.exhausted ? ", budget exhausted" : "");
+    return s.fmt("{}", os.str());
+}
+
+std::ostream& PassMan::json_stats(std::ostream& os) const {
+    os << "{\"time\": " << secs(stats_.time) << ", \"states\": " << stats_.states << ", \"peak_states\": " << stats_.peak_states
+       << ", \"undos\": " << stats_.undos << ", \"undo_depth\": " << stats_.undo_depth << ", \"reclaimed\": " << stats_.reclaimed
+       << ", \"exhausted\": " << (stats_.exhausted ? "true" : "false") << ", \"passes\": [";
+
+    for (size_t i = 0, e = passes_.size(); i != e; ++i) {
+        const auto& p = passes_[i]->stats();
+        os << (i == 0 ? "" : ", ")
+           << "{\"name\": \"" << passes_[i]->name() << "\""
+           << ", \"enter\": " << secs(p.enter) << ", \"rewrite\": " << secs(p.rewrite) << ", \"analyze\": " << secs(p.analyze)
+           << ", \"rewrites\": " << p.rewrites << ", \"undos\": " << p.undos << ", \"undo_depth\": " << p.undo_depth
+           << ", \"max_undo_depth\": " << p.max_undo_depth << ", \"nodes\": " << p.nodes
+           << ", \"exhausted\": " << (p.exhausted ? "true" : "false") << "}";
+    }
+
+    return os << "]}";
 }
 
 }
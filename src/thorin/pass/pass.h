@@ -1,10 +1,12 @@
 #ifndef THORIN_PASS_PASS_H
 #define THORIN_PASS_PASS_H
 
-#include <stack>
+#include <chrono>
+#include <deque>
 
 #include "thorin/world.h"
 #include "thorin/analyses/scope.h"
+#include "thorin/util/thread_pool.h"
 
 namespace thorin {
 
@@ -12,6 +14,42 @@ class PassMan;
 typedef size_t undo_t;
 static constexpr undo_t No_Undo = std::numeric_limits<undo_t>::max();
 
+/// Statistics the PassMan gathers for each pass during PassMan::run.
+struct PassStats {
+    using Clock    = std::chrono::steady_clock;
+    using Duration = Clock::duration;
+
+    Duration enter   = {}; ///< Time spent in RWPassBase::enter.
+    Duration rewrite = {}; ///< Time spent in RWPassBase::rewrite.
+    Duration analyze = {}; ///< Time spent in FPPassBase::analyze.
+    size_t rewrites       = 0; ///< Number of RWPassBase::rewrite%s that yielded a different Def.
+    size_t undos          = 0; ///< Number of FPPassBase::analyze%s that requested an undo.
+    size_t undo_depth     = 0; ///< Sum of the number of States these undos requested to roll back.
+    size_t max_undo_depth = 0; ///< Maximum number of States a single undo requested to roll back.
+    size_t nodes          = 0; ///< Number of Def%s created within this pass' hooks.
+    bool exhausted        = false; ///< Has this pass run out of its Budget - or the PassMan out of its one?
+
+    Duration time() const { return enter + rewrite + analyze; }
+};
+
+/**
+ * Limits the work of a single pass or of a whole PassMan::run - whatever is exceeded first.
+ * The PassMan checks all Budget%s before visiting the next @em nom.
+ * Once exceeded, a pass is RWPassBase::exhausted and should no longer start any speculation.
+ * It still resolves pending speculation, so the PassMan keeps visiting the remaining @em noms and terminates in a consistent World.
+ */
+struct Budget {
+    static constexpr size_t Unlimited = std::numeric_limits<size_t>::max();
+
+    size_t rewrites = Unlimited;
+    size_t undos    = Unlimited;
+    size_t nodes    = Unlimited;
+    PassStats::Duration time = PassStats::Duration::max();
+
+    bool exceeded(size_t r, size_t u, size_t n, PassStats::Duration t) const { return r >= rewrites || u >= undos || n >= nodes || t >= time; }
+    bool exceeded(const PassStats& s) const { return exceeded(s.rewrites, s.undos, s.nodes, s.time()); }
+};
+
 /// All Passes that want to be registered in the @p PassMan must implement this interface.
 /// * Directly inherit from this class if your pass doesn't need state and a fixed-point iteration (a ReWrite pass).
 /// * Inherit from @p FPPass using CRTP if you do need state.
@@ -26,9 +64,18 @@ public:
     const PassMan& man() const { return man_; }
     const std::string& name() const { return name_; }
     size_t proxy_id() const { return proxy_id_; }
+    const PassStats& stats() const { return stats_; }
     World& world();
     //@}
 
+    /// @name Budget
+    //@{
+    const Budget& budget() const { return budget_; }
+    void set_budget(const Budget& budget) { budget_ = budget; }
+    /// If @c true, don't start any new speculation; resolve pending one as usual.
+    bool exhausted() const { return stats_.exhausted; }
+    //@}
+
     /// @name hooks for the PassMan
     //@{
     virtual bool inspect() const = 0;
@@ -65,6 +112,8 @@ private:
     PassMan& man_;
     std::string name_;
     size_t proxy_id_;
+    Budget budget_;
+    PassStats stats_;
 
     friend class PassMan;
 };
@@ -94,6 +143,22 @@ private:
     friend class PassMan;
 };
 
+/**
+ * Decides in which order the PassMan visits @em noms.
+ * The PassMan always continues with the pending @em nom of lowest priority;
+ * ties are broken in favor of the most recently discovered one.
+ * Thus, this default - which assigns the same priority to all @em noms - yields a depth-first traversal.
+ */
+class NomSchedule {
+public:
+    virtual ~NomSchedule() {}
+
+    /// Invoked whenever the PassMan starts to process @p externals.
+    virtual void init(PassMan&, ArrayRef<Def*> /*externals*/) {}
+    /// Invoked when @p nom is discovered while analyzing PassMan::curr_nom or when it is one of the externals.
+    virtual size_t priority(const PassMan&, Def* /*nom*/) { return 0; }
+};
+
 /// An optimizer that combines several optimizations in an optimal way.
 /// This is loosely based upon:
 /// "Composing dataflow analyses and transformations" by Lerner, Grove, Chambers.
@@ -132,49 +197,164 @@ public:
 
     /// Run all registered passes on the whole @p world.
     void run();
+
+    /// Adds the passes to a fresh PassMan - see run_parallel.
+    using Config = std::function<void(PassMan&)>;
+    /**
+     * Optimizes each component of @p world - see DepTree::components - with a separate PassMan that @p config sets up.
+     * If a @p pool is given, the components are optimized concurrently on it and @p world is in concurrent mode meanwhile - see World::set_concurrent.
+     * The only Def%s that components share are immutable and hash-consed, so the result is the same as when optimizing one component after the other - up to gids.
+     * This includes the ids of slots as these are drawn from World::curr_gid.
+     * As run, this finally invokes cleanup.
+     */
+    static void run_parallel(World& world, const Config& config, ThreadPool* pool = ThreadPool::global());
+
+    const NomSchedule& schedule() const { return *schedule_; }
+    /// Replaces the NomSchedule which decides in which order run visits @em noms.
+    template<class S, class... Args>
+    S* set_schedule(Args&&... args) {
+        auto s = std::make_unique<S>(std::forward<Args>(args)...);
+        auto res = s.get();
+        schedule_ = std::move(s);
+        return res;
+    }
+    //@}
+
+    /// @name journaled modification of noms
+    //@{
+    /// Same as Def::set but undone if the current State is rolled back.
+    /// Passes that modify PassMan::curr_nom in RWPassBase::enter must use these.
+    /// @attention Only the operands of @em noms are journaled.
+    /// FPPass data is not: each State holds its own copy as obtained from FPPassBase::copy.
+    /// The World journals its Sea insertions - a roll back reclaims the Def%s that aren't used anymore; see World::reclaim.
+    void set(Def* nom, size_t i, const Def* def);
+    void set(Def* nom, Defs ops) { for (size_t i = 0, e = nom->num_ops(); i != e; ++i) set(nom, i, ops[i]); }
+    //@}
+
+    /// @name statistics of the last run - see also PassStats
+    //@{
+    struct Stats {
+        PassStats::Duration time = {}; ///< Total time of PassMan::run.
+        size_t states      = 0;        ///< Number of States pushed.
+        size_t peak_states = 0;        ///< Maximum number of simultaneously pending States.
+        size_t undos       = 0;        ///< Number of actual roll backs.
+        size_t undo_depth  = 0;        ///< Sum of the number of States popped by these roll backs.
+        size_t reclaimed   = 0;        ///< Number of Def%s these roll backs have reclaimed - see World::reclaim.
+        bool exhausted     = false;    ///< Has the Budget of the whole PassMan been exceeded?
+    };
+
+    const Stats& stats() const { return stats_; }
+    const Budget& budget() const { return budget_; }
+    /// Limits the work of the whole run; when exceeded, all FPPass%es are RWPassBase::exhausted.
+    void set_budget(const Budget& budget) { budget_ = budget; }
+    Stream& stream_stats(Stream&) const;             ///< Streams a human-readable table.
+    std::ostream& json_stats(std::ostream&) const;   ///< Streams the same information as JSON.
+    /// If set, run streams json_stats as one line to @p os when it finishes; @c nullptr turns this off again.
+    void set_json_stats(std::ostream* os) { json_os_ = os; }
     //@}
 
 private:
     /// @name state
     //@{
+    /// A @em nom that waits to be visited.
+    struct Pending {
+        size_t priority; ///< See NomSchedule::priority.
+        size_t seq;      ///< Discovery order.
+        Def* nom;
+    };
+
+    struct PendingLt {
+        bool operator()(const Pending& a, const Pending& b) const {
+            return a.priority != b.priority ? a.priority < b.priority : a.seq > b.seq;
+        }
+    };
+
     struct State {
         State() = default;
         State(const State&) = delete;
         State(State&&) = delete;
         State& operator=(State) = delete;
-        State(size_t num)
+        State(size_t num, size_t stamp)
             : data(num)
+            , stamp(stamp)
         {}
 
         Def* curr_nom = nullptr;
-        DefArray old_ops;
-        std::stack<Def*> stack;
-        NomMap<undo_t> nom2visit;
+        PersistentHeap<Pending, PendingLt> worklist; ///< Shares its structure with the previous State.
+        PersistentGIDMap<Def*, undo_t> nom2visit;    ///< Shares its structure with the previous State.
         Array<void*> data;
-        Def2Def old2new;
-        DefSet analyzed;
+        size_t stamp;    ///< Unique among all States ever pushed.
+        size_t mark = 0; ///< World::journal_size when this State was pushed.
+    };
+
+    /// Identifies the State that created an entry of old2new_ or analyzed_.
+    /// The entry is only valid as long as this very State is alive - even if its undo level has been reused since.
+    struct Version {
+        undo_t undo;
+        size_t stamp;
     };
 
+    /// Runs all registered passes on the @em noms reachable from @p externals - without cleanup.
+    void run(ArrayRef<Def*> externals);
+    void check_budgets();
+    void push(Def* nom) { curr_state().worklist.push({schedule_->priority(*this, nom), seq_++, nom}); }
     void push_state();
     void pop_states(undo_t undo);
     State& curr_state() { assert(!states_.empty()); return states_.back(); }
     const State& curr_state() const { assert(!states_.empty()); return states_.back(); }
     undo_t curr_undo() const { return states_.size()-1; }
+    Version curr_version() const { return {curr_undo(), curr_state().stamp}; }
+    bool alive(Version v) const { return v.undo < states_.size() && states_[v.undo].stamp == v.stamp; }
     //@}
 
+    /// Invokes @p f and charges the elapsed time to @p time and all newly created Def%s to @p pass.
+    template<class F>
+    auto profile(RWPassBase* pass, PassStats::Duration PassStats::* time, F f) {
+        auto gids = World::num_gids();
+        auto start = PassStats::Clock::now();
+        auto charge = [&]() {
+            pass->stats_.*time += PassStats::Clock::now() - start;
+            pass->stats_.nodes += World::num_gids() - gids;
+        };
+
+        if constexpr (std::is_void<decltype(f())>::value) {
+            f();
+            charge();
+        } else {
+            auto res = f();
+            charge();
+            return res;
+        }
+    }
+
     /// @name rewriting
     //@{
     const Def* rewrite(const Def*);
+    template<class D> const Def* rewrite(RWPassBase*, const D*); ///< Invokes RWPassBase::rewrite and records PassStats.
+    std::optional<const Def*> known(const Def*); ///< Yields the result of rewrite if no further work is needed.
+    const Def* pass_rewrite(const Def*);         ///< Yields the first rewrite of a pass that differs from the argument.
+
+    /// A pending rewrite of @p old_def.
+    struct RWFrame {
+        const Def* old_def;
+        const Def* replacement; ///< If set, rewrite this one instead and map @p old_def to the result.
+        size_t i;               ///< Next operand: @c 0 is the type, @c 1 is dbg, and @c i+2 is the @c i^th op.
+        const Def* new_type;
+        const Def* new_dbg;
+        size_t ops;             ///< Offset of the new ops within rw_ops_.
+    };
 
     const Def* map(const Def* old_def, const Def* new_def) {
-        curr_state().old2new[old_def] = new_def;
-        curr_state().old2new.emplace(new_def, new_def);
+        map(old_def, new_def, true);
+        map(new_def, new_def, false);
         return new_def;
     }
 
-    std::optional<const Def*> lookup(const Def* old_def) {
-        for (auto i = states_.rbegin(), e = states_.rend(); i != e; ++i)
-            if (auto new_def = i->old2new.lookup(old_def)) return *new_def;
+    /// Maps @p old_def to @p new_def in the current State; an existing mapping of the current State is only replaced if @p overwrite is set.
+    void map(const Def* old_def, const Def* new_def, bool overwrite);
+
+    std::optional<const Def*> lookup(const Def* old_def) const {
+        if (auto i = old2new_.find(old_def); i != old2new_.end() && alive(i->second.second)) return i->second.first;
         return {};
     }
     //@}
@@ -182,11 +362,12 @@ private:
     /// @name analyze
     //@{
     undo_t analyze(const Def*);
+    template<class D> undo_t analyze(FPPassBase*, const D*); ///< Invokes FPPassBase::analyze and records PassStats.
     bool analyzed(const Def* def) {
-        for (auto i = states_.rbegin(), e = states_.rend(); i != e; ++i) {
-            if (i->analyzed.contains(def)) return true;
-        }
-        curr_state().analyzed.emplace(def);
+        auto [i, ins] = analyzed_.emplace(def, curr_version());
+        if (ins) return false;
+        if (alive(i->second)) return true;
+        i->second = curr_version();
         return false;
     }
     //@}
@@ -196,8 +377,27 @@ private:
     std::vector<std::unique_ptr<RWPassBase>> rw_passes_;
     std::vector<std::unique_ptr<FPPassBase>> fp_passes_;
     std::deque<State> states_;
+    size_t stamp_ = 0;
+    Stats stats_;
+    std::ostream* json_os_ = nullptr;
+    /// @name versioned maps shared by all States
+    //@{
+    DefMap<std::pair<const Def*, Version>> old2new_;
+    DefMap<Version> analyzed_;
+    /// Mappings of old2new_ that have been shadowed by a newer State; they are restored when this State is popped.
+    std::vector<std::tuple<undo_t, const Def*, std::pair<const Def*, Version>>> trail_;
+    /// Previous operands of all journaled Def::set%s as <tt>(undo, nom, i, old_op)</tt>; replayed backwards on roll back.
+    std::vector<std::tuple<undo_t, Def*, size_t, const Def*>> journal_;
+    //@}
     Def* curr_nom_ = nullptr;
     bool proxy_ = false;
+    std::unique_ptr<NomSchedule> schedule_ = std::make_unique<NomSchedule>();
+    size_t seq_ = 0;
+    Budget budget_;
+    PassStats::Clock::time_point start_;
+    std::vector<RWFrame> rw_stack_;
+    std::vector<const Def*> rw_ops_;
+    std::vector<std::tuple<const Def*, size_t, undo_t>> an_stack_; ///< (def, next extended op, undo) - see analyze.
 
     template<class P, class N> friend class FPPass;
 };
@@ -225,7 +425,8 @@ public:
     /// @name memory management for state
     //@{
     void* alloc() override { return new typename P::Data(); }                                                     ///< Default ctor.
-    void* copy(const void* p) override { return new typename P::Data(*static_cast<const typename P::Data*>(p)); } ///< Copy ctor.
+    /// Copy ctor - invoked for each new State; use PersistentGIDMap and friends for @c P::Data to make this O(1).
+    void* copy(const void* p) override { return new typename P::Data(*static_cast<const typename P::Data*>(p)); }
     void dealloc(void* state) override { delete static_cast<typename P::Data*>(state); }                          ///< Dtor.
     //@}
 
@@ -0,0 +1,83 @@
+#include "thorin/pass/rw/eq_sat.h"
+
+namespace thorin {
+
+/// Yields the operands of the arithmetic @p app - see EGraph::import.
+static DefArray operands(const App* app) {
+    if (isa<Tag::Conv>(app)) return {app->arg()};
+    return {app->arg(0), app->arg(1)};
+}
+
+void EqSat::enter() {
+    // the roots are all arithmetic Def%s that are used by something else than arithmetic
+    std::vector<const Def*> roots;
+    DefSet done, is_root;
+    std::vector<const Def*> stack = {curr_nom()};
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+
+        auto app = EGraph::isa_op(def);
+        for (auto op : app ? operands(app) : DefArray(def->ops())) {
+            if (op->isa_nom()) continue;
+            if (!app && EGraph::isa_op(op) && is_root.emplace(op).second) roots.emplace_back(op);
+            if (done.emplace(op).second) stack.emplace_back(op);
+        }
+    }
+
+    if (roots.empty()) return;
+
+    EGraph egraph(world(), limits_);
+    std::vector<EGraph::Id> ids;
+    for (auto root : roots) ids.emplace_back(egraph.import(root));
+
+    egraph.compute_costs(cost_);
+    std::vector<size_t> costs;
+    for (auto id : ids) costs.emplace_back(egraph.cost(id));
+
+    egraph.saturate();
+    egraph.compute_costs(cost_);
+
+    Def2Def old2new;
+    for (size_t i = 0, e = roots.size(); i != e; ++i) {
+        if (egraph.cost(ids[i]) < costs[i]) {
+            auto new_def = egraph.extract(ids[i]);
+            world().DLOG("'{}' (cost {}) -> '{}' (cost {})", roots[i], costs[i], new_def, egraph.cost(ids[i]));
+            old2new[roots[i]] = new_def;
+        }
+    }
+
+    // The PassMan hands us a root after it has rewritten its operands - so we have to anticipate replaced roots within roots.
+    Def2Def rebuilt;
+    std::function<const Def*(const Def*)> rebuild = [&](const Def* def) -> const Def* {
+        if (auto i = rebuilt.find(def); i != rebuilt.end()) return i->second;
+
+        auto result = def;
+        if (auto app = EGraph::isa_op(def)) {
+            auto arg = app->arg();
+            if (isa<Tag::Conv>(app)) {
+                arg = rebuild(arg);
+            } else {
+                DefArray ops(arg->num_ops(), [&](size_t i) { return rebuild(arg->op(i)); });
+                arg = arg->rebuild(world(), arg->type(), ops, arg->dbg());
+            }
+            result = app->rebuild(world(), app->type(), {app->callee(), arg}, app->dbg());
+        }
+
+        if (auto new_def = old2new.lookup(def)) {
+            new2new_[result] = *new_def;
+            result = *new_def;
+        }
+
+        return rebuilt[def] = result;
+    };
+
+    for (const auto& [root, _] : old2new) rebuild(root);
+}
+
+const Def* EqSat::rewrite(const Def* def) {
+    if (auto new_def = new2new_.lookup(def)) return *new_def;
+    return def;
+}
+
+}
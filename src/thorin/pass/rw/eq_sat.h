@@ -0,0 +1,32 @@
+#ifndef THORIN_PASS_RW_EQ_SAT_H
+#define THORIN_PASS_RW_EQ_SAT_H
+
+#include "thorin/egraph.h"
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Equality saturation of the arithmetic within each @p Lam - see EGraph.
+/// All expression trees of a @p Lam's body go into a single EGraph, so they share their e-classes.
+/// A tree is only replaced if its cheapest form is strictly cheaper than the original one.
+/// This pass is opt-in - it's not part of @p optimize as saturation is expensive.
+class EqSat : public RWPass<Lam> {
+public:
+    EqSat(PassMan& man, EGraph::Limits limits = {}, EGraph::Cost cost = EGraph::default_cost)
+        : RWPass(man, "eq_sat")
+        , limits_(limits)
+        , cost_(std::move(cost))
+    {}
+
+    void enter() override;
+    const Def* rewrite(const Def*) override;
+
+private:
+    EGraph::Limits limits_;
+    EGraph::Cost cost_;
+    Def2Def new2new_; ///< Rebuilt root -> cheapest form.
+};
+
+}
+
+#endif
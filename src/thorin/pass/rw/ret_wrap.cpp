@@ -15,7 +15,7 @@ void RetWrap::enter() {
     assert(new_vars.back() == ret_var && "we assume that the last element is the ret_var");
     new_vars.back() = ret_cont;
     auto new_var = world().tuple(curr_nom()->dom(), new_vars);
-    curr_nom()->set(curr_nom()->apply(new_var));
+    man().set(curr_nom(), curr_nom()->apply(new_var));
 }
 
 }
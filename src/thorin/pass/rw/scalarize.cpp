@@ -6,50 +6,155 @@
 
 namespace thorin {
 
-// TODO should also work for nominal non-dependent sigmas
+/// Does the nominal @p sigma occur within its own operands - like @c S in <code>S = [I32, cn[mem, S]]</code>?
+static bool is_recursive(const Def* sigma) {
+    DefSet done;
+    std::vector<const Def*> stack(sigma->ops().begin(), sigma->ops().end());
+    while (!stack.empty()) {
+        auto def = stack.back();
+        stack.pop_back();
+        if (def == sigma) return true;
+        if (def == nullptr || !done.emplace(def).second) continue;
+        for (auto op : def->ops()) stack.emplace_back(op);
+    }
+    return false;
+}
+
+/// Yields the arity if Scalerize splits a value of @p type into its elements.
+/// This is the case for structural @p Arr%s of small @p Lit arity and for non-dependent @p Sigma%s - structural or nominal.
+/// Flattening a recursive nominal @p Sigma would never end, so these are passed as a whole.
+static std::optional<nat_t> isa_aggregate(const Def* type) {
+    if (auto sigma = type->isa<Sigma>(); sigma && sigma->num_ops() != 1) {
+        auto nom = sigma->isa_nom();
+        if (!nom || (!nom->has_var() && !is_recursive(nom))) return sigma->num_ops();
+    }
+    if (auto arr = type->isa<Arr>(); arr && !arr->isa_nom()) {
+        if (auto a = isa_lit(arr->shape()); a && *a != 1 && *a <= Scalerize::Max_Arity) return *a;
+    }
+    return {};
+}
+
+/// Number of parameters a value of @p type occupies if flattened completely.
+static nat_t num_flat(const Def* type) {
+    if (auto a = isa_aggregate(type)) {
+        nat_t n = 0;
+        for (size_t i = 0; i != *a; ++i) n += num_flat(type->proj(*a, i));
+        return n;
+    }
+    return 1;
+}
+
+/// Yields the arity if we split a value of @p type - see Scalerize::flatten_type.
+static std::optional<nat_t> split(const Def* type, nat_t* extra) {
+    auto a = isa_aggregate(type);
+    if (!a || extra == nullptr) return a;
+
+    auto n = num_flat(type) - 1;
+    if (n > *extra) return {};
+    *extra -= n;
+    return a;
+}
+
+/// Yields the number of elements of the domain @p dom and how many parameters flattening them may add.
+static std::pair<nat_t, nat_t> params(const Def* dom) {
+    auto n = isa_aggregate(dom).value_or(1);
+    return {n, n < Scalerize::Max_Params ? Scalerize::Max_Params - n : 0};
+}
+
+/// The @p i%th element of the domain @p dom with @p n elements.
+static const Def* elem(const Def* dom, nat_t n, nat_t i) { return n == 1 ? dom : dom->proj(n, i); }
 
-// TODO merge with make_scalar
 bool Scalerize::should_expand(Lam* lam) {
     if (ignore(lam)) return false;
     if (auto sca_lam = tup2sca_.lookup(lam); sca_lam && *sca_lam == lam) return false;
 
     auto pi = lam->type();
-    if (lam->num_doms() > 1 && pi->is_cn() && !pi->isa_nom()) return true; // no ugly dependent pis
+    if (pi->is_cn() && !pi->isa_nom()) return true; // no ugly dependent pis
 
     tup2sca_[lam] = lam;
     return false;
 }
 
-Lam* Scalerize::make_scalar(Lam* tup_lam) {
-    if (auto sca_lam = tup2sca_.lookup(tup_lam)) return *sca_lam;
+const Def* Scalerize::flat_type(const Def* type) {
+    if (auto pi = type->isa<Pi>(); pi && pi->is_cn() && !pi->isa_nom()) {
+        DefVec types;
+        auto [n, extra] = params(pi->dom());
+        for (size_t i = 0; i != n; ++i) flatten_type(types, elem(pi->dom(), n, i), &extra);
+        return world().cn(types, pi->dbg());
+    }
+    return type;
+}
 
-    auto types = DefVec();
-    auto arg_sz = std::vector<size_t>();
-    bool todo = false;
-    for (size_t i = 0, e = tup_lam->num_doms(); i != e; ++i) {
-        auto n = flatten(types, tup_lam->dom(i), false);
-        arg_sz.push_back(n);
-        todo |= n != 1;
+void Scalerize::flatten(DefVec& ops, const Def* def) {
+    auto [n, extra] = params(def->type());
+    for (size_t i = 0; i != n; ++i) flatten(ops, elem(def, n, i), &extra);
+}
+
+const Def* Scalerize::unflatten(Defs defs, const Def* dom) {
+    auto [n, extra] = params(dom);
+    size_t j = 0;
+    DefArray ops(n, [&](size_t i) { return unflatten(defs, elem(dom, n, i), j, &extra); });
+    assert(j == defs.size());
+    return n == 1 ? ops.front() : world().tuple(dom, ops);
+}
+
+void Scalerize::flatten_type(DefVec& types, const Def* type, nat_t* extra) {
+    if (auto a = split(type, extra)) {
+        for (size_t i = 0; i != *a; ++i) flatten_type(types, type->proj(*a, i), nullptr);
+    } else {
+        types.emplace_back(flat_type(type));
+    }
+}
+
+void Scalerize::flatten(DefVec& ops, const Def* def, nat_t* extra) {
+    if (auto a = split(def->type(), extra)) {
+        for (size_t i = 0; i != *a; ++i) flatten(ops, def->proj(*a, i), nullptr);
+        return;
     }
 
-    if (!todo) return tup2sca_[tup_lam] = tup_lam;
+    auto type = flat_type(def->type());
+    if (type == def->type()) {
+        ops.emplace_back(def);
+    } else if (auto lam = def->isa_nom<Lam>(); should_expand(lam) && make_scalar(lam)->type() == type) {
+        ops.emplace_back(make_scalar(lam));
+    } else { // wrap continuation: λ flat. def (unflatten flat)
+        auto wrap = world().nom_lam(type->as<Pi>(), def->dbg());
+        wrap->app(def, unflatten(wrap->vars(), def->type()->as<Pi>()->dom()));
+        ops.emplace_back(wrap);
+    }
+}
+
+const Def* Scalerize::unflatten(Defs defs, const Def* type, size_t& j, nat_t* extra) {
+    if (auto a = split(type, extra)) {
+        DefArray ops(*a, [&](size_t i) { return unflatten(defs, type->proj(*a, i), j, nullptr); });
+        return world().tuple(type, ops);
+    }
+
+    auto def = defs[j++];
+    if (def->type() == type) return def;
+
+    // wrap continuation: λ tup. def (flatten tup)
+    auto wrap = world().nom_lam(type->as<Pi>(), def->dbg());
+    DefVec ops;
+    flatten(ops, wrap->var());
+    wrap->app(def, ops);
+    return wrap;
+}
+
+Lam* Scalerize::make_scalar(Lam* tup_lam) {
+    if (auto sca_lam = tup2sca_.lookup(tup_lam)) return *sca_lam;
+
+    auto pi = flat_type(tup_lam->type())->as<Pi>();
+    if (pi == tup_lam->type()) return tup2sca_[tup_lam] = tup_lam;
 
-    auto pi = world().cn(world().sigma(types));
     auto sca_lam = tup_lam->stub(world(), pi, tup_lam->dbg());
     if (eta_exp_) eta_exp_->new2old(sca_lam, tup_lam);
-    size_t n = 0;
     world().DLOG("type {} ~> {}", tup_lam->type(), pi);
-    auto new_vars = world().tuple(DefArray(tup_lam->num_doms(), [&](auto i) {
-        auto new_args = DefArray(arg_sz.at(i), [&](auto j) {
-                return sca_lam->var(n + j);
-        });
-        n += arg_sz.at(i);
-        return unflatten(new_args, tup_lam->dom(i));
-    }));
-    sca_lam->set(tup_lam->apply(new_vars));
     tup2sca_[sca_lam] = sca_lam;
     tup2sca_.emplace(tup_lam, sca_lam);
 
+    sca_lam->set(tup_lam->apply(unflatten(sca_lam->vars(), tup_lam->dom())));
+
     return sca_lam;
 }
 
@@ -62,7 +167,7 @@ const Def* Scalerize::rewrite(const Def* def) {
         if (auto sca_lam = make_scalar(tup_lam); sca_lam != tup_lam) {
             world().DLOG("lambda {} : {} ~> {} : {}", tup_lam, tup_lam->type(), sca_lam, sca_lam->type());
             auto new_args = DefVec();
-            flatten(new_args, app->arg(), false);
+            flatten(new_args, app->arg());
 
             return world().app(sca_lam, new_args);
         }
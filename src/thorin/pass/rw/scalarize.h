@@ -11,7 +11,9 @@ class EtaExp;
 /// <code> f := λ (x_1:[T_1, T_2], .., x_n:T_n).E </code> will be transformed to
 /// <code> f' := λ (y_1:T_1, y_2:T2, .. y_n:T_n).E[x_1\(y_1, y2); ..; x_n\y_n]</code> if
 /// <code>f</code> appears in callee position only, see @p EtaExp.
-/// It will not flatten nominal @p Sigma#s or @p Arr#s.
+/// Nested @p Sigma%s - structural as well as non-dependent, non-recursive nominal ones - and @p Arr%s of at most @p Max_Arity elements are flattened recursively.
+/// From left to right, each parameter is either flattened completely or passed as a whole, so that a continuation ends up with at most @p Max_Params parameters.
+/// Continuation arguments such as the return continuation get flattened signatures as well; where needed, a wrapper converts between both forms.
 class Scalerize : public RWPass<Lam> {
 public:
     Scalerize(PassMan& man, EtaExp* eta_exp)
@@ -19,12 +21,30 @@ public:
         , eta_exp_(eta_exp)
     {}
 
+    static constexpr nat_t Max_Arity  = 16; ///< Larger @p Arr%s are passed as a whole.
+    static constexpr nat_t Max_Params = 32; ///< Flattening stops before a continuation gets more parameters.
+
     const Def* rewrite(const Def*) override;
 
 private:
     bool should_expand(Lam *lam);
     Lam* make_scalar(Lam *lam);
 
+    /// @name flattening
+    //@{
+    /// Flattens the domain of a non-dependent continuation @p type; other types stay as they are.
+    const Def* flat_type(const Def* type);
+    /// Appends the flattened domain value @p def to @p ops - continuations are converted to their flat_type.
+    void flatten(DefVec& ops, const Def* def);
+    /// Inverse of flatten: rebuilds a value of the domain @p dom from @p defs.
+    const Def* unflatten(Defs defs, const Def* dom);
+
+    /// Same as above for a single parameter; @p extra is the number of parameters flattening may still add or @c nullptr if the parameter has to be flattened completely.
+    void flatten_type(DefVec& types, const Def* type, nat_t* extra);
+    void flatten(DefVec& ops, const Def* def, nat_t* extra);
+    const Def* unflatten(Defs defs, const Def* type, size_t& j, nat_t* extra);
+    //@}
+
     EtaExp* eta_exp_;
     Lam2Lam tup2sca_;
 };
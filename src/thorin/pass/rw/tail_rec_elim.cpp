@@ -0,0 +1,55 @@
+#include "thorin/pass/rw/tail_rec_elim.h"
+
+namespace thorin {
+
+/// Does @p lam call itself with @p ret_var as return continuation?
+static bool has_tail_call(Lam* lam, const Def* ret_var) {
+    for (auto use : lam->uses()) {
+        if (auto app = use->isa<App>(); app && use.index() == 0 && app->arg(app->num_args() - 1) == ret_var) return true;
+    }
+    return false;
+}
+
+void TailRecElim::enter() {
+    auto entry   = curr_nom();
+    auto ret_var = entry->ret_var();
+    if (!ret_var) return;
+
+    Lam* loop = nullptr;
+    if (auto l = loop_.lookup(entry)) {
+        loop = *l;
+        if (auto app = entry->body()->isa<App>(); app && app->callee() == loop) return; // already done
+    } else {
+        if (!has_tail_call(entry, ret_var)) return;
+
+        auto n = entry->num_doms() - 1;
+        assert(entry->var(n) == ret_var && "we assume that the last element is the ret_var");
+        DefArray doms(n, [&](size_t i) { return entry->dom(i); });
+        loop = loop_[entry] = world().nom_lam(world().cn(doms), world().dbg(entry->name() + "_loop"));
+
+        // the loop gets the original body; it still returns via the ret_var of the entry
+        DefArray new_vars(n + 1, [&](size_t i) { return i == n ? ret_var : loop->var(i); });
+        loop->set(entry->apply(world().tuple(entry->dom(), new_vars)));
+        world().DLOG("tail recursion in '{}': new loop header '{}'", entry, loop);
+    }
+
+    // This goes through the journal of the PassMan: if an FPPass rolls back to a State before this point, entry gets its original body back.
+    // loop_ and the body of loop survive - so when we enter entry again, we just redo the jump.
+    DefArray args(loop->num_doms(), [&](size_t i) { return entry->var(i); });
+    man().set(entry, {world().lit_false(), world().app(loop, args)});
+}
+
+const Def* TailRecElim::rewrite(const Def* def) {
+    if (auto app = def->isa<App>()) {
+        if (auto entry = app->callee()->isa_nom<Lam>()) {
+            if (auto loop = loop_.lookup(entry); loop && app->arg(app->num_args() - 1) == entry->ret_var()) {
+                DefArray args((*loop)->num_doms(), [&](size_t i) { return app->arg(i); });
+                return world().app(*loop, args, app->dbg());
+            }
+        }
+    }
+
+    return def;
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef THORIN_PASS_RW_TAIL_REC_ELIM_H
+#define THORIN_PASS_RW_TAIL_REC_ELIM_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Turns self-recursive tail calls of a returning @p Lam into a loop.
+/// If <code>f</code> calls itself and passes its own return continuation, we split <code>f</code> into
+/// * an entry <code>f</code> that just jumps to
+/// * a new basic block <code>f_loop</code> that carries the original body and receives all but the return continuation of <code>f</code>.
+///
+/// Afterwards, all calls <code>f(args, ret)</code> within <code>f_loop</code> where @c ret is <code>f</code>'s return continuation become <code>f_loop(args)</code>.
+/// Thus, the code generators emit a real loop with phis instead of calls.
+class TailRecElim : public RWPass<Lam> {
+public:
+    TailRecElim(PassMan& man)
+        : RWPass(man, "tail_rec_elim")
+    {}
+
+    void enter() override;
+    const Def* rewrite(const Def*) override;
+
+private:
+    LamMap<Lam*> loop_; ///< Entry -> loop header.
+};
+
+}
+
+#endif
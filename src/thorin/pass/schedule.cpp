@@ -0,0 +1,72 @@
+#include "thorin/pass/schedule.h"
+
+#include <algorithm>
+
+#include "thorin/util/container.h"
+
+namespace thorin {
+
+/// All @em noms referenced by @p nom's extended_ops - without entering other @em noms.
+static std::vector<Def*> succs(Def* nom) {
+    std::vector<Def*> result;
+    unique_queue<DefSet> queue;
+    for (auto op : nom->extended_ops()) queue.push(op);
+
+    while (!queue.empty()) {
+        auto def = queue.pop();
+        if (def->no_dep()) continue;
+
+        if (auto succ = def->isa_nom()) {
+            if (succ != nom) result.emplace_back(succ);
+        } else if (auto var = def->isa<Var>()) {
+            if (var->nom() != nom) result.emplace_back(var->nom());
+        } else {
+            for (auto op : def->extended_ops()) queue.push(op);
+        }
+    }
+
+    return result;
+}
+
+void CallGraphSchedule::init(PassMan&, ArrayRef<Def*> externals) {
+    nom2index_.clear();
+    NomSet done;
+    std::vector<std::pair<Def*, std::vector<Def*>>> stack; // (nom, succs not yet visited in reverse order)
+    size_t post = 0;
+
+    auto enter = [&](Def* nom) {
+        if (!done.emplace(nom).second) return;
+        auto s = succs(nom);
+        std::reverse(s.begin(), s.end());
+        stack.emplace_back(nom, std::move(s));
+    };
+
+    for (auto external : externals) {
+        enter(external);
+        while (!stack.empty()) {
+            auto& [nom, todo] = stack.back();
+            if (todo.empty()) {
+                nom2index_[nom] = post++;
+                stack.pop_back();
+            } else {
+                auto succ = todo.back();
+                todo.pop_back();
+                enter(succ); // invalidates nom and todo
+            }
+        }
+    }
+
+    if (order() == Order::RPO) {
+        for (auto& [_, index] : nom2index_) index = post - 1 - index;
+    }
+}
+
+size_t CallGraphSchedule::priority(const PassMan& man, Def* nom) {
+    if (auto index = nom2index_.lookup(nom)) return *index;
+    if (auto curr = man.curr_nom()) {
+        if (auto index = nom2index_.lookup(curr)) return *index;
+    }
+    return 0;
+}
+
+}
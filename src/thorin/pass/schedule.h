@@ -0,0 +1,34 @@
+#ifndef THORIN_PASS_SCHEDULE_H
+#define THORIN_PASS_SCHEDULE_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/**
+ * Orders the @em noms by a depth-first traversal of the graph whose edges lead from each @em nom to the @em noms it references.
+ * * Order::RPO visits users before the @em noms they reference - as far as cycles permit.
+ *   FPPass%es like BetaRed or EtaExp that roll back whenever they discover yet another use of an already visited @em nom profit most.
+ * * Order::Post_Order visits callees before their callers.
+ * @em Noms unknown to init - usually created by a pass - inherit the priority of PassMan::curr_nom.
+ */
+class CallGraphSchedule : public NomSchedule {
+public:
+    enum class Order { RPO, Post_Order };
+
+    CallGraphSchedule(Order order = Order::RPO)
+        : order_(order)
+    {}
+
+    Order order() const { return order_; }
+    void init(PassMan&, ArrayRef<Def*> externals) override;
+    size_t priority(const PassMan&, Def* nom) override;
+
+private:
+    Order order_;
+    NomMap<size_t> nom2index_;
+};
+
+}
+
+#endif
@@ -1,32 +1,81 @@
 #include "thorin/rewrite.h"
 
+#include <algorithm>
+
 #include "thorin/world.h"
 #include "thorin/analyses/scope.h"
 
 namespace thorin {
 
 const Def* Rewriter::rewrite(const Def* old_def) {
-    if (auto new_def = old2new.lookup(old_def)) return *new_def;
-    if (scope != nullptr && !scope->bound(old_def)) return old_def;
-
-    auto new_type = rewrite(old_def->type());
-    auto new_dbg = old_def->dbg() ? rewrite(old_def->dbg()) : nullptr;
+    if (auto new_def = known(old_def)) return *new_def;
+
+    auto base = stack_.size();
+    stack_.emplace_back(Frame{old_def, 0, nullptr, nullptr, nullptr, ops_.size()});
+    const Def* result = nullptr;
+    bool has_result = false;
+
+    while (true) {
+        auto& frame = stack_.back();
+        auto old_nom = frame.old_def->isa_nom();
+
+        // hand over the result of the Frame we have just finished or of an operand that was known anyway
+        auto consume = [&](const Def* new_def) {
+            if (frame.i == 0)
+                frame.new_type = new_def;
+            else if (frame.i == 1)
+                frame.new_dbg = new_def;
+            else if (old_nom)
+                frame.new_nom->set(frame.i - 2, new_def);
+            else
+                ops_.emplace_back(new_def);
+            ++frame.i;
+        };
+
+        if (has_result) {
+            consume(result);
+            has_result = false;
+        }
 
-    if (auto old_nom = old_def->isa_nom()) {
-        auto new_nom = old_nom->stub(new_world, new_type, new_dbg);
-        old2new[old_nom] = new_nom;
+        const Def* next = nullptr;
+        for (auto e = frame.old_def->num_ops() + 2; next == nullptr;) {
+            if (old_nom && frame.i == 2 && frame.new_nom == nullptr) {
+                frame.new_nom = old_nom->stub(new_world, frame.new_type, frame.new_dbg);
+                old2new[old_nom] = frame.new_nom;
+            }
+
+            if (frame.i == e) break;
+
+            auto old_op = frame.i == 0 ? frame.old_def->type()
+                        : frame.i == 1 ? frame.old_def->dbg()
+                        :                frame.old_def->op(frame.i - 2);
+            if (old_op == nullptr) { // no dbg or unset op of a nom
+                ++frame.i;
+            } else if (auto new_op = known(old_op)) {
+                consume(*new_op);
+            } else {
+                next = old_op;
+            }
+        }
 
-        for (size_t i = 0, e = old_nom->num_ops(); i != e; ++i) {
-            if (auto old_op = old_nom->op(i)) new_nom->set(i, rewrite(old_op));
+        if (next != nullptr) {
+            stack_.emplace_back(Frame{next, 0, nullptr, nullptr, nullptr, ops_.size()});
+            continue;
         }
 
-        if (auto new_def = new_nom->restructure()) return old2new[old_nom] = new_def;
+        if (old_nom) {
+            result = frame.new_nom;
+            if (auto new_def = frame.new_nom->restructure()) result = old2new[old_nom] = new_def;
+        } else {
+            auto new_ops = Defs(ops_).skip_front(frame.ops);
+            result = old2new[frame.old_def] = frame.old_def->rebuild(new_world, frame.new_type, new_ops, frame.new_dbg);
+            ops_.resize(frame.ops);
+        }
 
-        return new_nom;
+        stack_.pop_back();
+        if (stack_.size() == base) return result;
+        has_result = true;
     }
-
-    DefArray new_ops(old_def->num_ops(), [&](auto i) { return rewrite(old_def->op(i)); });
-    return old2new[old_def] = old_def->rebuild(new_world, new_type, new_ops, new_dbg);
 }
 
 const Def* rewrite(const Def* def, const Def* old_def, const Def* new_def, const Scope& scope) {
@@ -39,20 +88,67 @@ const Def* rewrite(Def* nom, const Def* arg, size_t i, const Scope& scope) {
     return rewrite(nom->op(i), nom->var(), arg, scope);
 }
 
+/*
+ * Substituting nom's Var doesn't need nom's Scope in these cases:
+ * 1. nom's Var has never been created; so, nothing can refer to it.
+ * 2. No op depends on a nom; so, there is no nested Scope and the Def%s that depend on Var%s are exactly the ones to rebuild.
+ */
+static bool needs_scope(Def* nom) {
+    auto ops = nom->ops();
+    return nom->has_var() && std::any_of(ops.begin(), ops.end(), [](const Def* op) { return op == nullptr || op->has_dep(Dep::Nom); });
+}
+
+/// Rewrites @p nom's ops in <tt>[begin, end)</tt> without @p nom's Scope - see needs_scope.
+static DefArray rewrite_simple(Def* nom, const Def* arg, size_t begin, size_t end) {
+    auto var = nom->has_var();
+    if (var == nullptr) return DefArray(nom->ops().skip_front(begin).skip_back(nom->num_ops() - end));
+
+    Rewriter rewriter(nom->world());
+    rewriter.only_var_deps = true;
+    rewriter.old2new[var] = arg;
+    return DefArray(end - begin, [&](size_t i) { return rewriter.rewrite(nom->op(begin + i)); });
+}
+
 const Def* rewrite(Def* nom, const Def* arg, size_t i) {
+    if (!needs_scope(nom)) return rewrite_simple(nom, arg, i, i + 1).front();
     Scope scope(nom);
     return rewrite(nom, arg, i, scope);
 }
 
-DefArray rewrite(Def* nom, const Def* arg, const Scope& scope) {
+DefArray rewrite(Def* nom, const Def* arg, const Scope& scope, std::vector<Def*>* noms) {
     Rewriter rewriter(nom->world(), &scope);
     rewriter.old2new[nom->var()] = arg;
-    return DefArray(nom->num_ops(), [&](size_t i) { return rewriter.rewrite(nom->op(i)); });
+    DefArray result(nom->num_ops(), [&](size_t i) { return rewriter.rewrite(nom->op(i)); });
+
+    if (noms != nullptr) {
+        for (const auto& [old_def, _] : rewriter.old2new) {
+            if (auto old_nom = old_def->isa_nom()) noms->emplace_back(old_nom);
+        }
+    }
+
+    return result;
 }
 
-DefArray rewrite(Def* nom, const Def* arg) {
+DefArray rewrite(Def* nom, const Def* arg, std::vector<Def*>* noms) {
+    if (!needs_scope(nom)) return rewrite_simple(nom, arg, 0, nom->num_ops());
     Scope scope(nom);
-    return rewrite(nom, arg, scope);
+    return rewrite(nom, arg, scope, noms);
+}
+
+std::vector<DefArray> rewrite_each(Def* nom, Defs args, std::vector<std::vector<Def*>>* noms) {
+    std::vector<DefArray> result;
+    result.reserve(args.size());
+    if (noms != nullptr) noms->resize(args.size());
+
+    if (!needs_scope(nom)) {
+        for (auto arg : args) result.emplace_back(rewrite_simple(nom, arg, 0, nom->num_ops()));
+    } else {
+        Scope scope(nom);
+        for (size_t i = 0, e = args.size(); i != e; ++i)
+            result.emplace_back(rewrite(nom, args[i], scope, noms != nullptr ? &(*noms)[i] : nullptr));
+    }
+
+    return result;
 }
 
 void cleanup(World& old_world) {
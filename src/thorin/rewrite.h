@@ -6,7 +6,11 @@
 
 namespace thorin {
 
-/// Rewrites part of a program.
+/**
+ * Rewrites part of a program.
+ * Instead of recursing, rewrite keeps its pending work on an explicit stack.
+ * This stack and the buffer for the new ops of structural Def%s are reused across all invocations.
+ */
 class Rewriter {
 public:
     Rewriter(World& old_world, World& new_world, const Scope* scope = nullptr)
@@ -27,6 +31,31 @@ public:
     World& new_world;
     const Scope* scope;
     Def2Def old2new;
+    /// If set, Def%s that don't depend on any Var are never rewritten - unless explicitly mapped in @p old2new.
+    /// This is only sound within the same World.
+    bool only_var_deps = false;
+
+private:
+    /// Yields the result of rewriting @p old_def if no further work is needed.
+    std::optional<const Def*> known(const Def* old_def) {
+        if (auto new_def = old2new.lookup(old_def)) return *new_def;
+        if (only_var_deps && !old_def->has_dep(Dep::Var)) return old_def;
+        if (scope != nullptr && !scope->bound(old_def)) return old_def;
+        return {};
+    }
+
+    /// A pending rewrite of @p old_def; handles its type, then its dbg, and finally its ops.
+    struct Frame {
+        const Def* old_def;
+        size_t i = 0;                 ///< Next operand: @c 0 is the type, @c 1 is dbg, and @c i+2 is the @c i^th op.
+        const Def* new_type = nullptr;
+        const Def* new_dbg  = nullptr;
+        Def* new_nom        = nullptr; ///< Stub - if @p old_def is a @em nom.
+        size_t ops;                    ///< Offset of the new ops within ops_ - if @p old_def is structural.
+    };
+
+    std::vector<Frame> stack_;
+    std::vector<const Def*> ops_;
 };
 
 /// Rewrites @p def by mapping @p old_def to @p new_def while obeying @p scope.
@@ -39,10 +68,15 @@ const Def* rewrite(Def* nom, const Def* arg, size_t i);
 const Def* rewrite(Def* nom, const Def* arg, size_t i, const Scope& scope);
 
 /// Rewrites @p nom's ops by substituting @p nom's @p Var with @p arg while obeying @p nom's @p scope.
-DefArray rewrite(Def* nom, const Def* arg);
+/// If given, all nested @em noms that have been copied along the way are appended to @p noms.
+DefArray rewrite(Def* nom, const Def* arg, std::vector<Def*>* noms = nullptr);
 
 /// Same as above but uses @p scope as an optimization instead of computing a new @p Scope.
-DefArray rewrite(Def* nom, const Def* arg, const Scope& scope);
+DefArray rewrite(Def* nom, const Def* arg, const Scope& scope, std::vector<Def*>* noms = nullptr);
+
+/// Same as <tt>rewrite(nom, args[i], &(*noms)[i])</tt> for each @p i but computes @p nom's @p Scope at most once.
+/// If given, @p noms is resized to <tt>args.size()</tt> first.
+std::vector<DefArray> rewrite_each(Def* nom, Defs args, std::vector<std::vector<Def*>>* noms = nullptr);
 
 /// Removes unreachable and dead code by rebuilding the whole @p world into a new @p World.
 void cleanup(World& world);
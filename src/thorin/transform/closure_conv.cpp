@@ -14,6 +14,7 @@ void ClosureConv::run() {
     auto externals = std::vector(world().externals().begin(), world().externals().end());
     auto subst = Def2Def();
     world().DLOG("===== ClosureConv: start =====");
+    fva_.init();
     for (auto [_, ext_def]: externals) {
         rewrite(ext_def, subst);
     }
@@ -172,7 +173,9 @@ std::pair<FVA::Node*, bool> FVA::build_node(Lam *lam, NodeQueue& worklist) {
     auto node = p->second.get();
     node->lam = lam;
     node->pass_id = 0;
-    auto scope = Scope(lam);
+    // lams created during closure conversion are not part of scopes_ - Scope falls back to its own analysis then
+    assert(scopes_ && "call FVA::init first");
+    Scope scope(*scopes_, lam);
     node->fvs = DefSet();
     for (auto v: scope.free_defs()) {
         split_fv(v, node->fvs);
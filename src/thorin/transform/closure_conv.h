@@ -17,6 +17,8 @@ public:
         , cur_pass_id(1)
         , lam2nodes_() {};
 
+    /// Computes the ScopeTree of the World before it is modified.
+    void init() { scopes_ = std::make_unique<ScopeTree>(world()); }
     DefSet& run(Lam *lam);
 
 private:
@@ -48,6 +50,7 @@ private:
     World& world_;
     unsigned cur_pass_id;
     DefMap<std::unique_ptr<Node>> lam2nodes_;
+    std::unique_ptr<ScopeTree> scopes_;
 };
 
 class ClosureConv {
@@ -51,10 +51,11 @@ std::vector<Lam*> succs(Lam* lam) {
 
 class PartialEvaluator {
 public:
-    PartialEvaluator(World& world, bool lower2cff)
+    PartialEvaluator(World& world, bool lower2cff, size_t fuel)
         : world_(world)
         , lower2cff_(lower2cff)
         , boundary_(world.curr_gid())
+        , fuel_(fuel)
     {}
 
     World& world() { return world_; }
@@ -73,6 +74,7 @@ private:
     std::queue<Lam*> queue_;
     LamMap<bool> top_level_;
     size_t boundary_;
+    size_t fuel_;
 };
 
 class CondEval {
@@ -220,21 +222,28 @@ bool PartialEvaluator::run() {
 
                 if (fold) {
                     auto app = world().app(callee, args)->as<App>();
-                    const auto& p = cache_.emplace(app, nullptr);
-                    Lam*& target = p.first->second;
-                    // create new specialization if not found in cache
-                    if (p.second) {
-                        target = drop(app);
-                        todo = true;
-                    }
-
-                    app_to_dropped_app(lam, target, app);
-
-                    if (lower2cff_ && fold) {
-                        // re-examine next iteration:
-                        // maybe the specialization is not top-level anymore which might need further specialization
-                        queue_.push(lam);
-                        continue;
+                    // lower2cff and pe::run must specialize - the fuel only limits the optional specializations
+                    bool fueled = !lower2cff_ && !force_fold;
+                    if (fueled && fuel_ == 0 && !cache_.contains(app)) {
+                        world().WLOG("out of fuel; won't specialize {}", callee);
+                    } else {
+                        const auto& p = cache_.emplace(app, nullptr);
+                        Lam*& target = p.first->second;
+                        // create new specialization if not found in cache
+                        if (p.second) {
+                            target = drop(app);
+                            todo = true;
+                            if (fueled) --fuel_;
+                        }
+
+                        app_to_dropped_app(lam, target, app);
+
+                        if (lower2cff_) {
+                            // re-examine next iteration:
+                            // maybe the specialization is not top-level anymore which might need further specialization
+                            queue_.push(lam);
+                            continue;
+                        }
                     }
                 }
             }
@@ -249,10 +258,10 @@ bool PartialEvaluator::run() {
 
 //------------------------------------------------------------------------------
 
-bool partial_evaluation(World& world, bool lower2cff) {
+bool partial_evaluation(World& world, bool lower2cff, size_t fuel) {
     auto name = lower2cff ? "lower2cff" : "partial_evaluation";
     world.VLOG("start {}", name);
-    auto res = PartialEvaluator(world, lower2cff).run();
+    auto res = PartialEvaluator(world, lower2cff, fuel).run();
     world.VLOG("end {}", name);
     return res;
 }
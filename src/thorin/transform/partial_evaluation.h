@@ -1,11 +1,16 @@
 #ifndef THORIN_TRANSFORM_PARTIAL_EVALUATION_H
 #define THORIN_TRANSFORM_PARTIAL_EVALUATION_H
 
+#include <cstddef>
+#include <limits>
+
 namespace thorin {
 
 class World;
 
-bool partial_evaluation(World&, bool lower2cff = false);
+/// Stops to create new specializations after @p fuel many have been created - already known ones are still reused.
+/// The @p fuel neither limits @p lower2cff nor calls marked with @c pe::run as these must be specialized.
+bool partial_evaluation(World&, bool lower2cff = false, size_t fuel = std::numeric_limits<size_t>::max());
 
 }
 
@@ -0,0 +1,80 @@
+#ifndef THORIN_UTIL_INTERNED_SET_H
+#define THORIN_UTIL_INTERNED_SET_H
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "thorin/util/hash.h"
+
+namespace thorin {
+
+/**
+ * Hash-conses immutable sets of @p T - pointers to objects with a @c gid - that are sorted by gid.
+ * Equal sets share the same address: comparing two of them is a pointer comparison and a set is stored only once, no matter how many users it has.
+ * A Set stays valid until clear.
+ */
+template<class T>
+class InternedSet {
+public:
+    using Set = const std::vector<T>*;
+
+    InternedSet(const InternedSet&) = delete;
+    InternedSet& operator=(InternedSet) = delete;
+
+    InternedSet()
+        : empty_(intern({}))
+    {}
+
+    Set empty() const { return empty_; }
+    Set intern(std::vector<T>&& elems) {
+        if (auto i = sets_.find(&elems); i != sets_.end()) return *i;
+        auto result = &pool_.emplace_back(std::move(elems));
+        sets_.emplace(result);
+        return result;
+    }
+    Set merge(Set a, Set b) {
+        if (a == b || b->empty()) return a;
+        if (a->empty()) return b;
+
+        std::vector<T> result;
+        result.reserve(a->size() + b->size());
+        std::set_union(a->begin(), a->end(), b->begin(), b->end(), std::back_inserter(result), lt);
+        return intern(std::move(result));
+    }
+    Set erase(Set set, T elem) {
+        auto i = std::lower_bound(set->begin(), set->end(), elem, lt);
+        if (i == set->end() || *i != elem) return set;
+
+        std::vector<T> result(set->begin(), i);
+        result.insert(result.end(), i + 1, set->end());
+        return intern(std::move(result));
+    }
+    /// Frees all Set%s - including empty.
+    void clear() {
+        sets_  = HashSet<Set, SetHash>();
+        pool_  = std::deque<std::vector<T>>();
+        empty_ = nullptr;
+    }
+
+private:
+    static bool lt(T a, T b) { return a->gid() < b->gid(); }
+
+    struct SetHash {
+        static hash_t hash(Set set) {
+            hash_t seed = hash_begin();
+            for (auto elem : *set) seed = hash_combine(seed, elem->gid());
+            return seed;
+        }
+        static bool eq(Set a, Set b) { return *a == *b; }
+        static Set sentinel() { return Set(1); }
+    };
+
+    std::deque<std::vector<T>> pool_; ///< Owns the Set%s; a @c std::deque doesn't move its elements.
+    HashSet<Set, SetHash> sets_;
+    Set empty_;
+};
+
+}
+
+#endif
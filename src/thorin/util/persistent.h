@@ -0,0 +1,336 @@
+#ifndef THORIN_UTIL_PERSISTENT_H
+#define THORIN_UTIL_PERSISTENT_H
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "thorin/util/bit.h"
+#include "thorin/util/hash.h"
+
+namespace thorin {
+
+/**
+ * A persistent min-heap implemented as a leftist heap.
+ * Copying is O(1); @p push and @p pop are O(log n) and never affect other copies.
+ */
+template<class T, class Lt = std::less<T>>
+class PersistentHeap {
+private:
+    struct Node;
+    using Ptr = std::shared_ptr<const Node>;
+
+    struct Node {
+        Node(const T& value, size_t rank, Ptr left, Ptr right)
+            : value(value)
+            , rank(rank)
+            , left(std::move(left))
+            , right(std::move(right))
+        {}
+
+        T value;
+        size_t rank; ///< Length of the right spine.
+        Ptr left, right;
+    };
+
+    static size_t rank(const Ptr& n) { return n ? n->rank : 0; }
+
+    static Ptr merge(const Ptr& a, const Ptr& b) {
+        if (!a) return b;
+        if (!b) return a;
+        if (Lt()(b->value, a->value)) return merge(b, a);
+
+        auto l = a->left;
+        auto r = merge(a->right, b);
+        if (rank(l) < rank(r)) std::swap(l, r);
+        return std::make_shared<const Node>(a->value, rank(r) + 1, std::move(l), std::move(r));
+    }
+
+public:
+    bool empty() const { return root_ == nullptr; }
+    size_t size() const { return size_; }
+    const T& top() const { assert(!empty()); return root_->value; } ///< Smallest element.
+    void push(const T& value) { root_ = merge(root_, std::make_shared<const Node>(value, 1, nullptr, nullptr)); ++size_; }
+    void pop() { assert(!empty()); root_ = merge(root_->left, root_->right); --size_; }
+
+private:
+    Ptr root_;
+    size_t size_ = 0;
+};
+
+template<class T, class Lt>
+T pop(PersistentHeap<T, Lt>& heap) {
+    auto result = heap.top();
+    heap.pop();
+    return result;
+}
+
+namespace detail {
+
+/**
+ * Hash array mapped trie with path copying.
+ * A Node or Leaf that is referenced by more than one trie is shared and, hence, immutable.
+ * Writing to a trie copies all shared Node%s on the path from the root to the affected Leaf.
+ * Thus, copying a trie is O(1) while a write costs O(log_32 n) - only the first time after a copy.
+ * Each entry lives in its own Leaf, so inserting further entries never moves existing ones.
+ */
+template<class Key, class Entry, class H>
+class PersistentTrie {
+protected:
+    static constexpr size_t Bits = 5;
+    static constexpr hash_t Mask = (1 << Bits) - 1;
+    static constexpr size_t Max_Shift = sizeof(hash_t) * 8;
+
+    struct Leaf {
+        template<class... Args>
+        Leaf(hash_t hash, Args&&... args)
+            : hash(hash)
+            , entry(std::forward<Args>(args)...)
+        {}
+
+        hash_t hash;
+        Entry entry;
+    };
+
+    struct Node;
+    struct Slot {
+        std::shared_ptr<Node> node; ///< Either this one ...
+        std::shared_ptr<Leaf> leaf; ///< ... or this one is set.
+    };
+
+    /// Below @p Max_Shift, @p bitmap tells which slots are occupied; beyond, @p slots is a plain list of colliding Leaf%s.
+    struct Node {
+        uint32_t bitmap = 0;
+        std::vector<Slot> slots;
+    };
+
+    static const Key& key(const Entry& entry) {
+        if constexpr (std::is_same<Key, Entry>::value)
+            return entry;
+        else
+            return entry.first;
+    }
+
+    static size_t index(uint32_t bitmap, uint32_t bit) { return bitcount(bitmap & (bit - 1)); }
+
+    /// Makes sure that @p ptr is not shared with other tries.
+    template<class T>
+    static T* own(std::shared_ptr<T>& ptr) {
+        if (ptr.use_count() != 1) ptr = std::make_shared<T>(*ptr);
+        return ptr.get();
+    }
+
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = Entry;
+        using reference         = const Entry&;
+        using pointer           = const Entry*;
+
+        iterator() = default;
+        iterator(const Node* root) {
+            if (root != nullptr) {
+                stack_.emplace_back(root, 0);
+                advance();
+            }
+        }
+
+        iterator& operator++() { advance(); return *this; }
+        iterator operator++(int) { auto res = *this; advance(); return res; }
+        reference operator*() const { return leaf_->entry; }
+        pointer operator->() const { return &leaf_->entry; }
+        bool operator==(const iterator& other) const { return leaf_ == other.leaf_; }
+        bool operator!=(const iterator& other) const { return leaf_ != other.leaf_; }
+
+    private:
+        void advance() {
+            leaf_ = nullptr;
+            while (!stack_.empty()) {
+                auto& [node, i] = stack_.back();
+                if (i == node->slots.size()) {
+                    stack_.pop_back();
+                    continue;
+                }
+
+                const auto& slot = node->slots[i++];
+                if (slot.leaf) {
+                    leaf_ = slot.leaf.get();
+                    return;
+                }
+                stack_.emplace_back(slot.node.get(), 0);
+            }
+        }
+
+        std::vector<std::pair<const Node*, size_t>> stack_;
+        const Leaf* leaf_ = nullptr;
+    };
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    iterator begin() const { return iterator(root_.get()); }
+    iterator end() const { return iterator(); }
+
+    /// Yields the entry of @p k or @c nullptr.
+    const Entry* find(const Key& k) const {
+        if (!root_) return nullptr;
+
+        auto hash = H::hash(k);
+        const Node* node = root_.get();
+        for (size_t shift = 0;; shift += Bits) {
+            if (shift >= Max_Shift) {
+                for (const auto& slot : node->slots) {
+                    if (H::eq(key(slot.leaf->entry), k)) return &slot.leaf->entry;
+                }
+                return nullptr;
+            }
+
+            uint32_t bit = 1u << ((hash >> shift) & Mask);
+            if ((node->bitmap & bit) == 0) return nullptr;
+
+            const auto& slot = node->slots[index(node->bitmap, bit)];
+            if (slot.leaf) return H::eq(key(slot.leaf->entry), k) ? &slot.leaf->entry : nullptr;
+            node = slot.node.get();
+        }
+    }
+
+    bool contains(const Key& k) const { return find(k) != nullptr; }
+
+    /// Removes @p k and yields whether it has been there; emptied Node%s stay in place.
+    bool erase(const Key& k) {
+        if (!contains(k)) return false; // don't copy anything
+
+        auto hash = H::hash(k);
+        auto node = own(root_);
+        for (size_t shift = 0;; shift += Bits) {
+            if (shift >= Max_Shift) {
+                auto i = std::find_if(node->slots.begin(), node->slots.end(), [&](const auto& slot) { return H::eq(key(slot.leaf->entry), k); });
+                node->slots.erase(i);
+                break;
+            }
+
+            uint32_t bit = 1u << ((hash >> shift) & Mask);
+            auto i = index(node->bitmap, bit);
+            if (auto& slot = node->slots[i]; slot.leaf) {
+                node->bitmap &= ~bit;
+                node->slots.erase(node->slots.begin() + i);
+                break;
+            }
+            node = own(node->slots[i].node);
+        }
+
+        --size_;
+        return true;
+    }
+
+protected:
+    /**
+     * Yields the entry of @p k and whether it has been newly constructed from @p args.
+     * The entry is owned by @c this trie only, so it may be modified until @c this trie is copied.
+     */
+    template<class... Args>
+    std::pair<Entry*, bool> emplace_(const Key& k, Args&&... args) {
+        auto hash = H::hash(k);
+        auto make = [&]() { ++size_; return std::make_shared<Leaf>(hash, std::forward<Args>(args)...); };
+
+        if (!root_) root_ = std::make_shared<Node>();
+        auto node = own(root_);
+
+        for (size_t shift = 0;; shift += Bits) {
+            if (shift >= Max_Shift) {
+                for (auto& slot : node->slots) {
+                    if (H::eq(key(slot.leaf->entry), k)) return {&own(slot.leaf)->entry, false};
+                }
+                auto& slot = node->slots.emplace_back(Slot{nullptr, make()});
+                return {&slot.leaf->entry, true};
+            }
+
+            uint32_t bit = 1u << ((hash >> shift) & Mask);
+            auto i = index(node->bitmap, bit);
+            if ((node->bitmap & bit) == 0) {
+                node->bitmap |= bit;
+                auto slot = node->slots.emplace(node->slots.begin() + i, Slot{nullptr, make()});
+                return {&slot->leaf->entry, true};
+            }
+
+            auto& slot = node->slots[i];
+            if (slot.leaf) {
+                if (H::eq(key(slot.leaf->entry), k)) return {&own(slot.leaf)->entry, false};
+
+                // push the old Leaf one level down and retry there
+                auto down = std::make_shared<Node>();
+                if (auto next = shift + Bits; next < Max_Shift) down->bitmap = 1u << ((slot.leaf->hash >> next) & Mask);
+                down->slots.emplace_back(Slot{nullptr, std::move(slot.leaf)});
+                slot.node = std::move(down);
+            }
+
+            node = own(slot.node);
+        }
+    }
+
+private:
+    std::shared_ptr<Node> root_;
+    size_t size_ = 0;
+};
+
+}
+
+/**
+ * A persistent hash map with the interface of a (small) subset of HashMap.
+ * Copying is O(1) as all copies share their structure.
+ * @attention References to values obtained from a non-const member function refer to memory
+ * that becomes shared with all copies made afterwards - do not write through them anymore after copying the map.
+ */
+template<class Key, class T, class H>
+class PersistentMap : public detail::PersistentTrie<Key, std::pair<const Key, T>, H> {
+public:
+    using key_type    = Key;
+    using mapped_type = T;
+    using value_type  = std::pair<const Key, T>;
+
+    /// Returns a pointer to the - possibly already existing - entry and whether a new one has been inserted.
+    template<class... Args>
+    std::pair<value_type*, bool> emplace(const Key& key, Args&&... args) {
+        return this->emplace_(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    T& operator[](const Key& key) { return emplace(key).first->second; }
+
+    std::optional<T> lookup(const Key& key) const {
+        if (auto entry = this->find(key)) return entry->second;
+        return {};
+    }
+};
+
+/// A persistent hash set; see PersistentMap.
+template<class Key, class H>
+class PersistentSet : public detail::PersistentTrie<Key, Key, H> {
+public:
+    using key_type   = Key;
+    using value_type = Key;
+
+    std::pair<const Key*, bool> emplace(const Key& key) { return this->emplace_(key, key); }
+    bool insert(const Key& key) { return emplace(key).second; }
+
+    template<class R>
+    bool insert_range(const R& range) {
+        if constexpr (std::is_same<R, PersistentSet>::value) {
+            if (this->empty()) {
+                *this = range; // O(1)
+                return !range.empty();
+            }
+        }
+
+        bool res = false;
+        for (const auto& key : range) res |= insert(key);
+        return res;
+    }
+};
+
+}
+
+#endif
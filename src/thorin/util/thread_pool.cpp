@@ -0,0 +1,98 @@
+#include "thorin/util/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace thorin {
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    workers_.reserve(num_threads);
+    for (size_t i = 0; i != num_threads; ++i)
+        workers_.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+std::unique_ptr<ThreadPool> ThreadPool::global_;
+
+ThreadPool& ThreadPool::enable_global(size_t num_threads) {
+    if (!global_) global_ = std::make_unique<ThreadPool>(num_threads);
+    return *global_;
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [&] { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+bool ThreadPool::run_one() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) return false;
+        task = std::move(tasks_.front());
+        tasks_.pop();
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::parallel_for(size_t n, std::function<void(size_t)> f) {
+    if (n == 0) return;
+    if (n == 1 || num_threads() == 1) {
+        for (size_t i = 0; i != n; ++i) f(i);
+        return;
+    }
+
+    size_t num_tasks = std::min(n, num_threads() + 1); // the caller runs one of them
+    std::atomic<size_t> next(0);
+    size_t finished = 0;
+    std::mutex finished_mutex;
+    std::condition_variable finished_cond;
+
+    // each task greedily grabs indices until none are left
+    auto task = [&] {
+        for (size_t i; (i = next++) < n;) f(i);
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        if (++finished == num_tasks) finished_cond.notify_all();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 1; i != num_tasks; ++i) tasks_.emplace(task);
+    }
+    cond_.notify_all();
+
+    task();
+
+    // all tasks capture our locals, so wait until each of them has finished - help out in the meantime
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(finished_mutex);
+            if (finished == num_tasks) return;
+        }
+        if (!run_one()) break;
+    }
+
+    std::unique_lock<std::mutex> lock(finished_mutex);
+    finished_cond.wait(lock, [&] { return finished == num_tasks; });
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef THORIN_UTIL_THREAD_POOL_H
+#define THORIN_UTIL_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace thorin {
+
+/**
+ * A simple fixed-size pool of worker threads.
+ * Thorin doesn't start any threads on its own:
+ * The process-wide instance ThreadPool::global - which the Scheduler uses for large Scope%s - only exists after ThreadPool::enable_global.
+ */
+class ThreadPool {
+public:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool) = delete;
+
+    /// Spawns @p num_threads workers; @c 0 means @c std::thread::hardware_concurrency.
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    size_t num_threads() const { return workers_.size(); }
+
+    /**
+     * Invokes @p f(i) for all @c i in <tt>[0, n)</tt> and blocks until all invocations are done.
+     * The calling thread participates in the work, so nested calls to @p parallel_for do not deadlock.
+     * Invocations of @p f for different @c i must not race with each other.
+     */
+    void parallel_for(size_t n, std::function<void(size_t)> f);
+
+    /// @name process-wide instance
+    //@{
+    /// Yields the process-wide instance or @c nullptr if enable_global hasn't been invoked.
+    static ThreadPool* global() { return global_.get(); }
+    /// Creates the process-wide instance with @p num_threads workers - if it doesn't exist yet.
+    /// Invoke this before any other thread uses global.
+    static ThreadPool& enable_global(size_t num_threads = 0);
+    /// Joins and destroys the process-wide instance.
+    static void disable_global() { global_.reset(); }
+    //@}
+
+private:
+    void work();
+    bool run_one();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ = false;
+
+    static std::unique_ptr<ThreadPool> global_;
+};
+
+}
+
+#endif
@@ -26,9 +26,11 @@ namespace thorin {
  */
 
 #ifndef NDEBUG
-bool World::Arena::Lock::guard_ = false;
+thread_local bool World::Arena::Lock::guard_ = false;
 #endif
 
+thread_local size_t World::num_gids_ = 0;
+
 World::World(const std::string& name)
     : checker_(std::make_unique<Checker>(*this))
 {
@@ -788,6 +790,68 @@ const Def* World::op_lea(const Def* ptr, const Def* index, const Def* dbg) {
     return app(app(ax_lea(), {pointee->arity(), Ts, addr_space}), {ptr, index}, dbg);
 }
 
+/*
+ * reclamation
+ */
+
+size_t World::reclaim(size_t mark) {
+    auto guard = lock();
+    if (is_concurrent()) return 0;
+
+    auto& journal = data_.journal_;
+    auto end = journal.size();
+    for (auto i = end; i-- != mark;) {
+        auto def = journal[i];
+        if (!def->uses().empty() || def->no_dep() || def->isa<Var>()) {
+            journal[--end] = def; // keep it - the kept ones end up in their original order behind the reclaimed ones
+            continue;
+        }
+
+        data_.defs_.erase(def);
+        data_.reclaimed_.emplace(def);
+        def->reclaimed_ = true;
+        for (size_t j = 0, e = def->num_ops(); j != e; ++j) {
+            if (!def->op(j)->no_dep()) def->op(j)->uses_.erase(Use(def, j));
+        }
+        if (!def->type()->no_dep()) def->type()->uses_.erase(Use(def, -1));
+    }
+
+    auto num = end - mark;
+    journal.erase(journal.begin() + mark, journal.begin() + end);
+    return num;
+}
+
+void World::revive(const Def* def) {
+    std::vector<const Def*> stack = {def};
+    while (!stack.empty()) {
+        auto def = stack.back();
+        if (!def->reclaimed_) {
+            stack.pop_back();
+            continue;
+        }
+
+        // operands first - they may be reclaimed as well
+        bool todo = false;
+        for (auto op : def->extended_ops()) {
+            if (op != nullptr && op->reclaimed_) {
+                stack.emplace_back(op);
+                todo = true;
+            }
+        }
+        if (todo) continue;
+
+        stack.pop_back();
+        data_.reclaimed_.erase(def);
+        data_.defs_.emplace(def);
+        def->reclaimed_ = false;
+        for (size_t j = 0, e = def->num_ops(); j != e; ++j) {
+            if (!def->op(j)->no_dep()) def->op(j)->uses_.emplace(def, j);
+        }
+        if (!def->type()->no_dep()) def->type()->uses_.emplace(def, -1);
+        if (state_.journal && !state_.concurrent) data_.journal_.emplace_back(def);
+    }
+}
+
 /*
  * misc
  */
@@ -847,6 +911,7 @@ const Def* World::infer_kind(Defs defs) const {
 
 template<bool elide_empty>
 void World::visit(VisitFn f) const {
+    ScopeTree tree(*this);
     unique_queue<NomSet> noms;
     unique_stack<DefSet> defs;
 
@@ -859,7 +924,7 @@ void World::visit(VisitFn f) const {
         auto nom = noms.pop();
         if (elide_empty && !nom->is_set()) continue;
 
-        Scope scope(nom);
+        Scope scope(tree, nom);
         f(scope);
 
         for (auto nom : scope.free_noms())
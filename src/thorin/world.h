@@ -5,8 +5,10 @@
 #include <iostream>
 #include <functional>
 #include <initializer_list>
+#include <mutex>
 #include <string>
 
+#include "thorin/apply_cache.h"
 #include "thorin/axiom.h"
 #include "thorin/lattice.h"
 #include "thorin/tuple.h"
@@ -78,13 +80,50 @@ public:
     //@{
     const std::string& name() const { return data_.name_; }
     const Sea& defs() const { return data_.defs_; }
+    /// Memoizes Def::apply; see @p ApplyCache.
+    ApplyCache& apply_cache() { return data_.cache_; }
     std::vector<Lam*> copy_lams() const; // TODO remove this
     //@}
 
     /// @name manage global identifier - a unique number for each Def
     //@{
-    u32 curr_gid() const { return state_.curr_gid; }
-    u32 next_gid() { return ++state_.curr_gid; }
+    u32 curr_gid() const { auto guard = lock(); return state_.curr_gid; }
+    u32 next_gid() { ++num_gids_; return ++state_.curr_gid; }
+    /// Number of gids the calling thread has drawn from any World so far.
+    /// Unlike curr_gid, this doesn't count Def%s built by other threads in concurrent mode.
+    static size_t num_gids() { return num_gids_; }
+    //@}
+
+    /// @name concurrency
+    //@{
+    /**
+     * In concurrent mode, several threads may build Def%s and modify @em noms at the same time - as long as each @em nom is only touched by a single thread.
+     * A single lock then guards all state that these threads share:
+     * The Sea, the uses of Def%s, the ApplyCache, the Checker, the externals, and the log.
+     */
+    bool is_concurrent() const { return state_.concurrent; }
+    void set_concurrent(bool flag = true) { state_.concurrent = flag; }
+    /// Locks this World in concurrent mode and does nothing otherwise.
+    std::unique_lock<std::recursive_mutex> lock() const {
+        return is_concurrent() ? std::unique_lock(mutex_) : std::unique_lock<std::recursive_mutex>();
+    }
+    //@}
+
+    /// @name reclamation of speculatively built Def%s
+    //@{
+    /// While journaling, the World records each Def it hash-conses - except in concurrent mode.
+    bool is_journaling() const { return state_.journal; }
+    void set_journal(bool flag = true) { state_.journal = flag; data_.journal_.clear(); }
+    /// Number of Def%s recorded so far - a mark for reclaim.
+    size_t journal_size() const { return data_.journal_.size(); }
+    /**
+     * Removes each Def recorded since @p mark that isn't used anymore from the Sea and its Use%s from its operands - starting with the most recent one.
+     * Passes may still hold such a Def: it comes back as soon as it is used again or an equal Def is built.
+     * Hence, its memory is only released along with the World.
+     * Var%s always stay. Does nothing in concurrent mode.
+     * @returns the number of reclaimed Def%s.
+     */
+    size_t reclaim(size_t mark);
     //@}
 
     /// @name Space, Kind, Var, Proxy
@@ -287,7 +326,7 @@ public:
     //@{
     //@}
     const Def* global(const Def* id, const Def* init, bool is_mutable = true, const Def* dbg = {});
-    const Def* global(const Def* init, bool is_mutable = true, const Def* dbg = {}) { return global(lit_nat(state_.curr_gid), init, is_mutable, dbg); }
+    const Def* global(const Def* init, bool is_mutable = true, const Def* dbg = {}) { return global(lit_nat(curr_gid()), init, is_mutable, dbg); }
     const Def* global_immutable_string(const std::string& str, const Def* dbg = {});
     //@}
 
@@ -407,10 +446,10 @@ public:
     //@{
     bool empty() { return data_.externals_.empty(); }
     const Externals& externals() const { return data_.externals_; }
-    void make_external(Def* def) { data_.externals_.emplace(def->debug().name, def); }
-    void make_internal(Def* def) { data_.externals_.erase(def->debug().name); }
-    bool is_external(const Def* def) { return data_.externals_.contains(def->debug().name); }
-    Def* lookup(const std::string& name) { return data_.externals_.lookup(name).value_or(nullptr); }
+    void make_external(Def* def) { auto guard = lock(); data_.externals_.emplace(def->debug().name, def); }
+    void make_internal(Def* def) { auto guard = lock(); data_.externals_.erase(def->debug().name); }
+    bool is_external(const Def* def) { auto guard = lock(); return data_.externals_.contains(def->debug().name); }
+    Def* lookup(const std::string& name) { auto guard = lock(); return data_.externals_.lookup(name).value_or(nullptr); }
     //@}
 
     /// @name visit
@@ -419,6 +458,7 @@ public:
      * Transitively visits all @em reachable Scope%s in this @p World that do not have free variables.
      * We call these Scope%s @em top-level Scope%s.
      * Select with @p elide_empty whether you want to visit trivial @p Scope%s of @em noms without body.
+     * All Scope%s are views on a single ScopeTree computed upfront; so @p f must not modify the visited @em noms.
      */
     using VisitFn = std::function<void(const Scope&)>;
     template<bool elide_empty = true> void visit(VisitFn) const;
@@ -446,6 +486,7 @@ public:
     template<class... Args>
     void log(LogLevel level, Loc loc, const char* fmt, Args&&... args) {
         if (stream_ && int(min_level()) <= int(level)) {
+            auto guard = lock();
             stream().fmt("{}:{}: ", colorize(level2string(level), level2color(level)), colorize(loc.to_string(), 7));
             stream().fmt(fmt, std::forward<Args&&>(args)...).endl().flush();
         }
@@ -498,8 +539,20 @@ private:
     //@{
     template<class T, class... Args>
     const T* unify(size_t num_ops, Args&&... args) {
+        auto guard = lock();
         auto def = arena_.allocate<T>(num_ops, args...);
         assert(!def->isa_nom());
+        if (!data_.reclaimed_.empty()) {
+            if (auto i = data_.reclaimed_.find(def); i != data_.reclaimed_.end()) {
+                auto old = *i;
+                arena_.deallocate<T>(def);
+                --state_.curr_gid;
+                --num_gids_;
+                revive(old);
+                return static_cast<const T*>(old);
+            }
+        }
+
         auto [i, inserted] = data_.defs_.emplace(def);
         if (inserted) {
 #ifndef NDEBUG
@@ -509,16 +562,19 @@ private:
             }
 #endif
             def->finalize();
+            if (state_.journal && !state_.concurrent) data_.journal_.emplace_back(def);
             return def;
         }
 
         arena_.deallocate<T>(def);
         --state_.curr_gid;
+        --num_gids_;
         return static_cast<const T*>(*i);
     }
 
     template<class T, class... Args>
     T* insert(size_t num_ops, Args&&... args) {
+        auto guard = lock();
         auto def = arena_.allocate<T>(num_ops, args...);
 #ifndef NDEBUG
         if (state_.breakpoints.contains(def->gid())) THORIN_BREAK;
@@ -527,6 +583,9 @@ private:
         assert_unused(p.second);
         return def;
     }
+
+    /// Puts the reclaimed @p def and its reclaimed operands back into the Sea.
+    void revive(const Def* def);
     //@}
 
     class Arena {
@@ -546,7 +605,7 @@ private:
         struct Lock {
             Lock() { assert((guard_ = !guard_) && "you are not allowed to recursively invoke allocate"); }
             ~Lock() { guard_ = !guard_; }
-            static bool guard_;
+            static thread_local bool guard_;
         };
 #else
         struct Lock { ~Lock() {} };
@@ -601,6 +660,8 @@ private:
         LogLevel min_level = LogLevel::Error;
         u32 curr_gid = 0;
         bool pe_done = false;
+        bool concurrent = false;
+        bool journal = false;
 #if THORIN_ENABLE_CHECKS
         bool track_history = false;
         Breakpoints breakpoints;
@@ -652,15 +713,19 @@ private:
         std::string name_;
         Externals externals_;
         Sea defs_;
-        DefDefMap<DefArray> cache_;
+        Sea reclaimed_;                    ///< Removed from defs_ by reclaim.
+        std::vector<const Def*> journal_; ///< Def%s hash-consed while journaling - see reclaim.
+        ApplyCache cache_;
     } data_;
 
     std::shared_ptr<Stream> stream_;
     std::unique_ptr<ErrorHandler> err_;
     std::unique_ptr<Checker> checker_;
+    mutable std::recursive_mutex mutex_;
+    static thread_local size_t num_gids_;
 
     friend class Cleaner;
-    friend DefArray Def::apply(const Def*);
+    friend class Def;
     friend void Def::replace(Tracker) const;
 };
 